@@ -23,11 +23,35 @@ namespace py = pybind11;
 PYBIND11_MODULE(teaserpp_python, m) {
   m.doc() = "Python binding for TEASER++";
 
+  // Python bound for teaser::CancellationToken
+  py::class_<teaser::CancellationToken, std::shared_ptr<teaser::CancellationToken>>(
+      m, "CancellationToken")
+      .def(py::init<>())
+      .def("cancel", &teaser::CancellationToken::cancel)
+      .def("setTimeout", &teaser::CancellationToken::setTimeout)
+      .def("reset", &teaser::CancellationToken::reset)
+      .def("isCancelled", &teaser::CancellationToken::isCancelled)
+      .def("getRemainingTime", &teaser::CancellationToken::getRemainingTime);
+
   // Python bound for teaser::RegistrationSolution
-  py::class_<teaser::RegistrationSolution>(m, "RegistrationSolution")
+  py::class_<teaser::RegistrationSolution> solution(m, "RegistrationSolution");
+
+  // Python bound for teaser::RegistrationSolution::STAGE
+  py::enum_<teaser::RegistrationSolution::STAGE>(solution, "STAGE")
+      .value("TIMS", teaser::RegistrationSolution::STAGE::TIMS)
+      .value("SCALE", teaser::RegistrationSolution::STAGE::SCALE)
+      .value("INLIER_GRAPH", teaser::RegistrationSolution::STAGE::INLIER_GRAPH)
+      .value("MAX_CLIQUE", teaser::RegistrationSolution::STAGE::MAX_CLIQUE)
+      .value("ROTATION", teaser::RegistrationSolution::STAGE::ROTATION)
+      .value("TRANSLATION", teaser::RegistrationSolution::STAGE::TRANSLATION)
+      .value("DONE", teaser::RegistrationSolution::STAGE::DONE);
+
+  solution.def_readwrite("valid", &teaser::RegistrationSolution::valid)
       .def_readwrite("scale", &teaser::RegistrationSolution::scale)
       .def_readwrite("translation", &teaser::RegistrationSolution::translation)
       .def_readwrite("rotation", &teaser::RegistrationSolution::rotation)
+      .def_readwrite("cancelled", &teaser::RegistrationSolution::cancelled)
+      .def_readwrite("stage", &teaser::RegistrationSolution::stage)
       .def("__repr__", [](const teaser::RegistrationSolution& a) {
         std::ostringstream print_string;
 
@@ -40,6 +64,51 @@ PYBIND11_MODULE(teaserpp_python, m) {
         return print_string.str();
       });
 
+  // Python bound for teaser::RegistrationStats
+  py::class_<teaser::RegistrationStats>(m, "RegistrationStats")
+      .def_readwrite("tims_time", &teaser::RegistrationStats::tims_time)
+      .def_readwrite("scale_time", &teaser::RegistrationStats::scale_time)
+      .def_readwrite("graph_time", &teaser::RegistrationStats::graph_time)
+      .def_readwrite("clique_time", &teaser::RegistrationStats::clique_time)
+      .def_readwrite("rotation_time", &teaser::RegistrationStats::rotation_time)
+      .def_readwrite("translation_time", &teaser::RegistrationStats::translation_time)
+      .def_readwrite("num_measurements", &teaser::RegistrationStats::num_measurements)
+      .def_readwrite("num_tims", &teaser::RegistrationStats::num_tims)
+      .def_readwrite("scale_sample_size", &teaser::RegistrationStats::scale_sample_size)
+      .def_readwrite("scale_standard_error", &teaser::RegistrationStats::scale_standard_error)
+      .def_readwrite("scale_sample_inlier_ratio",
+                     &teaser::RegistrationStats::scale_sample_inlier_ratio)
+      .def_readwrite("scale_inlier_ratio", &teaser::RegistrationStats::scale_inlier_ratio)
+      .def_readwrite("num_edges", &teaser::RegistrationStats::num_edges)
+      .def_readwrite("graph_density", &teaser::RegistrationStats::graph_density)
+      .def_readwrite("max_core", &teaser::RegistrationStats::max_core)
+      .def_readwrite("clique_size", &teaser::RegistrationStats::clique_size)
+      .def_readwrite("rotation_iterations", &teaser::RegistrationStats::rotation_iterations)
+      .def_readwrite("num_rotation_inliers", &teaser::RegistrationStats::num_rotation_inliers)
+      .def_readwrite("num_translation_inliers",
+                     &teaser::RegistrationStats::num_translation_inliers);
+
+  // Python bound for teaser::RegistrationProblem
+  py::class_<teaser::RegistrationProblem>(m, "RegistrationProblem")
+      .def(py::init<>())
+      .def_readwrite("src", &teaser::RegistrationProblem::src)
+      .def_readwrite("dst", &teaser::RegistrationProblem::dst);
+
+  // Python bound for teaser::PreparedSource
+  py::class_<teaser::PreparedSource>(m, "PreparedSource")
+      .def(py::init<>())
+      .def_readonly("measurements", &teaser::PreparedSource::measurements)
+      .def_readonly("tim_norms", &teaser::PreparedSource::tim_norms);
+
+  // Python bound for teaser::RegistrationContext
+  py::class_<teaser::RegistrationContext>(m, "RegistrationContext")
+      .def(py::init<>())
+      .def("getSolution", &teaser::RegistrationContext::getSolution)
+      .def("getStats", &teaser::RegistrationContext::getStats)
+      .def("getInlierMaxClique", &teaser::RegistrationContext::getInlierMaxClique)
+      .def("getRotationInliers", &teaser::RegistrationContext::getRotationInliers)
+      .def("getTranslationInliers", &teaser::RegistrationContext::getTranslationInliers);
+
   // Python bound for teaser::RobustRegistraionSolver
   py::class_<teaser::RobustRegistrationSolver> solver(m, "RobustRegistrationSolver");
 
@@ -48,12 +117,25 @@ PYBIND11_MODULE(teaserpp_python, m) {
       .def(py::init<const teaser::RobustRegistrationSolver::Params&>())
       .def("getParams", &teaser::RobustRegistrationSolver::getParams)
       .def("reset", &teaser::RobustRegistrationSolver::reset)
-      .def("solve", py::overload_cast<const Eigen::Matrix<double, 3, Eigen::Dynamic>&,
-                                      const Eigen::Matrix<double, 3, Eigen::Dynamic>&>(
-                        &teaser::RobustRegistrationSolver::solve))
+      .def("solve",
+           py::overload_cast<const teaser::MeasurementsRef&, const teaser::MeasurementsRef&>(
+               &teaser::RobustRegistrationSolver::solve))
+      .def("solve",
+           py::overload_cast<const teaser::MeasurementsRef&, const teaser::MeasurementsRef&,
+                             teaser::RegistrationContext*>(
+               &teaser::RobustRegistrationSolver::solve, py::const_),
+           py::call_guard<py::gil_scoped_release>())
+      .def("solve",
+           py::overload_cast<const teaser::PreparedSource&, const teaser::MeasurementsRef&>(
+               &teaser::RobustRegistrationSolver::solve))
+      .def_static("prepareSource", &teaser::RobustRegistrationSolver::prepareSource)
+      .def("solveBatch", &teaser::RobustRegistrationSolver::solveBatch)
       .def("getSolution", &teaser::RobustRegistrationSolver::getSolution)
+      .def("getStats", &teaser::RobustRegistrationSolver::getStats)
       .def("getGNCRotationCostAtTermination",
            &teaser::RobustRegistrationSolver::getGNCRotationCostAtTermination)
+      .def("getGNCRotationIterationsAtTermination",
+           &teaser::RobustRegistrationSolver::getGNCRotationIterationsAtTermination)
       .def("getScaleInliersMask", &teaser::RobustRegistrationSolver::getScaleInliersMask)
       .def("getScaleInliersMap", &teaser::RobustRegistrationSolver::getScaleInliersMap)
       .def("getScaleInliers", &teaser::RobustRegistrationSolver::getScaleInliers)
@@ -65,6 +147,7 @@ PYBIND11_MODULE(teaserpp_python, m) {
       .def("getTranslationInliersMap", &teaser::RobustRegistrationSolver::getTranslationInliersMap)
       .def("getTranslationInliers", &teaser::RobustRegistrationSolver::getTranslationInliers)
       .def("getInlierMaxClique", &teaser::RobustRegistrationSolver::getInlierMaxClique)
+      .def("getSampleIndices", &teaser::RobustRegistrationSolver::getSampleIndices)
       .def("getInlierGraph", &teaser::RobustRegistrationSolver::getInlierGraph)
       .def("getSrcTIMsMap", &teaser::RobustRegistrationSolver::getSrcTIMsMap)
       .def("getDstTIMsMap", &teaser::RobustRegistrationSolver::getDstTIMsMap)
@@ -106,11 +189,32 @@ PYBIND11_MODULE(teaserpp_python, m) {
                      &teaser::RobustRegistrationSolver::Params::kcore_heuristic_threshold)
       .def_readwrite("rotation_cost_threshold",
                      &teaser::RobustRegistrationSolver::Params::rotation_cost_threshold)
+      .def_readwrite("rotation_stop_on_stable_inliers",
+                     &teaser::RobustRegistrationSolver::Params::rotation_stop_on_stable_inliers)
+      .def_readwrite("rotation_stable_inliers_iterations",
+                     &teaser::RobustRegistrationSolver::Params::rotation_stable_inliers_iterations)
+      .def_readwrite("rotation_delta_threshold",
+                     &teaser::RobustRegistrationSolver::Params::rotation_delta_threshold)
       .def_readwrite("use_max_clique", &teaser::RobustRegistrationSolver::Params::use_max_clique)
       .def_readwrite("max_clique_exact_solution",
                      &teaser::RobustRegistrationSolver::Params::max_clique_exact_solution)
       .def_readwrite("max_clique_time_limit",
                      &teaser::RobustRegistrationSolver::Params::max_clique_time_limit)
+      .def_readwrite("batch_cooperative_size",
+                     &teaser::RobustRegistrationSolver::Params::batch_cooperative_size)
+      .def_readwrite("dense_graph_threshold",
+                     &teaser::RobustRegistrationSolver::Params::dense_graph_threshold)
+      .def_readwrite("dense_graph_max_cover_size",
+                     &teaser::RobustRegistrationSolver::Params::dense_graph_max_cover_size)
+      .def_readwrite("inlier_graph_sample_size",
+                     &teaser::RobustRegistrationSolver::Params::inlier_graph_sample_size)
+      .def_readwrite(
+          "inlier_graph_sample_verification_ratio",
+          &teaser::RobustRegistrationSolver::Params::inlier_graph_sample_verification_ratio)
+      .def_readwrite("scale_estimation_sample_size",
+                     &teaser::RobustRegistrationSolver::Params::scale_estimation_sample_size)
+      .def_readwrite("cancellation_token",
+                     &teaser::RobustRegistrationSolver::Params::cancellation_token)
       .def("__repr__", [](const teaser::RobustRegistrationSolver::Params& a) {
         std::ostringstream print_string;
 
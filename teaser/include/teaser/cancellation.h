@@ -0,0 +1,109 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace teaser {
+
+/**
+ * A token used to stop a running solve early, either explicitly (cancel(), e.g., from another
+ * thread) or once an absolute deadline has passed.
+ *
+ * Solvers holding the token poll it between stages and periodically within the long-running loops
+ * (TIMs, TLS scale estimation, inlier graph, max clique, GNC iterations), and stop at the next
+ * poll. All member functions are thread-safe.
+ *
+ * Known gap: the max clique search on dense inlier graphs (few outliers) polls the token at every
+ * step, but the PMC searches (heuristic and exact), used on sparser graphs, run as single calls
+ * into the PMC library, which only has a time limit. A deadline set on the token caps that time
+ * limit, but an explicit cancel() only takes effect once the PMC search returns. Use a deadline (or
+ * max_clique_time_limit) to bound the search.
+ */
+class CancellationToken {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Request cancellation. Takes effect at the next poll of the solvers using this token.
+   */
+  void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+  /**
+   * Set an absolute deadline, after which the token reads as cancelled.
+   * @param deadline
+   */
+  void setDeadline(Clock::time_point deadline) {
+    deadline_ns_.store(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count(),
+        std::memory_order_relaxed);
+  }
+
+  /**
+   * Set the deadline to the provided time from now.
+   * @param seconds
+   */
+  void setTimeout(double seconds) {
+    std::chrono::duration<double> timeout(seconds);
+    setDeadline(Clock::now() + std::chrono::duration_cast<Clock::duration>(timeout));
+  }
+
+  /**
+   * Clear the cancellation request and the deadline, so that the token can be reused.
+   */
+  void reset() {
+    cancelled_.store(false, std::memory_order_relaxed);
+    deadline_ns_.store(NO_DEADLINE, std::memory_order_relaxed);
+  }
+
+  /**
+   * @return true if cancel() has been called or the deadline has passed
+   */
+  bool isCancelled() const {
+    if (cancelled_.load(std::memory_order_relaxed)) {
+      return true;
+    }
+    return getRemainingTime() <= 0;
+  }
+
+  /**
+   * @return time left until the deadline in seconds (infinity if no deadline is set), ignoring
+   * explicit cancellation
+   */
+  double getRemainingTime() const {
+    int64_t deadline_ns = deadline_ns_.load(std::memory_order_relaxed);
+    if (deadline_ns == NO_DEADLINE) {
+      return std::numeric_limits<double>::infinity();
+    }
+    int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         Clock::now().time_since_epoch())
+                         .count();
+    return (deadline_ns - now_ns) * 1e-9;
+  }
+
+private:
+  static constexpr int64_t NO_DEADLINE = std::numeric_limits<int64_t>::max();
+
+  std::atomic<bool> cancelled_{false};
+  std::atomic<int64_t> deadline_ns_{NO_DEADLINE};
+};
+
+/**
+ * @param token a cancellation token, possibly null
+ * @return true if the token is set and cancelled
+ */
+inline bool isCancelled(const std::shared_ptr<CancellationToken>& token) {
+  return token && token->isCancelled();
+}
+
+} // namespace teaser
@@ -0,0 +1,181 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+namespace teaser {
+
+/**
+ * Struct to hold the result of certifying a rotation estimate
+ */
+struct CertificationResult {
+  /**
+   * True if the best relative suboptimality gap found is within the requested bound
+   */
+  bool is_optimal = false;
+
+  /**
+   * Best (smallest) relative suboptimality gap found: (f(R) - f_lb) / f(R), where f(R) is the TLS
+   * cost of the rotation estimate and f_lb a lower bound on the globally optimal cost. The bound
+   * is proven (by a Cholesky factorization or an exact eigendecomposition), not estimated. -1 if
+   * no gap could be proven within the time limit.
+   */
+  double best_suboptimality = -1;
+
+  /**
+   * Relative suboptimality gap after the initial guess and after each refinement iteration, proven
+   * as best_suboptimality. Gaps that could not be proven within the time limit are left out.
+   */
+  std::vector<double> suboptimality_traj;
+
+  /**
+   * Number of refinement iterations run
+   */
+  size_t iterations = 0;
+};
+
+/**
+ * Abstract virtual class for certifying rotation estimates
+ */
+class AbstractRotationCertifier {
+public:
+  virtual ~AbstractRotationCertifier() {}
+
+  /**
+   * Certify a rotation estimate of a TLS rotation problem. Assume dst = R * src + noise.
+   * @param rotation_solution the rotation estimate to certify
+   * @param src 3-by-N matrix of measurements (e.g., TIMs of the max clique)
+   * @param dst 3-by-N matrix of measurements
+   * @param theta 1-by-N binary vector of the inliers of the rotation estimate
+   * @return a CertificationResult
+   */
+  virtual CertificationResult certify(const Eigen::Matrix3d& rotation_solution,
+                                      const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
+                                      const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst,
+                                      const Eigen::Matrix<bool, 1, Eigen::Dynamic>& theta) = 0;
+};
+
+/**
+ * Certify rotation estimates of the TLS rotation problem using a dual certificate.
+ *
+ * The TLS rotation problem is lifted to a QCQP over x = [q; theta_1 q; ...; theta_N q] with q a
+ * unit quaternion. For any dual matrix M in the affine set defined by the constraints of the QCQP
+ * (including the redundant x_i * x_j^T = x_j * x_i^T constraints), the global optimum is bounded
+ * from below by f(x) + (N + 1) * min_eig(M). The minimum eigenvalue is estimated with a few Lanczos
+ * iterations warm-started from the previous Ritz vector. Since Lanczos over-estimates it, the
+ * reported gaps come from a shift confirmed with a Cholesky factorization of M + shift * I, or from
+ * the exact minimum eigenvalue if that factorization fails.
+ *
+ * The dual matrix starts from the multipliers that certify noiseless inliers, and is refined with
+ * Douglas-Rachford splitting (DRS) between the PSD cone and the affine set (which also enforces
+ * complementary slackness, projected in closed form) until the requested suboptimality is
+ * certified or the iteration / time budget is exhausted.
+ *
+ * Limitation: only the gap estimate avoids the full eigendecomposition. The PSD projection of each
+ * DRS iteration is still a dense eigendecomposition of the 4(N+1) square dual matrix, i.e., O(N^3)
+ * time and O(N^2) memory per iteration, as the projection needs every negative eigenpair, not
+ * only the smallest one. Refinement is therefore bounded by Params::max_iterations and
+ * Params::time_limit. Every dense factorization (the Cholesky check, the exact eigenvalue fallback
+ * and the PSD projection) is only started if its cost, extrapolated from the previous ones, fits in
+ * the remaining time, so that the time limit holds for large inlier sets as well; with a tight
+ * limit, no gap may be proven at all (is_optimal is then false).
+ *
+ * For more information, please refer to:
+ * H. Yang, J. Shi, and L. Carlone, “TEASER: Fast and Certifiable Point Cloud Registration,”
+ * arXiv:2001.07715 [cs, math], Jan. 2020.
+ */
+class DRSCertifier : public AbstractRotationCertifier {
+public:
+  /**
+   * Parameter struct for DRSCertifier
+   */
+  struct Params {
+    /**
+     * Noise bound on the measurements. For TIMs, this is twice the noise bound of the original
+     * measurements, divided by the estimated scale.
+     */
+    double noise_bound = 0.01;
+
+    /**
+     * Square of the ratio between acceptable noise and noise bound. Usually set to 1.
+     */
+    double cbar2 = 1;
+
+    /**
+     * Relative suboptimality gap below which the estimate is considered optimal.
+     */
+    double sub_optimality = 1e-3;
+
+    /**
+     * Maximum number of DRS refinement iterations. Each one costs a dense O(N^3)
+     * eigendecomposition, see the class documentation.
+     */
+    size_t max_iterations = 200;
+
+    /**
+     * Relaxation factor of the DRS iterations, in (0, 2).
+     */
+    double gamma_tau = 1.8;
+
+    /**
+     * Maximum number of Lanczos iterations per minimum eigenvalue estimate.
+     */
+    size_t lanczos_iterations = 30;
+
+    /**
+     * Time budget (in seconds). No dense factorization is started that is expected to exceed it;
+     * the best gap proven so far is returned.
+     */
+    double time_limit = 1;
+  };
+
+  DRSCertifier() = default;
+
+  explicit DRSCertifier(const Params& params) : params_(params) {}
+
+  CertificationResult certify(const Eigen::Matrix3d& rotation_solution,
+                              const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
+                              const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst,
+                              const Eigen::Matrix<bool, 1, Eigen::Dynamic>& theta) override;
+
+  /**
+   * Return the 4x4 matrix N such that dst^T * R(q) * src = q^T * N * q for any unit quaternion q,
+   * with q ordered as (w, x, y, z). See B. K. P. Horn, “Closed-form solution of absolute
+   * orientation using unit quaternions,” J. Opt. Soc. Am. A, 1987.
+   * @param src
+   * @param dst
+   */
+  static Eigen::Matrix4d getQuaternionCorrelation(const Eigen::Vector3d& src,
+                                                  const Eigen::Vector3d& dst);
+
+  Params getParams() { return params_; }
+
+  void setParams(const Params& params) { params_ = params; }
+
+private:
+  using BlockVector = std::vector<Eigen::Matrix4d, Eigen::aligned_allocator<Eigen::Matrix4d>>;
+
+  /**
+   * Estimate the minimum eigenvalue of a symmetric matrix with Lanczos iterations.
+   * @param m a symmetric matrix
+   * @param max_iterations maximum number of Lanczos iterations
+   * @param v [in/out] starting vector (ignored if empty); set to the Ritz vector of the estimate
+   * @return the smallest Ritz value, an upper bound on the minimum eigenvalue
+   */
+  static double computeMinEigenvalue(const Eigen::MatrixXd& m, size_t max_iterations,
+                                     Eigen::VectorXd* v);
+
+  Params params_;
+};
+
+} // namespace teaser
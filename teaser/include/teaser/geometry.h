@@ -48,6 +48,7 @@ public:
   // capacity
   inline size_t size() const { return points_.size(); }
   inline void reserve(size_t n) { points_.reserve(n); }
+  inline void resize(size_t n) { points_.resize(n); }
   inline bool empty() { return points_.empty(); }
 
   // element access
@@ -59,6 +60,8 @@ public:
   inline const PointXYZ& front() const { return points_.front(); }
   inline PointXYZ& back() { return points_.back(); }
   inline const PointXYZ& back() const { return points_.back(); }
+  inline PointXYZ* data() { return points_.data(); }
+  inline const PointXYZ* data() const { return points_.data(); }
 
   inline void push_back(const PointXYZ& pt) { points_.push_back(pt); }
   inline void push_back(PointXYZ& pt) { points_.push_back(pt); }
@@ -14,6 +14,7 @@
 
 #include <Eigen/Core>
 
+#include "teaser/cancellation.h"
 #include "teaser/macros.h"
 
 namespace teaser {
@@ -66,6 +67,17 @@ public:
    */
   void populateVertices(const int& num_vertices) { adj_list_.resize(num_vertices); }
 
+  /**
+   * Remove all edges while keeping the vertices. The memory held by the adjacency lists is kept,
+   * so that rebuilding a graph of similar size does not reallocate.
+   */
+  void clearEdges() {
+    for (auto& c_edges : adj_list_) {
+      c_edges.clear();
+    }
+    num_edges_ = 0;
+  }
+
   /**
    * Return true if said edge exists
    * @param [in] vertex_1
@@ -98,6 +110,17 @@ public:
       TEASER_DEBUG_ERROR_MSG("Edge exists.");
       return;
     }
+    addEdgeUnchecked(vertex_1, vertex_2);
+  }
+
+  /**
+   * Add an edge between two vertices without checking whether it already exists. Checking takes
+   * time linear in the degree of the vertex, which adds up when building dense graphs. The caller
+   * must make sure the edge is new.
+   * @param [in] vertex_1 one vertex of the edge
+   * @param [in] vertex_2 another vertex of the edge
+   */
+  void addEdgeUnchecked(const int& vertex_1, const int& vertex_2) {
     adj_list_[vertex_1].push_back(vertex_2);
     adj_list_[vertex_2].push_back(vertex_1);
     num_edges_++;
@@ -124,6 +147,44 @@ public:
     num_edges_--;
   }
 
+  /**
+   * Remove all edges of the provided vertices, keeping the vertices. The adjacency list of each
+   * neighbor is filtered once, however many of its neighbors are isolated.
+   * @param [in] ids
+   */
+  void isolateVertices(const std::vector<int>& ids) {
+    std::vector<bool> isolated(adj_list_.size(), false);
+    for (const auto& id : ids) {
+      isolated[id] = true;
+    }
+    std::vector<bool> filtered(adj_list_.size(), false);
+    for (const auto& id : ids) {
+      for (const auto& neighbor : adj_list_[id]) {
+        if (isolated[neighbor] || filtered[neighbor]) {
+          continue;
+        }
+        filtered[neighbor] = true;
+        auto& n_edges = adj_list_[neighbor];
+        const size_t degree = n_edges.size();
+        n_edges.erase(std::remove_if(n_edges.begin(), n_edges.end(),
+                                     [&isolated](int v) { return isolated[v]; }),
+                      n_edges.end());
+        num_edges_ -= degree - n_edges.size();
+      }
+    }
+    // Edges between two isolated vertices are counted once, from either end
+    for (const auto& id : ids) {
+      for (const auto& neighbor : adj_list_[id]) {
+        if (isolated[neighbor] && neighbor > id) {
+          num_edges_--;
+        }
+      }
+    }
+    for (const auto& id : ids) {
+      adj_list_[id].clear();
+    }
+  }
+
   /**
    * Get the number of vertices
    * @return total number of vertices
@@ -247,6 +308,37 @@ public:
      * Time limit on running the solver.
      */
     double time_limit = 3600;
+
+    /**
+     * Optional token to stop the search early. The dense graph path (see dense_graph_threshold)
+     * checks it for every vertex of the complement graph and at every node of its search, and
+     * returns an empty clique once cancelled. PMC only checks it between its search phases, and
+     * its deadline caps time_limit for the exact search: an explicit cancel() is not seen by PMC
+     * while it searches, only once the running phase returns. Once cancelled, the best clique
+     * found so far (possibly empty) is returned.
+     */
+    std::shared_ptr<CancellationToken> cancellation_token;
+
+    /**
+     * Graphs with an edge density (number of edges over number of vertex pairs) of at least this
+     * value skip PMC. The max clique is instead found as the complement of a minimum vertex cover
+     * of the complement graph, which is cheap when few vertices miss edges (e.g., inlier graphs
+     * with few outliers). Set to a value above 1 to always use PMC.
+     */
+    double dense_graph_threshold = 0.9;
+
+    /**
+     * Maximum size of the vertex cover of the complement graph searched for on dense graphs, i.e.,
+     * the maximum number of vertices left out of the clique. PMC is used if no cover of this size
+     * is found.
+     */
+    size_t dense_graph_max_cover_size = 64;
+
+    /**
+     * Number of threads used by PMC. PMC starts its own threads, regardless of
+     * omp_set_num_threads(), so set this to 1 when solving several problems concurrently.
+     */
+    int num_threads = 12;
   };
 
   MaxCliqueSolver() = default;
@@ -259,11 +351,91 @@ public:
    * @param graph
    * @return a vector of indices of cliques
    */
-  std::vector<int> findMaxClique(Graph graph);
+  std::vector<int> findMaxClique(const Graph& graph);
+
+  /**
+   * Find the maximum clique within the graph provided, warm-started with a known clique (e.g., the
+   * max clique of a previous version of the graph). Vertices of initial_clique that are not
+   * adjacent to all the previous ones are dropped. The exact search then only looks for cliques
+   * larger than the initial one, and returns right away if the initial clique already reaches the
+   * core number bound.
+   * @param graph
+   * @param initial_clique
+   * @return a vector of indices of cliques
+   */
+  std::vector<int> findMaxClique(const Graph& graph, const std::vector<int>& initial_clique);
+
+  /**
+   * Same as findMaxClique(), writing the clique into an existing vector. On dense graphs (see
+   * Params::dense_graph_threshold), the solver reuses its buffers and the capacity of the vector,
+   * so that repeated calls on graphs of the same size do not allocate. PMC allocates on every
+   * call.
+   * @param graph
+   * @param initial_clique
+   * @param clique [out] a vector of indices of cliques
+   */
+  void findMaxClique(const Graph& graph, const std::vector<int>& initial_clique,
+                     std::vector<int>* clique);
+
+  /**
+   * Find up to num_cliques vertex-disjoint cliques within the graph provided. The first clique is
+   * the one returned by findMaxClique(); each following clique is the max clique of the graph with
+   * the vertices of all previously found cliques isolated. The search stops early once the best
+   * remaining clique has no more than one vertex, or once the cancellation token is cancelled.
+   * @param graph
+   * @param num_cliques maximum number of cliques to return
+   * @return a vector of cliques, in the order they are found (non-increasing size)
+   */
+  std::vector<std::vector<int>> findMaxCliques(const Graph& graph, size_t num_cliques);
+
+  Params getParams() const { return params_; }
+
+  void setParams(const Params& params) { params_ = params; }
+
+  /**
+   * Return the max core number of the graph passed to the last call of findMaxClique(), an upper
+   * bound on the max clique size minus one.
+   * @return max core number, or -1 if the clique was found without computing the cores (dense
+   * graphs). Undefined if run before running the solver.
+   */
+  int getMaxCoreAtTermination() const { return max_core_; }
 
 private:
+  /**
+   * Find the max clique of a dense graph as the complement of an exact minimum vertex cover of
+   * the complement graph, searched with a bounded search tree.
+   * @param graph
+   * @param clique [out] the max clique, if found
+   * @return false if the complement graph has no vertex cover of at most
+   * params_.dense_graph_max_cover_size vertices, or the search budget is exhausted
+   */
+  bool findMaxCliqueOnDenseGraph(const Graph& graph, std::vector<int>* clique);
+
+  /**
+   * Find the max clique with PMC, as configured by params_.solver_mode.
+   * @param graph
+   * @param initial_clique
+   * @param time_limit in seconds
+   * @return a vector of indices of cliques
+   */
+  std::vector<int> findMaxCliqueWithPMC(const Graph& graph, const std::vector<int>& initial_clique,
+                                        double time_limit);
+
   Graph graph_;
   Params params_;
+  int max_core_ = 0;
+
+  // Compressed sparse row representation of the graph passed to PMC, kept across calls to reuse
+  // its memory
+  std::vector<int> edges_;
+  std::vector<long long> vertices_;
+
+  // Complement graph and vertex cover search state of the dense graph path, kept across calls to
+  // reuse their memory
+  std::vector<std::vector<int>> complement_;
+  std::vector<size_t> degrees_;
+  std::vector<bool> in_cover_;
+  std::vector<int> cover_;
 };
 
 } // namespace teaser
@@ -0,0 +1,118 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "teaser/graph.h"
+#include "teaser/registration.h"
+
+namespace teaser {
+
+/**
+ * Registration over a changing set of correspondences (e.g., a sliding window of frames, where
+ * each new frame adds correspondences and old ones are retired).
+ *
+ * Whether two correspondences are connected in the inlier graph only depends on the two of them
+ * (with known scale), so the graph is maintained incrementally: adding k correspondences to N
+ * checks the k*N new pairs only, and removing one drops its edges. The max clique search of each
+ * solve is warm-started with the clique of the previous solve, minus the removed correspondences.
+ * The cost of keeping the registration up to date thus scales with the number of changed
+ * correspondences, rather than with the N*(N-1)/2 pairs of a full solve.
+ *
+ * Correspondences are identified by the ids returned when adding them. The ids of removed
+ * correspondences are reused by later additions.
+ *
+ * Requirements on the params: estimate_scaling has to be false (a scale estimated from all the
+ * TIMs would change every edge of the graph), inlier selection cannot be NONE, and
+ * inlier_graph_sample_size is ignored.
+ */
+class IncrementalRegistrationSolver {
+public:
+  /**
+   * @param params
+   */
+  explicit IncrementalRegistrationSolver(const RobustRegistrationSolver::Params& params);
+
+  /**
+   * Add correspondences, and their edges to the inlier graph.
+   * @param src 3-by-k source points
+   * @param dst 3-by-k destination points
+   * @return ids of the added correspondences, in the order of the columns
+   */
+  std::vector<int> addCorrespondences(const MeasurementsRef& src, const MeasurementsRef& dst);
+
+  /**
+   * Remove correspondences, and their edges from the inlier graph.
+   * @param ids ids of correspondences currently in the solver
+   */
+  void removeCorrespondences(const std::vector<int>& ids);
+
+  /**
+   * Remove all correspondences.
+   */
+  void clear();
+
+  /**
+   * Solve for scale, rotation and translation on the current correspondences: max clique
+   * (warm-started), rotation and translation.
+   * @return a RegistrationSolution struct
+   */
+  RegistrationSolution solve();
+
+  /**
+   * @return number of correspondences currently in the solver
+   */
+  size_t numCorrespondences() const { return num_correspondences_; }
+
+  /**
+   * Stats of the last solve. num_tims and graph_time cover the updates of the inlier graph since
+   * the solve before (the pairs checked and the time spent adding and removing correspondences).
+   */
+  RegistrationStats getStats() const { return solver_.stats_; }
+
+  /**
+   * @return ids of the correspondences in the max clique of the last solve
+   */
+  std::vector<int> getInlierMaxClique() const { return solver_.max_clique_; }
+
+  /**
+   * @return ids of the final inliers of the last solve
+   */
+  std::vector<int> getTranslationInliers() const { return solver_.translation_inliers_; }
+
+  /**
+   * @return the inlier graph, with the ids as vertices (removed ids are isolated vertices)
+   */
+  const Graph& getInlierGraph() const { return solver_.inlier_graph_; }
+
+private:
+  RobustRegistrationSolver solver_;
+
+  // Correspondences by id. Columns past num_ids_ are spare capacity.
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src_;
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst_;
+  size_t num_ids_ = 0;
+  size_t num_correspondences_ = 0;
+
+  // Whether each id is in use, and the ids free for reuse
+  std::vector<bool> active_;
+  std::vector<int> free_ids_;
+
+  // Max clique of the last solve, minus the correspondences removed since
+  std::vector<int> clique_;
+
+  // Pairs checked and time spent updating the inlier graph since the last solve
+  size_t num_checked_pairs_ = 0;
+  double update_time_ = 0;
+};
+
+} // namespace teaser
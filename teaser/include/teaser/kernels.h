@@ -0,0 +1,119 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace teaser {
+namespace kernels {
+
+/**
+ * Instruction sets the kernels are compiled for, from the least to the most preferred.
+ *
+ * Every kernel is built for all of them (without needing -march flags), and the best one supported
+ * by the CPU is selected at runtime from cpuid, so that portable binaries still run the widest
+ * vectors available.
+ */
+enum class ISA { SCALAR = 0, SSE4_2 = 1, AVX2 = 2, AVX512 = 3 };
+
+/**
+ * @return the best ISA supported by the CPU and the OS (SCALAR on non-x86 platforms)
+ */
+ISA bestSupportedISA();
+
+/**
+ * @return the ISA of the kernels in use: bestSupportedISA(), unless changed with setISA()
+ */
+ISA activeISA();
+
+/**
+ * Use the kernels compiled for another ISA, e.g., to compare the variants. Takes effect for the
+ * kernel calls starting after it.
+ * @param isa an ISA supported by the CPU
+ */
+void setISA(ISA isa);
+
+/**
+ * @return human readable name of the ISA
+ */
+const char* isaName(ISA isa);
+
+/**
+ * Number of mask words needed for the provided number of bits
+ */
+inline size_t numMaskWords(size_t num_bits) { return (num_bits + 63) / 64; }
+
+/**
+ * Scale consistency check of pairs of TIMs, fused into one pass: TIM i is an inlier if the norms
+ * of src TIM i and dst TIM i differ by at most beta.
+ *
+ * With squared norms s1 and s2, |sqrt(s1) - sqrt(s2)| <= beta is equivalent to d <= 0 or
+ * d^2 <= 4 * s1 * s2 with d = s1 + s2 - beta^2, so the check takes no square root and no division.
+ * Vectorized for contiguous TIMs.
+ *
+ * @param src_tims 3-by-N column-major src TIMs, with columns stride doubles apart
+ * @param dst_tims 3-by-N column-major dst TIMs, with columns stride doubles apart
+ * @param stride distance between consecutive columns, in doubles (3 for contiguous TIMs)
+ * @param num_tims N
+ * @param beta maximum allowed difference between the norms
+ * @param mask [out] numMaskWords(N) words; bit i % 64 of word i / 64 is set iff TIM i is an inlier
+ */
+void scaleInliersMask(const double* src_tims, const double* dst_tims, size_t stride,
+                      size_t num_tims, double beta, uint64_t* mask);
+
+/**
+ * TIMs of one segment: tims[:, k] = points[:, k] - origin, for 3-by-N column-major points and
+ * TIMs.
+ *
+ * @param points first point
+ * @param points_stride distance between consecutive points, in doubles
+ * @param num_points N
+ * @param origin point subtracted from all the others
+ * @param tims [out] first TIM
+ * @param tims_stride distance between consecutive TIMs, in doubles
+ */
+void timSegment(const double* points, size_t points_stride, size_t num_points,
+                const double* origin, double* tims, size_t tims_stride);
+
+/**
+ * Consensus sweep of the scalar TLS estimator: for each interval center c, the measurements j with
+ * |X_j - c| <= ranges_j are the consensus set,
+ * x_hat = sum(X_j * weights_j) / sum(weights_j) over the consensus set, and
+ * x_cost = sum((X_j - x_hat)^2) over the consensus set + sum(ranges_j) over the others.
+ *
+ * @param X N measurements
+ * @param ranges N ranges
+ * @param weights N weights
+ * @param N number of measurements
+ * @param centers interval centers
+ * @param num_centers number of interval centers
+ * @param x_hat [out] num_centers estimates
+ * @param x_cost [out] num_centers costs
+ */
+void tlsConsensusSweep(const double* X, const double* ranges, const double* weights, size_t N,
+                       const double* centers, size_t num_centers, double* x_hat, double* x_cost);
+
+/**
+ * Squared residuals of a rotation: residuals_sq[j] = ||dst[:, j] - R * src[:, j]||^2, for 3-by-N
+ * column-major src and dst.
+ *
+ * @param rotation 3-by-3 column-major rotation matrix R
+ * @param src first src point
+ * @param src_stride distance between consecutive src points, in doubles
+ * @param dst first dst point
+ * @param dst_stride distance between consecutive dst points, in doubles
+ * @param num N
+ * @param residuals_sq [out] N squared residuals
+ */
+void squaredResiduals(const double* rotation, const double* src, size_t src_stride,
+                      const double* dst, size_t dst_stride, size_t num, double* residuals_sq);
+
+} // namespace kernels
+} // namespace teaser
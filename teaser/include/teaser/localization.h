@@ -0,0 +1,216 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <flann/flann.hpp>
+
+#include "teaser/fpfh.h"
+#include "teaser/geometry.h"
+#include "teaser/registration.h"
+
+namespace teaser {
+
+/**
+ * Timings and counters of the queries run by a LocalizationEngine
+ */
+struct LocalizationStats {
+  size_t num_queries = 0;
+
+  // Cumulative wall times over all queries, in seconds
+  double feature_time = 0;
+  double matching_time = 0;
+  double solve_time = 0;
+  double total_time = 0;
+
+  // Wall time of the last query, in seconds
+  double last_query_time = 0;
+
+  /**
+   * @return mean latency of the queries in seconds
+   */
+  double getMeanLatency() const { return num_queries > 0 ? total_time / num_queries : 0; }
+
+  /**
+   * @return queries per second of query time
+   */
+  double getThroughput() const { return total_time > 0 ? num_queries / total_time : 0; }
+};
+
+/**
+ * The result of localizing one query scan against the map
+ */
+struct LocalizationResult {
+  /**
+   * True if a valid solution was found for at least one tile
+   */
+  bool valid = false;
+
+  /**
+   * Index of the best tile (most final inliers), -1 if none
+   */
+  int tile = -1;
+
+  /**
+   * Transformation from the query frame to the map frame, solved against the best tile
+   */
+  RegistrationSolution solution;
+
+  /**
+   * Correspondences between the query and the best tile, as (query index, tile index) pairs
+   */
+  std::vector<std::pair<int, int>> correspondences;
+
+  /**
+   * Indices into correspondences of the final inliers
+   */
+  std::vector<int> inliers;
+
+  /**
+   * Candidate tiles that were solved, and the number of final inliers found for each
+   */
+  std::vector<int> candidate_tiles;
+  std::vector<size_t> candidate_inliers;
+};
+
+/**
+ * Global relocalization of scans against a prebuilt map, split into tiles.
+ *
+ * The map side is prepared once: FPFH features are computed for each tile and indexed in a
+ * KD-tree, and both stay in memory. Each query then only computes the FPFH features of the query
+ * scan, matches them against the index of every tile (optionally keeping mutual nearest neighbors
+ * only), and solves the registration problems of the tiles with the most correspondences as a
+ * batch, in parallel over the tiles. The query is localized in the tile with the most inliers.
+ *
+ * Queries are not thread-safe; the batch of each query is parallelized with OpenMP.
+ */
+class LocalizationEngine {
+public:
+  struct Params {
+    /**
+     * Params of the registration solves (noise bound in map units)
+     */
+    RobustRegistrationSolver::Params solver_params;
+
+    /**
+     * FPFH radii, for both the map tiles and the queries
+     */
+    double normal_search_radius = 0.03;
+    double fpfh_search_radius = 0.05;
+
+    /**
+     * Only keep correspondences whose query and tile features are mutual nearest neighbors
+     */
+    bool use_crosscheck = true;
+
+    /**
+     * Number of tiles with the most correspondences to solve for. 0 to solve all tiles.
+     */
+    size_t max_candidate_tiles = 8;
+
+    /**
+     * Tiles with fewer correspondences are not solved for
+     */
+    size_t min_correspondences = 3;
+  };
+
+  LocalizationEngine() = default;
+
+  /**
+   * @param params
+   */
+  explicit LocalizationEngine(const Params& params) : params_(params) {}
+
+  /**
+   * Add a map tile: compute its features and index them. Points are in the map frame.
+   * @param points
+   * @return index of the tile
+   */
+  int addTile(const PointCloud& points);
+
+  /**
+   * Localize a query scan against the map.
+   * @param query points in the query (sensor) frame
+   * @return
+   */
+  LocalizationResult localize(const PointCloud& query);
+
+  /**
+   * @return number of map tiles
+   */
+  size_t numTiles() const { return tiles_.size(); }
+
+  /**
+   * @return stats of all queries so far
+   */
+  LocalizationStats getStats() const { return stats_; }
+
+  /**
+   * Reset the stats
+   */
+  void resetStats() { stats_ = LocalizationStats(); }
+
+  /**
+   * @return the params
+   */
+  Params getParams() const { return params_; }
+
+private:
+  using KDTree = flann::Index<flann::L2<float>>;
+
+  /**
+   * Features of a point cloud, with a KD-tree over them
+   */
+  struct FeatureIndex {
+    // Row-major N-by-33 descriptors; the tree refers to this storage
+    std::vector<float> descriptors;
+    size_t num_features = 0;
+    std::unique_ptr<KDTree> tree;
+
+    /**
+     * @return a view of the descriptor of feature i
+     */
+    flann::Matrix<float> row(size_t i) {
+      return flann::Matrix<float>(descriptors.data() + i * DESCRIPTOR_SIZE, 1, DESCRIPTOR_SIZE);
+    }
+  };
+
+  struct Tile {
+    Eigen::Matrix<double, 3, Eigen::Dynamic> points;
+    FeatureIndex index;
+  };
+
+  static constexpr size_t DESCRIPTOR_SIZE = 33;
+
+  /**
+   * Compute the FPFH features of a point cloud and index them.
+   * @param points
+   * @param index [out]
+   */
+  void buildFeatureIndex(const PointCloud& points, FeatureIndex* index);
+
+  /**
+   * Match the query features against a tile.
+   * @param query
+   * @param tile
+   * @return (query index, tile index) pairs
+   */
+  std::vector<std::pair<int, int>> match(FeatureIndex* query, FeatureIndex* tile) const;
+
+  Params params_;
+  std::vector<std::unique_ptr<Tile>> tiles_;
+  FPFHEstimation fpfh_;
+  LocalizationStats stats_;
+};
+
+} // namespace teaser
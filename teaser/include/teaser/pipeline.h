@@ -0,0 +1,250 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "teaser/graph.h"
+#include "teaser/registration.h"
+
+namespace teaser {
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ */
+template <class T> class SPSCQueue {
+public:
+  explicit SPSCQueue(size_t capacity) : slots_(capacity + 1) {}
+
+  /**
+   * Push an element if the queue is not full. Only call from the producer thread.
+   * @param value moved from only if pushed
+   * @return true if pushed
+   */
+  bool tryPush(T&& value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t next = (tail + 1) % slots_.size();
+    if (next == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slots_[tail] = std::move(value);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Pop an element if the queue is not empty. Only call from the consumer thread.
+   * @param value [out]
+   * @return true if popped
+   */
+  bool tryPop(T* value) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *value = std::move(slots_[head]);
+    head_.store((head + 1) % slots_.size(), std::memory_order_release);
+    return true;
+  }
+
+private:
+  // One slot is left empty to tell a full queue from an empty one
+  std::vector<T> slots_;
+
+  // Head and tail are written by different threads; keep them on separate cache lines
+  std::atomic<size_t> head_{0};
+  char padding_[64];
+  std::atomic<size_t> tail_{0};
+};
+
+/**
+ * Streaming registration of a sequence of independent problems (e.g., consecutive scan pairs),
+ * overlapping the stages of consecutive problems: while problem k is in max clique search,
+ * rotation and translation estimation on one thread, TIMs, scale and inlier graph of problem k+1
+ * are computed on another. Problems are handed between the caller and the two stage threads
+ * through bounded lock-free queues, and the results come out in the order the problems were
+ * pushed. Threads waiting on a queue spin briefly, then block until the queues change, so idle
+ * stages do not use any core.
+ *
+ * Each problem is solved as by a RobustRegistrationSolver constructed with the provided params.
+ * Both stages parallelize internally with OpenMP as usual; set num_front_threads /
+ * num_back_threads to split the cores between them.
+ *
+ * One thread may push problems while another pops results, but pushes (and pops) must not be
+ * called concurrently from several threads. The queues are bounded, so results have to be popped
+ * for the pipeline to keep accepting problems.
+ */
+class RegistrationPipeline {
+public:
+  struct Params {
+    /**
+     * Capacity of each of the queues (before the first stage, between the stages and after the
+     * second stage). Small capacities bound the latency of each problem.
+     */
+    size_t queue_capacity = 2;
+
+    /**
+     * Number of OpenMP threads used by the TIMs, scale and inlier graph stage. 0 to use the OpenMP
+     * default.
+     */
+    int num_front_threads = 0;
+
+    /**
+     * Number of OpenMP threads used by the max clique, rotation and translation stage. 0 to use the
+     * OpenMP default. This also sets the number of PMC threads, which otherwise search the max
+     * clique on a single thread (overriding the max_clique_num_threads of the solver params).
+     */
+    int num_back_threads = 0;
+  };
+
+  /**
+   * The output of the pipeline for one problem
+   */
+  struct Result {
+    RegistrationSolution solution;
+    RegistrationStats stats;
+
+    // Indices of the final inliers among the measurements of the problem
+    std::vector<int> inliers;
+  };
+
+  /**
+   * Start the pipeline with the default pipeline params.
+   * @param solver_params params of the solvers of both stages
+   */
+  explicit RegistrationPipeline(const RobustRegistrationSolver::Params& solver_params);
+
+  /**
+   * Start the pipeline.
+   * @param solver_params params of the solvers of both stages
+   * @param pipeline_params
+   */
+  RegistrationPipeline(const RobustRegistrationSolver::Params& solver_params,
+                       const Params& pipeline_params);
+
+  /**
+   * Stop the stage threads. Problems still in flight are dropped.
+   */
+  ~RegistrationPipeline();
+
+  RegistrationPipeline(const RegistrationPipeline&) = delete;
+  RegistrationPipeline& operator=(const RegistrationPipeline&) = delete;
+
+  /**
+   * Add a problem to the pipeline, waiting while the input queue is full.
+   * @param problem
+   */
+  void push(RegistrationProblem problem);
+
+  /**
+   * Add a problem to the pipeline if the input queue is not full.
+   * @param problem moved from only if added
+   * @return true if added
+   */
+  bool tryPush(RegistrationProblem& problem);
+
+  /**
+   * Wait for the result of the oldest problem still in the pipeline.
+   * @param result [out]
+   * @return false (without waiting) if no problem is in the pipeline
+   */
+  bool pop(Result* result);
+
+  /**
+   * Get the result of the oldest problem still in the pipeline, if it is done.
+   * @param result [out]
+   * @return true if a result was returned
+   */
+  bool tryPop(Result* result);
+
+  /**
+   * @return number of problems pushed and not popped yet
+   */
+  size_t numInFlight() const { return num_in_flight_.load(std::memory_order_acquire); }
+
+private:
+  /**
+   * A problem moving through the pipeline, with the state handed from the first stage to the
+   * second
+   */
+  struct Frame {
+    RegistrationProblem problem;
+    teaser::Graph inlier_graph;
+    std::vector<int> sample_indices;
+    RegistrationSolution solution;
+    RegistrationStats stats;
+
+    // True if the first stage already produced the final solution (e.g., when cancelled)
+    bool done = false;
+
+    std::vector<int> inliers;
+  };
+
+  /**
+   * Loop of the TIMs, scale and inlier graph stage
+   */
+  void runFrontStage();
+
+  /**
+   * Loop of the max clique, rotation and translation stage
+   */
+  void runBackStage();
+
+  /**
+   * Push a frame, waiting while the queue is full.
+   * @return false if the pipeline was stopped while waiting
+   */
+  bool waitPush(SPSCQueue<std::unique_ptr<Frame>>* queue, std::unique_ptr<Frame> frame);
+
+  /**
+   * Pop a frame, waiting while the queue is empty.
+   * @return false if the pipeline was stopped while waiting
+   */
+  bool waitPop(SPSCQueue<std::unique_ptr<Frame>>* queue, std::unique_ptr<Frame>* frame);
+
+  /**
+   * Wake up the threads blocked in waitForChange(). Call after each push or pop on a queue, and
+   * when stopping.
+   */
+  void notifyChange();
+
+  /**
+   * Block until notifyChange() is called after epoch_ was read as the provided value.
+   * @param epoch value of epoch_ read before the failed attempt on the queue
+   */
+  void waitForChange(uint64_t epoch);
+
+  RobustRegistrationSolver::Params solver_params_;
+  Params params_;
+
+  SPSCQueue<std::unique_ptr<Frame>> input_queue_;
+  SPSCQueue<std::unique_ptr<Frame>> graph_queue_;
+  SPSCQueue<std::unique_ptr<Frame>> output_queue_;
+
+  std::atomic<bool> stop_{false};
+  std::atomic<size_t> num_in_flight_{0};
+
+  // Number of pushes and pops on the queues (and stops), and the threads blocked waiting for it to
+  // change
+  std::atomic<uint64_t> epoch_{0};
+  std::atomic<int> num_waiting_{0};
+  std::mutex mutex_;
+  std::condition_variable changed_;
+
+  std::thread front_thread_;
+  std::thread back_thread_;
+};
+
+} // namespace teaser
@@ -0,0 +1,202 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "teaser/graph.h"
+#include "teaser/registration.h"
+
+namespace teaser {
+
+/**
+ * Struct to hold solution to a planar (2D) registration problem
+ */
+struct PlanarRegistrationSolution {
+  bool valid = true;
+  double scale;
+  Eigen::Vector2d translation;
+  Eigen::Matrix2d rotation;
+
+  /**
+   * True if the solve was stopped through the cancellation token of the params. The solution is
+   * then invalid.
+   */
+  bool cancelled = false;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/**
+ * Solve planar registration problems (e.g., from 2D lidar scans) robustly.
+ *
+ * This is the 2D counterpart of RobustRegistrationSolver: it runs the same TIM, scale pruning,
+ * max clique, GNC-TLS rotation and TLS translation stages, but directly on 2-by-N measurements. The
+ * rotation is a 2x2 matrix estimated in closed form from weighted dot and cross products (no SVD),
+ * and translation is estimated with two scalar TLS passes.
+ *
+ * The rotation_estimation_algorithm param is ignored; GNC-TLS is always used. The cancellation
+ * token is polled between the stages and within the TLS and GNC-TLS loops, and the max clique
+ * params (including the thread count and the dense graph path) are passed on as in the 3D solver.
+ */
+class PlanarRegistrationSolver {
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  using Params = RobustRegistrationSolver::Params;
+  using INLIER_SELECTION_MODE = RobustRegistrationSolver::INLIER_SELECTION_MODE;
+
+  PlanarRegistrationSolver() = default;
+
+  /**
+   * A constructor that takes in parameters.
+   * @param params
+   */
+  explicit PlanarRegistrationSolver(const Params& params) : params_(params) {}
+
+  /**
+   * Given a 2-by-N matrix representing points, return Translation Invariant Measurements (TIMs)
+   * @param v a 2-by-N matrix
+   * @param map (output) a 2-by-(N-1)*N/2 matrix holding the indices used for each TIM, or nullptr
+   * if not needed
+   * @return a 2-by-(N-1)*N/2 matrix representing TIMs
+   */
+  Eigen::Matrix<double, 2, Eigen::Dynamic>
+  computeTIMs(const Eigen::Matrix<double, 2, Eigen::Dynamic>& v,
+              Eigen::Matrix<int, 2, Eigen::Dynamic>* map);
+
+  /**
+   * Solve for scale, translation and rotation. Assumes dst is src after transformation.
+   * @param src
+   * @param dst
+   */
+  PlanarRegistrationSolution solve(const Eigen::Matrix<double, 2, Eigen::Dynamic>& src,
+                                   const Eigen::Matrix<double, 2, Eigen::Dynamic>& dst);
+
+  /**
+   * Solve for scale from TIMs. Assume v2 = s * R * v1, this function estimates s.
+   * @param v1
+   * @param v2
+   */
+  double solveForScale(const Eigen::Matrix<double, 2, Eigen::Dynamic>& v1,
+                       const Eigen::Matrix<double, 2, Eigen::Dynamic>& v2);
+
+  /**
+   * Solve for rotation with GNC-TLS. Assume v2 = R * v1, this function estimates R.
+   * @param v1
+   * @param v2
+   */
+  Eigen::Matrix2d solveForRotation(const Eigen::Matrix<double, 2, Eigen::Dynamic>& v1,
+                                   const Eigen::Matrix<double, 2, Eigen::Dynamic>& v2);
+
+  /**
+   * Solve for translation. Assume v2 = v1 + t, this function estimates t.
+   * @param v1
+   * @param v2
+   */
+  Eigen::Vector2d solveForTranslation(const Eigen::Matrix<double, 2, Eigen::Dynamic>& v1,
+                                      const Eigen::Matrix<double, 2, Eigen::Dynamic>& v2);
+
+  /**
+   * Return the solution to the registration problem.
+   * @return
+   */
+  inline PlanarRegistrationSolution getSolution() { return solution_; }
+
+  /**
+   * Return the cost at termination of the GNC-TLS rotation solver.
+   * @return cost at termination. Undefined if run before running the solver.
+   */
+  inline double getGNCRotationCostAtTermination() { return rotation_cost_; }
+
+  /**
+   * Return a boolean Eigen row vector indicating whether specific TIMs are inliers according to
+   * scales.
+   * @return a 1-by-(number of TIMs) boolean Eigen matrix
+   */
+  inline Eigen::Matrix<bool, 1, Eigen::Dynamic> getScaleInliersMask() {
+    return scale_inliers_mask_;
+  }
+
+  /**
+   * Return the index map for scale inliers (equivalent to the index map for TIMs).
+   * @return a 2-by-(number of TIMs) Eigen matrix.
+   */
+  inline Eigen::Matrix<int, 2, Eigen::Dynamic> getScaleInliersMap() { return tims_map_; }
+
+  /**
+   * Return the max clique of the inlier graph.
+   * @return a vector of indices of measurements within the max clique
+   */
+  inline std::vector<int> getInlierMaxClique() { return max_clique_; }
+
+  /**
+   * Return inliers from rotation estimation
+   * @return a vector of indices of measurements deemed as inliers by rotation estimation
+   */
+  inline std::vector<int> getRotationInliers() { return rotation_inliers_; }
+
+  /**
+   * Return inliers from translation estimation (final inliers)
+   * @return a vector of indices of measurements deemed as inliers by translation estimation
+   */
+  inline std::vector<int> getTranslationInliers() { return translation_inliers_; }
+
+  /**
+   * Reset the solver using the provided params
+   * @param params a Params struct
+   */
+  void reset(const Params& params) { params_ = params; }
+
+  /**
+   * Return the params
+   * @return a Params struct
+   */
+  Params getParams() { return params_; }
+
+private:
+  /**
+   * If the cancellation token of the params is cancelled, mark the solution as invalid and
+   * cancelled.
+   * @return true if cancelled
+   */
+  bool stopIfCancelled();
+
+  Params params_;
+  PlanarRegistrationSolution solution_;
+  double rotation_cost_ = 0;
+
+  // Inlier Binary Vectors
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> scale_inliers_mask_;
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> rotation_inliers_mask_;
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> translation_inliers_mask_;
+
+  // TIMs
+  Eigen::Matrix<double, 2, Eigen::Dynamic> src_tims_;
+  Eigen::Matrix<double, 2, Eigen::Dynamic> dst_tims_;
+  Eigen::Matrix<int, 2, Eigen::Dynamic> tims_map_;
+
+  // Max clique vector
+  std::vector<int> max_clique_;
+
+  // Inliers after rotation estimation
+  std::vector<int> rotation_inliers_;
+
+  // Inliers after translation estimation (final inliers)
+  std::vector<int> translation_inliers_;
+
+  // Inlier graph
+  teaser::Graph inlier_graph_;
+
+  ScalarTLSEstimator tls_estimator_;
+};
+
+} // namespace teaser
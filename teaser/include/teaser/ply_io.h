@@ -8,6 +8,11 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include "teaser/geometry.h"
 
 namespace teaser {
@@ -25,10 +30,118 @@ public:
 
   /**
    * @brief A wrapper function for reading ply files into PointCloud
+   *
+   * The vertices are appended to the cloud. Files go through MappedPLYFile (binary vertices are
+   * copied, ASCII vertices parsed in parallel, straight into the presized cloud), and the layouts
+   * it does not support through tinyply.
    */
   int read(const std::string& file_name, PointCloud& cloud);
 };
 
+/**
+ * @brief Layout of the vertex positions in a PLY file, as described by its header.
+ */
+struct PLYVertexLayout {
+  enum class Format { ASCII, BINARY_LITTLE_ENDIAN, BINARY_BIG_ENDIAN };
+
+  Format format = Format::ASCII;
+
+  // Number of vertices
+  size_t num_vertices = 0;
+
+  // Size of the header, i.e., offset of the first element in the file, in bytes
+  size_t header_size = 0;
+
+  // Offset of the first vertex in the file, in bytes
+  size_t vertex_data_offset = 0;
+
+  // ASCII format: indices of x, y and z among the properties of a vertex
+  size_t x_index = 0;
+  size_t y_index = 0;
+  size_t z_index = 0;
+
+  // Binary formats: size of a vertex and offsets of x, y and z within a vertex, in bytes
+  size_t stride = 0;
+  size_t x_offset = 0;
+  size_t y_offset = 0;
+  size_t z_offset = 0;
+
+  // Binary formats: size of each coordinate, 4 (float32) or 8 (float64)
+  size_t coordinate_size = 0;
+};
+
+/**
+ * @brief A PLY file mapped in memory, for reading large point clouds (e.g., map tiles of millions
+ * of points) without staging copies.
+ *
+ * The header is parsed and the layout of the vertex positions validated when opening the file.
+ * Binary vertices are then either read in place through points() (float32 x, y and z only, in the
+ * byte order of the host), or with a single strided copy into a presized PointCloud with
+ * readVertices(). ASCII vertices are parsed by readVertices() in parallel: the vertex lines are
+ * split in chunks at line boundaries, and each chunk is parsed straight into the presized cloud.
+ */
+class MappedPLYFile {
+public:
+  MappedPLYFile() = default;
+  MappedPLYFile(const MappedPLYFile&) = delete;
+  MappedPLYFile& operator=(const MappedPLYFile&) = delete;
+  ~MappedPLYFile() { close(); }
+
+  /**
+   * @brief Map a PLY file and parse its header
+   * @param file_name
+   * @return 0 if the file is mapped and has x, y and z vertex properties, -1 otherwise (see
+   * error())
+   */
+  int open(const std::string& file_name);
+
+  /**
+   * @brief Unmap the file. Invalidates the pointers returned by points().
+   */
+  void close();
+
+  /**
+   * @return layout of the vertex positions, valid after a successful open()
+   */
+  const PLYVertexLayout& vertexLayout() const { return layout_; }
+
+  /**
+   * @return number of vertices
+   */
+  size_t numVertices() const { return layout_.num_vertices; }
+
+  /**
+   * @brief Zero-copy view of the vertices
+   * @return pointer to the numVertices() points in the mapped file, or nullptr if the layout of
+   * the vertices is not the one of PointXYZ
+   */
+  const PointXYZ* points() const;
+
+  /**
+   * @brief Append the vertices to a cloud: one strided copy for binary files (converting doubles
+   * and swapping the byte order if needed), a parallel parse for ASCII files
+   * @param cloud
+   * @return 0 on success, -1 if the vertices cannot be read (see error())
+   */
+  int readVertices(PointCloud& cloud);
+
+  /**
+   * @return reason of the last failure
+   */
+  const std::string& error() const { return error_; }
+
+private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+
+  // Whether data_ is mapped (rather than pointing to buffer_, on platforms without mmap)
+  bool mapped_ = false;
+  std::vector<uint8_t> buffer_;
+
+  PLYVertexLayout layout_;
+  std::string error_;
+};
+
 /**
  * @brief A class for writing PLY files.
  */
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <tuple>
@@ -16,35 +17,216 @@
 #include <Eigen/SVD>
 #include <Eigen/Geometry>
 
+#include "teaser/cancellation.h"
 #include "teaser/graph.h"
 #include "teaser/geometry.h"
+#include "teaser/workspace.h"
 
 // TODO: might be a good idea to template Eigen::Vector3f and Eigen::VectorXf such that later on we
 // can decide to use doulbe if we want. Double vs float might give nontrivial differences..
 
 namespace teaser {
 
+class RegistrationContext;
+
+/**
+ * Read-only view of a 3-by-N matrix of measurements. Binds to 3-by-N Eigen matrices, maps and
+ * column blocks without copying.
+ */
+using MeasurementsRef = Eigen::Ref<const Eigen::Matrix<double, 3, Eigen::Dynamic>>;
+
+/**
+ * Read-only view of a 3-by-M matrix of single precision points, with an arbitrary stride between
+ * consecutive points. Binds to 3-by-M float matrices and to maps over strided point buffers (e.g.,
+ * xyz followed by padding) without copying.
+ */
+using PointsRef =
+    Eigen::Ref<const Eigen::Matrix<float, 3, Eigen::Dynamic>, 0, Eigen::OuterStride<>>;
+
+/**
+ * Read-only view of a vector of point indices, with an arbitrary stride between consecutive
+ * indices.
+ */
+using IndicesRef = Eigen::Ref<const Eigen::VectorXi, 0, Eigen::InnerStride<>>;
+
 /**
  * Struct to hold solution to a registration problem
  */
 struct RegistrationSolution {
+  /**
+   * Stages of RobustRegistrationSolver::solve, in order
+   */
+  enum class STAGE {
+    TIMS = 0,
+    SCALE = 1,
+    INLIER_GRAPH = 2,
+    MAX_CLIQUE = 3,
+    ROTATION = 4,
+    TRANSLATION = 5,
+    DONE = 6,
+  };
+
   bool valid = true;
   double scale;
   Eigen::Vector3d translation;
   Eigen::Matrix3d rotation;
 
+  /**
+   * True if the solve was stopped through the cancellation token of the params. The solution is
+   * then invalid.
+   */
+  bool cancelled = false;
+
+  /**
+   * Stage the solve stopped in (when cancelled or invalid), DONE otherwise
+   */
+  STAGE stage = STAGE::DONE;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/**
+ * Struct to hold per-stage wall times and problem sizes of one solve, to find out which stage
+ * dominates the run time. Stages that are not run keep their default values.
+ */
+struct RegistrationStats {
+  /**
+   * Wall times of each stage, in seconds
+   */
+  double tims_time = 0;
+  double scale_time = 0;
+  double graph_time = 0;
+  double clique_time = 0;
+  double rotation_time = 0;
+  double translation_time = 0;
+
+  /**
+   * Number of measurements (correspondences), N
+   */
+  size_t num_measurements = 0;
+
+  /**
+   * Number of TIMs, N * (N - 1) / 2
+   */
+  size_t num_tims = 0;
+
+  /**
+   * Number of TIMs the scale was estimated on when subsampling (see
+   * RobustRegistrationSolver::Params::scale_estimation_sample_size), 0 otherwise
+   */
+  size_t scale_sample_size = 0;
+
+  /**
+   * Standard error of the scale estimated on the subsample: the scale is within 1.96 standard
+   * errors of the estimate with about 95% confidence. 0 if not subsampling.
+   */
+  double scale_standard_error = 0;
+
+  /**
+   * Fractions of scale inliers among the subsampled TIMs and among all TIMs. A large gap between
+   * the two hints that the subsample missed the consensus of all the TIMs. 0 if not subsampling.
+   */
+  double scale_sample_inlier_ratio = 0;
+  double scale_inlier_ratio = 0;
+
+  /**
+   * Number of edges of the inlier graph, i.e., number of TIMs that are scale inliers
+   */
+  size_t num_edges = 0;
+
+  /**
+   * Ratio between the number of edges and the number of edges of the complete graph
+   */
+  double graph_density = 0;
+
+  /**
+   * Max core number of the inlier graph, -1 if not computed (dense inlier graphs skip it, see
+   * Params::dense_graph_threshold)
+   */
+  int max_core = 0;
+
+  /**
+   * Number of measurements in the max clique (or all measurements without inlier selection)
+   */
+  size_t clique_size = 0;
+
+  /**
+   * Number of iterations run by the GNC rotation solver
+   */
+  size_t rotation_iterations = 0;
+
+  /**
+   * Number of inliers after rotation and translation estimation
+   */
+  size_t num_rotation_inliers = 0;
+  size_t num_translation_inliers = 0;
+};
+
+/**
+ * Struct to hold one registration hypothesis, i.e., the solution obtained from one of several
+ * candidate cliques of the inlier graph.
+ */
+struct RegistrationHypothesis {
+  RegistrationSolution solution;
+
+  /**
+   * Indices of the measurements within the clique this hypothesis is built from
+   */
+  std::vector<int> clique;
+
+  /**
+   * Indices of the measurements deemed as inliers by rotation estimation
+   */
+  std::vector<int> rotation_inliers;
+
+  /**
+   * Indices of the measurements deemed as inliers by translation estimation (final inliers)
+   */
+  std::vector<int> translation_inliers;
+
+  /**
+   * Cost at termination of the GNC rotation solver
+   */
+  double rotation_cost = 0;
+
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
 
+/**
+ * Struct to hold one registration problem of a batch. Assumes dst is src after transformation.
+ */
+struct RegistrationProblem {
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src;
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst;
+};
+
+/**
+ * A fixed set of source measurements with the norms of their TIMs computed once, for repeated
+ * solves against changing target measurements (e.g., object pose estimation against a fixed
+ * model). See RobustRegistrationSolver::prepareSource().
+ */
+struct PreparedSource {
+  Eigen::Matrix<double, 3, Eigen::Dynamic> measurements;
+
+  /**
+   * Norms of the TIMs of the measurements, in the layout of RobustRegistrationSolver::computeTIMs()
+   */
+  Eigen::Matrix<double, 1, Eigen::Dynamic> tim_norms;
+};
+
 /**
  * Abstract virtual class for decoupling specific scale estimation methods with interfaces.
+ *
+ * Implementations override solveForScale(). Those that can work on views without copying also
+ * override solveForScaleView(), which RobustRegistrationSolver calls; by default, it copies the
+ * views into matrices and calls solveForScale().
  */
 class AbstractScaleSolver {
 public:
   virtual ~AbstractScaleSolver() {}
 
   /**
-   * Pure virtual method for solving scale. Different implementations may have different assumptions
+   * Virtual method for solving scale. Different implementations may have different assumptions
    * about input data.
    * @param src
    * @param dst
@@ -53,18 +235,30 @@ public:
   virtual void solveForScale(const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
                              const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst, double* scale,
                              Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) = 0;
+
+  /**
+   * Same as solveForScale(), on views of the measurements.
+   */
+  virtual void solveForScaleView(const MeasurementsRef& src, const MeasurementsRef& dst,
+                                 double* scale, Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
+    solveForScale(src, dst, scale, inliers);
+  }
 };
 
 /**
  * Abstract virtual class for decoupling specific rotation estimation method implementations with
  * interfaces.
+ *
+ * Implementations override solveForRotation(). Those that can work on views without copying also
+ * override solveForRotationView(), which RobustRegistrationSolver calls; by default, it copies the
+ * views into matrices and calls solveForRotation().
  */
 class AbstractRotationSolver {
 public:
   virtual ~AbstractRotationSolver() {}
 
   /**
-   * Pure virtual method for solving rotation. Different implementations may have different
+   * Virtual method for solving rotation. Different implementations may have different
    * assumptions about input data.
    * @param src
    * @param dst
@@ -74,18 +268,31 @@ public:
                                 const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst,
                                 Eigen::Matrix3d* rotation,
                                 Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) = 0;
+
+  /**
+   * Same as solveForRotation(), on views of the measurements.
+   */
+  virtual void solveForRotationView(const MeasurementsRef& src, const MeasurementsRef& dst,
+                                    Eigen::Matrix3d* rotation,
+                                    Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
+    solveForRotation(src, dst, rotation, inliers);
+  }
 };
 
 /**
  * Abstract virtual class for decoupling specific translation estimation method implementations with
  * interfaces.
+ *
+ * Implementations override solveForTranslation(). Those that can work on views without copying
+ * also override solveForTranslationView(), which RobustRegistrationSolver calls; by default, it
+ * copies the views into matrices and calls solveForTranslation().
  */
 class AbstractTranslationSolver {
 public:
   virtual ~AbstractTranslationSolver() {}
 
   /**
-   * Pure virtual method for solving translation. Different implementations may have different
+   * Virtual method for solving translation. Different implementations may have different
    * assumptions about input data.
    * @param src
    * @param dst
@@ -95,10 +302,22 @@ public:
                                    const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst,
                                    Eigen::Vector3d* translation,
                                    Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) = 0;
+
+  /**
+   * Same as solveForTranslation(), on views of the measurements.
+   */
+  virtual void solveForTranslationView(const MeasurementsRef& src, const MeasurementsRef& dst,
+                                       Eigen::Vector3d* translation,
+                                       Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
+    solveForTranslation(src, dst, translation, inliers);
+  }
 };
 
 /**
  * Performs scalar truncated least squares estimation
+ *
+ * The estimator keeps its intermediate buffers across calls to reuse their memory, so an instance
+ * must not be used by several threads at once.
  */
 class ScalarTLSEstimator {
 public:
@@ -111,9 +330,14 @@ public:
    * @param ranges Maximum admissible errors for measurements X
    * @param estimate (output) pointer to a double holding the estimate
    * @param inliers (output) pointer to a Eigen row vector of inliers
+   * @param cancellation_token optional token polled once per block of 64 interval centers. Once
+   * cancelled, the remaining centers are skipped, and the outputs are only the best estimate among
+   * the centers already evaluated (an estimate of 0 if there are none).
    */
-  void estimate(const Eigen::RowVectorXd& X, const Eigen::RowVectorXd& ranges, double* estimate,
-                Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers);
+  void estimate(const Eigen::Ref<const Eigen::RowVectorXd>& X,
+                const Eigen::Ref<const Eigen::RowVectorXd>& ranges, double* estimate,
+                Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers,
+                const CancellationToken* cancellation_token = nullptr);
 
   /**
    * A slightly different implementation of TLS estimate. Use loop tiling to achieve potentially
@@ -126,6 +350,14 @@ public:
    */
   void estimate_tiled(const Eigen::RowVectorXd& X, const Eigen::RowVectorXd& ranges, const int& s,
                       double* estimate, Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers);
+
+private:
+  // Sorted interval bounds, interval centers, weights, and estimate and cost of each center
+  ColumnBuffer<double, 1> h_;
+  ColumnBuffer<double, 1> h_centers_;
+  ColumnBuffer<double, 1> weights_;
+  ColumnBuffer<double, 1> x_hat_;
+  ColumnBuffer<double, 1> x_cost_;
 };
 
 /**
@@ -133,10 +365,36 @@ public:
  */
 class TLSScaleSolver : public AbstractScaleSolver {
 public:
+  /**
+   * Statistics of the last estimate made on a subsample of the TIMs
+   */
+  struct SampleStats {
+    // Number of TIMs in the subsample, 0 if the last estimate used all TIMs
+    size_t sample_size = 0;
+
+    // Standard error of the estimate, from the weighted residuals of the subsample inliers
+    double standard_error = 0;
+
+    // Fractions of inliers in the subsample and among all TIMs
+    double sample_inlier_ratio = 0;
+    double inlier_ratio = 0;
+  };
+
   TLSScaleSolver() = delete;
 
-  explicit TLSScaleSolver(double noise_bound, double cbar2)
-      : noise_bound_(noise_bound), cbar2_(cbar2) {
+  /**
+   * @param noise_bound
+   * @param cbar2
+   * @param sample_size if at least 2, estimate the scale on this many randomly sampled TIMs only
+   * (when there are more), then classify all TIMs against it. TLS estimation is quadratic in the
+   * number of TIMs, while classification is linear. 0 to always use all TIMs.
+   * @param cancellation_token optional token polled during the TLS estimation. Once cancelled,
+   * the estimate is meaningless and should be discarded.
+   */
+  explicit TLSScaleSolver(double noise_bound, double cbar2, size_t sample_size = 0,
+                          std::shared_ptr<CancellationToken> cancellation_token = nullptr)
+      : noise_bound_(noise_bound), cbar2_(cbar2), sample_size_(sample_size),
+        cancellation_token_(std::move(cancellation_token)) {
     assert(noise_bound > 0);
     assert(cbar2 > 0);
   };
@@ -149,12 +407,45 @@ public:
    */
   void solveForScale(const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
                      const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst, double* scale,
-                     Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override;
+                     Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override {
+    solveForScaleView(src, dst, scale, inliers);
+  }
+
+  /**
+   * Same as solveForScale(), without copying the views.
+   */
+  void solveForScaleView(const MeasurementsRef& src, const MeasurementsRef& dst, double* scale,
+                         Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override;
+
+  /**
+   * Same as solveForScale(), from the norms of the TIMs.
+   * @param src_norms norms of the src TIMs
+   * @param dst_norms norms of the dst TIMs
+   * @param scale [out]
+   * @param inliers [out]
+   */
+  void solveForScaleFromNorms(const Eigen::Ref<const Eigen::RowVectorXd>& src_norms,
+                              const Eigen::Ref<const Eigen::RowVectorXd>& dst_norms, double* scale,
+                              Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers);
+
+  /**
+   * @return statistics of the last estimate, if it was made on a subsample
+   */
+  SampleStats getSampleStats() const { return sample_stats_; }
 
 private:
   double noise_bound_;
   double cbar2_; // maximal allowed residual^2 to noise bound^2 ratio
+  size_t sample_size_;
+  std::shared_ptr<CancellationToken> cancellation_token_;
+  SampleStats sample_stats_;
   ScalarTLSEstimator tls_estimator_;
+
+  // TIM norms, and raw scales and error bounds of the estimated TIMs, kept to reuse their memory
+  ColumnBuffer<double, 1> src_norms_;
+  ColumnBuffer<double, 1> dst_norms_;
+  ColumnBuffer<double, 1> raw_scales_;
+  ColumnBuffer<double, 1> alphas_;
 };
 
 /**
@@ -177,11 +468,42 @@ public:
    */
   void solveForScale(const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
                      const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst, double* scale,
-                     Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override;
+                     Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override {
+    solveForScaleView(src, dst, scale, inliers);
+  }
+
+  /**
+   * Same as solveForScale(), without copying the views.
+   */
+  void solveForScaleView(const MeasurementsRef& src, const MeasurementsRef& dst, double* scale,
+                         Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override;
+
+  /**
+   * Same as solveForScale(), from the norms of the TIMs.
+   * @param src_norms norms of the src TIMs
+   * @param dst_norms norms of the dst TIMs
+   * @param scale [out] a constant of 1
+   * @param inliers [out]
+   */
+  void solveForScaleFromNorms(const Eigen::Ref<const Eigen::RowVectorXd>& src_norms,
+                              const Eigen::Ref<const Eigen::RowVectorXd>& dst_norms, double* scale,
+                              Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers);
+
+  /**
+   * Same test as solveForScale(), as a packed bitmask (see kernels::scaleInliersMask()).
+   * @param src [in] a vector of points
+   * @param dst [in] a vector of points
+   * @param mask [out] bit i % 64 of word i / 64 is set iff measurement i is an inlier
+   */
+  void selectInliers(const MeasurementsRef& src, const MeasurementsRef& dst,
+                     std::vector<uint64_t>* mask) const;
 
 private:
   double noise_bound_;
   double cbar2_; // maximal allowed residual^2 to noise bound^2 ratio
+
+  // Packed mask of the last solveForScale(), kept to reuse its memory
+  std::vector<uint64_t> mask_;
 };
 
 /**
@@ -204,12 +526,25 @@ public:
   void solveForTranslation(const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
                            const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst,
                            Eigen::Vector3d* translation,
-                           Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override;
+                           Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override {
+    solveForTranslationView(src, dst, translation, inliers);
+  }
+
+  /**
+   * Same as solveForTranslation(), without copying the views.
+   */
+  void solveForTranslationView(const MeasurementsRef& src, const MeasurementsRef& dst,
+                               Eigen::Vector3d* translation,
+                               Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override;
 
 private:
   double noise_bound_;
   double cbar2_; // maximal allowed residual^2 to noise bound^2 ratio
   ScalarTLSEstimator tls_estimator_;
+
+  // One component of the raw translations, and the error bounds, kept to reuse their memory
+  ColumnBuffer<double, 1> raw_translation_;
+  ColumnBuffer<double, 1> alphas_;
 };
 
 /**
@@ -223,6 +558,22 @@ public:
     double cost_threshold;
     double gnc_factor;
     double noise_bound;
+
+    /**
+     * Set to true to also terminate once the binary inlier set (measurements with residuals within
+     * the noise bound) has not changed, and the rotation has changed by less than
+     * rotation_delta_threshold (Frobenius norm), for stable_inliers_iterations consecutive
+     * iterations. Only used by solvers that support it (GNC-TLS).
+     */
+    bool stop_on_stable_inliers = false;
+    size_t stable_inliers_iterations = 2;
+    double rotation_delta_threshold = 1e-6;
+
+    /**
+     * Optional token polled before each iteration after the first one. Once cancelled, the solver
+     * returns the estimate of the last completed iteration. Only used by GNC-TLS and FGR.
+     */
+    std::shared_ptr<CancellationToken> cancellation_token;
   };
 
   GNCRotationSolver(Params params) : params_(params) {}
@@ -239,9 +590,17 @@ public:
    */
   double getCostAtTermination() { return cost_; }
 
+  /**
+   * Return the number of iterations run by the GNC solver.
+   *
+   * @return number of iterations at termination. Undefined if run before running the solver.
+   */
+  size_t getIterationsAtTermination() { return iterations_; }
+
 protected:
   Params params_;
   double cost_;
+  size_t iterations_ = 0;
 };
 
 /**
@@ -272,7 +631,23 @@ public:
   void solveForRotation(const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
                         const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst,
                         Eigen::Matrix3d* rotation,
-                        Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override;
+                        Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override {
+    solveForRotationView(src, dst, rotation, inliers);
+  }
+
+  /**
+   * Same as solveForRotation(), without copying the views.
+   */
+  void solveForRotationView(const MeasurementsRef& src, const MeasurementsRef& dst,
+                            Eigen::Matrix3d* rotation,
+                            Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override;
+
+private:
+  // GNC weights, squared residuals and binary inlier sets, kept to reuse their memory
+  ColumnBuffer<double, 1> weights_;
+  ColumnBuffer<double, 1> residuals_sq_;
+  ColumnBuffer<bool, 1> binary_inliers_;
+  ColumnBuffer<bool, 1> prev_binary_inliers_;
 };
 
 /**
@@ -309,7 +684,75 @@ public:
   void solveForRotation(const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
                         const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst,
                         Eigen::Matrix3d* rotation,
-                        Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override;
+                        Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override {
+    solveForRotationView(src, dst, rotation, inliers);
+  }
+
+  /**
+   * Same as solveForRotation(), without copying the views.
+   */
+  void solveForRotationView(const MeasurementsRef& src, const MeasurementsRef& dst,
+                            Eigen::Matrix3d* rotation,
+                            Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override;
+};
+
+/**
+ * Solve for a rotation about a known gravity direction (yaw only) using an exact truncated
+ * least squares sweep over the rotation angle.
+ *
+ * Both src and dst are assumed to be expressed in gravity-aligned frames sharing the same gravity
+ * direction, so the unknown rotation has a single degree of freedom. For each measurement, the set
+ * of angles for which its residual is within the noise bound is an arc on the circle; sweeping
+ * over the arc endpoints enumerates every possible inlier set, and the TLS cost restricted to
+ * each arc is minimized in closed form. The returned rotation is thus the global TLS minimizer.
+ *
+ * Only noise_bound is used from the params. The class derives from GNCRotationSolver so that it
+ * can be used with RobustRegistrationSolver::setRotationEstimator.
+ */
+class GravityAlignedYawRotationSolver : public GNCRotationSolver {
+public:
+  GravityAlignedYawRotationSolver() = delete;
+
+  /**
+   * Parametrized constructor
+   * @param params
+   * @param gravity gravity direction shared by the src and dst frames (does not need to be unit)
+   */
+  GravityAlignedYawRotationSolver(Params params, const Eigen::Vector3d& gravity);
+
+  /**
+   * Estimate the rotation about the gravity direction between src & dst.
+   * @param src
+   * @param dst
+   * @param rotation
+   * @param inliers
+   */
+  void solveForRotation(const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
+                        const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst,
+                        Eigen::Matrix3d* rotation,
+                        Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override {
+    solveForRotationView(src, dst, rotation, inliers);
+  }
+
+  /**
+   * Same as solveForRotation(), without copying the views.
+   */
+  void solveForRotationView(const MeasurementsRef& src, const MeasurementsRef& dst,
+                            Eigen::Matrix3d* rotation,
+                            Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override;
+
+  /**
+   * Return the estimated rotation angle (in radians) about the gravity direction.
+   * @return yaw angle at termination. Undefined if run before running the solver.
+   */
+  double getYawAtTermination() { return yaw_; }
+
+private:
+  // Unit gravity direction and an orthonormal basis of the plane perpendicular to it
+  Eigen::Vector3d gravity_;
+  Eigen::Vector3d axis_x_;
+  Eigen::Vector3d axis_y_;
+  double yaw_ = 0;
 };
 
 /**
@@ -409,6 +852,25 @@ public:
      */
     double rotation_cost_threshold = 1e-6;
 
+    /**
+     * Set to true to let the GNC-TLS rotation estimator terminate early once its binary inlier set
+     * is stable and the rotation barely changes between iterations. This usually happens many
+     * iterations before the cost converges to rotation_cost_threshold.
+     */
+    bool rotation_stop_on_stable_inliers = false;
+
+    /**
+     * Number of consecutive iterations the binary inlier set needs to be unchanged for early
+     * termination. Only used if rotation_stop_on_stable_inliers is true.
+     */
+    size_t rotation_stable_inliers_iterations = 2;
+
+    /**
+     * Maximum change of the rotation matrix (Frobenius norm) between consecutive iterations for
+     * early termination. Only used if rotation_stop_on_stable_inliers is true.
+     */
+    double rotation_delta_threshold = 1e-6;
+
     /**
      * \brief Type of the inlier selection
      */
@@ -445,6 +907,68 @@ public:
      * Time limit on running the max clique algorithm (in seconds).
      */
     double max_clique_time_limit = 3600;
+
+    /**
+     * Number of threads used by the max clique solver. See MaxCliqueSolver::Params::num_threads.
+     */
+    int max_clique_num_threads = 12;
+
+    /**
+     * Inlier graphs with an edge density of at least this value (e.g., when there are few
+     * outliers) skip PMC: the max clique is found as the complement of a minimum vertex cover of
+     * the few missing edges instead, which is exact and much cheaper. Set to a value above 1 to
+     * always use the selected inlier_selection_mode. See MaxCliqueSolver::Params.
+     */
+    double dense_graph_threshold = 0.9;
+
+    /**
+     * Maximum number of measurements left out of the max clique by the dense graph path. If more
+     * need to be left out, the selected inlier_selection_mode is used.
+     */
+    size_t dense_graph_max_cover_size = 64;
+
+    /**
+     * Set to a positive value M to solve problems with more than M measurements in two phases,
+     * reducing the O(N^2) cost of the TIMs and inlier graph to O(M^2 + N * clique size):
+     * 1. TIMs, scale, inlier graph and max clique are computed on M randomly sampled measurements.
+     * 2. Every other measurement is added to the clique if its TIMs with at least
+     *    inlier_graph_sample_verification_ratio of the clique members are scale inliers.
+     * The sample is drawn with a fixed seed, so solves are deterministic. Set to 0 to always use
+     * all measurements. Only used by solve(), with inlier_selection_mode other than NONE.
+     */
+    size_t inlier_graph_sample_size = 0;
+
+    /**
+     * Set to a value M of at least 2 to estimate the scale (with estimate_scaling) on M randomly
+     * sampled TIMs instead of all N*(N-1)/2, then classify all TIMs against that scale with the
+     * cheap inlier check. This bounds the quadratic cost of the TLS scale estimation to O(M^2),
+     * which makes scale estimation feasible for thousands of measurements. The sample is drawn
+     * with a fixed seed, and its statistical confidence is reported in the stats
+     * (RegistrationStats::scale_standard_error). Set to 0 to always use all TIMs.
+     */
+    size_t scale_estimation_sample_size = 0;
+
+    /**
+     * Fraction of the clique members a measurement has to be consistent with to be added to the
+     * clique in the verification phase of the sampled inlier graph.
+     */
+    double inlier_graph_sample_verification_ratio = 0.9;
+
+    /**
+     * Problems of a batch (see solveBatch) with at least this many correspondences are solved one
+     * at a time using all threads. Smaller problems are solved concurrently, one per thread.
+     */
+    size_t batch_cooperative_size = 1000;
+
+    /**
+     * Optional token to stop solving early, e.g., when the deadline of a control loop is missed.
+     * The stages poll it in between and within their long-running loops. A cancelled solve returns
+     * an invalid solution with cancelled set, and the stage it stopped in.
+     *
+     * The token is shared by all copies of the params, so it also stops solveBatch and
+     * solveMultiHypothesis.
+     */
+    std::shared_ptr<CancellationToken> cancellation_token;
   };
 
   RobustRegistrationSolver() = default;
@@ -477,39 +1001,167 @@ public:
    */
   RegistrationSolution solve(const teaser::PointCloud& src_cloud,
                              const teaser::PointCloud& dst_cloud,
-                             const std::vector<std::pair<int, int>> correspondences);
+                             const std::vector<std::pair<int, int>>& correspondences);
+
+  /**
+   * Solve for scale, translation and rotation, with the correspondences given as indices into two
+   * sets of points. The corresponding points are gathered (and converted to double) directly into
+   * buffers reused across solves, without intermediate copies.
+   *
+   * @param src_points 3-by-M source points (to be transformed)
+   * @param dst_points 3-by-K target points (after transformation)
+   * @param src_indices N indices into src_points
+   * @param dst_indices N indices into dst_points, dst_indices(i) corresponding to src_indices(i)
+   */
+  RegistrationSolution solve(const PointsRef& src_points, const PointsRef& dst_points,
+                             const IndicesRef& src_indices, const IndicesRef& dst_indices);
+
+  /**
+   * Solve for scale, translation and rotation, with the correspondences given as indices into two
+   * raw point buffers. Same as the PointsRef overload.
+   *
+   * @param src_points source points, the coordinates of point i starting at src_points[i * stride]
+   * @param dst_points target points, the coordinates of point i starting at dst_points[i * stride]
+   * @param point_stride number of floats between consecutive points (at least 3)
+   * @param src_indices N indices into src_points
+   * @param dst_indices N indices into dst_points
+   * @param num_correspondences N
+   */
+  RegistrationSolution solve(const float* src_points, const float* dst_points, size_t point_stride,
+                             const int* src_indices, const int* dst_indices,
+                             size_t num_correspondences);
 
   /**
    * Solve for scale, translation and rotation. Assumes v2 is v1 after transformation.
    * @param v1
    * @param v2
    */
-  RegistrationSolution solve(const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
-                             const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst);
+  RegistrationSolution solve(const MeasurementsRef& src, const MeasurementsRef& dst);
+
+  /**
+   * Prepare a fixed set of source measurements for solve(const PreparedSource&, dst), computing the
+   * norms of their TIMs once.
+   * @param src a 3-by-N matrix
+   */
+  static PreparedSource prepareSource(const MeasurementsRef& src);
+
+  /**
+   * Solve for scale, translation and rotation against a prepared source. Same as solve(src, dst)
+   * with src = source.measurements, but the TIM stage only computes the norms of the dst TIMs
+   * (the TIMs themselves are not formed, so getSrcTIMs() / getDstTIMs() are not updated).
+   *
+   * Only the scale estimators created from the params are supported (the estimator set by
+   * setScaleEstimator is not used), and inlier_graph_sample_size is ignored.
+   *
+   * @param source prepared with prepareSource()
+   * @param dst a 3-by-N matrix, dst(i) corresponding to source.measurements(i)
+   */
+  RegistrationSolution solve(const PreparedSource& source, const MeasurementsRef& dst);
+
+  /**
+   * Re-entrant solve: same as solve(src, dst), but all intermediate state (buffers, solvers,
+   * solution, stats and inliers) lives in the provided context instead of this solver, so that
+   * one configured solver can serve concurrent solves, each thread with its own context.
+   *
+   * Only the params of this solver are used (the estimators set by setScaleEstimator /
+   * setRotationEstimator / setTranslationEstimator are not), and they must not be changed (e.g.,
+   * with reset()) while solves are running. The getters of this solver are not updated; use the
+   * getters of the context instead. Buffers of the context are reused across its solves.
+   *
+   * @param src
+   * @param dst
+   * @param context [in/out] per-thread state, must not be used by two solves at the same time
+   */
+  RegistrationSolution solve(const MeasurementsRef& src, const MeasurementsRef& dst,
+                             RegistrationContext* context) const;
+
+  /**
+   * Solve for scale, translation and rotation under several hypotheses. Assumes dst is src after
+   * transformation.
+   *
+   * TIMs, scale and the inlier graph are computed once. Up to num_hypotheses vertex-disjoint
+   * cliques are then extracted from the inlier graph (see MaxCliqueSolver::findMaxCliques), and the
+   * rotation and translation stages are run on all of them concurrently. This is useful when the
+   * max clique is ambiguous, e.g., with symmetric or repetitive structures.
+   *
+   * The rotation and translation solvers for the hypotheses are created from the params (the
+   * estimators set by setRotationEstimator / setTranslationEstimator are not used), so that they
+   * can run in parallel. After solving, the solution and inlier getters reflect the best
+   * hypothesis.
+   *
+   * @param src
+   * @param dst
+   * @param num_hypotheses maximum number of hypotheses to return
+   * @return hypotheses ranked by number of final inliers (descending), then by rotation cost
+   * (ascending). Empty if no clique with more than one measurement is found.
+   */
+  std::vector<RegistrationHypothesis>
+  solveMultiHypothesis(const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
+                       const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst, size_t num_hypotheses);
+
+  /**
+   * Solve for scale, translation and rotation at several noise bounds, e.g., to pick the best one
+   * when the sensor noise is uncertain, or for coarse-to-fine registration. Assumes dst is src
+   * after transformation.
+   *
+   * TIMs are computed once. Without scale estimation, the inlier graphs of increasing noise bounds
+   * are nested: the TIMs are sorted by the noise bound at which they become edges, and added to one
+   * inlier graph as the noise bound increases. The max clique is only searched again when edges
+   * were added, and the clique of a smaller noise bound is kept if no larger one is found. With
+   * scale estimation, scale and inlier graph are recomputed from the TIMs for each noise bound (the
+   * scale also without inlier selection, as in solve()).
+   * Rotation and translation are then estimated for all noise bounds concurrently.
+   *
+   * Like solveMultiHypothesis, the rotation and translation solvers are created from the params,
+   * and inlier_graph_sample_size is ignored. Only the stats of this solver are updated.
+   *
+   * @param src
+   * @param dst
+   * @param noise_bounds noise bounds to solve at, in any order; params.noise_bound is not used
+   * @return one hypothesis per noise bound, in the same order (solution.valid is false if no clique
+   * with more than one measurement is found). Empty if cancelled.
+   */
+  std::vector<RegistrationHypothesis> solveNoiseBoundSweep(const MeasurementsRef& src,
+                                                           const MeasurementsRef& dst,
+                                                           const std::vector<double>& noise_bounds);
+
+  /**
+   * Solve a batch of independent registration problems, e.g., one query against many candidates.
+   *
+   * Problems smaller than params.batch_cooperative_size are distributed dynamically over the
+   * threads, largest first, with each problem solved single-threaded. Larger problems are solved
+   * one after the other, each using all threads. Every thread keeps its own solver, so buffers are
+   * reused across the problems it handles.
+   *
+   * Like solveMultiHypothesis, the solvers are created from the params (the estimators set by
+   * setScaleEstimator / setRotationEstimator / setTranslationEstimator are not used), and the
+   * solution and inlier getters of this solver are not updated.
+   *
+   * @param problems
+   * @return one solution per problem, in the same order
+   */
+  std::vector<RegistrationSolution> solveBatch(const std::vector<RegistrationProblem>& problems);
 
   /**
    * Solve for scale. Assume v2 = s * R * v1, this function estimates s.
    * @param v1
    * @param v2
    */
-  double solveForScale(const Eigen::Matrix<double, 3, Eigen::Dynamic>& v1,
-                       const Eigen::Matrix<double, 3, Eigen::Dynamic>& v2);
+  double solveForScale(const MeasurementsRef& v1, const MeasurementsRef& v2);
 
   /**
    * Solve for translation.
    * @param v1
    * @param v2
    */
-  Eigen::Vector3d solveForTranslation(const Eigen::Matrix<double, 3, Eigen::Dynamic>& v1,
-                                      const Eigen::Matrix<double, 3, Eigen::Dynamic>& v2);
+  Eigen::Vector3d solveForTranslation(const MeasurementsRef& v1, const MeasurementsRef& v2);
 
   /**
    * Solve for rotation. Assume v2 = R * v1, this function estimates find R.
    * @param v1
    * @param v2
    */
-  Eigen::Matrix3d solveForRotation(const Eigen::Matrix<double, 3, Eigen::Dynamic>& v1,
-                                   const Eigen::Matrix<double, 3, Eigen::Dynamic>& v2);
+  Eigen::Matrix3d solveForRotation(const MeasurementsRef& v1, const MeasurementsRef& v2);
 
   /**
    * Return the cost at termination of the GNC rotation solver. Can be used to
@@ -521,12 +1173,28 @@ public:
     return rotation_solver_->getCostAtTermination();
   }
 
+  /**
+   * Return the number of iterations run by the GNC rotation solver.
+   *
+   * @return number of iterations at termination. Undefined if run before running the solver.
+   */
+  inline size_t getGNCRotationIterationsAtTermination() {
+    return rotation_solver_->getIterationsAtTermination();
+  }
+
   /**
    * Return the solution to the registration problem.
    * @return
    */
   inline RegistrationSolution getSolution() { return solution_; };
 
+  /**
+   * Return the per-stage timings and problem sizes of the last solve. solveMultiHypothesis only
+   * fills in the stages shared by all hypotheses (up to the max clique).
+   * @return
+   */
+  inline RegistrationStats getStats() { return stats_; };
+
   /**
    * Set the scale estimator used
    * @param estimator
@@ -538,12 +1206,14 @@ public:
   /**
    * Set the rotation estimator used.
    *
-   * Note: due to the fact that rotation estimator takes in a noise bound that is dependent on the
-   * estimated scale, make sure to set the correct params before calling solve.
+   * Note: the noise bound of the estimator's params is taken as the noise bound of the
+   * measurements. Since rotation is estimated from de-scaled TIMs, solve() runs the estimator with
+   * that noise bound multiplied by 2 / estimated scale.
    * @param estimator
    */
   inline void setRotationEstimator(std::unique_ptr<GNCRotationSolver> estimator) {
     rotation_solver_ = std::move(estimator);
+    rotation_noise_bound_ = rotation_solver_ ? rotation_solver_->getParams().noise_bound : 0;
   }
 
   /**
@@ -570,7 +1240,9 @@ public:
    * @return a 2-by-(number of TIMs) Eigen matrix. Entries in one column represent the indices of
    * the two measurements used to calculate the corresponding TIM.
    */
-  inline Eigen::Matrix<int, 2, Eigen::Dynamic> getScaleInliersMap() { return src_tims_map_; }
+  inline Eigen::Matrix<int, 2, Eigen::Dynamic> getScaleInliersMap() {
+    return workspace_.tims_map.view();
+  }
 
   /**
    * Return inlier TIMs from scale estimation
@@ -581,9 +1253,10 @@ public:
    */
   inline std::vector<std::tuple<int, int>> getScaleInliers() {
     std::vector<std::tuple<int, int>> result;
+    const auto tims_map = workspace_.tims_map.view();
     for (size_t i = 0; i < scale_inliers_mask_.cols(); ++i) {
       if (scale_inliers_mask_(i)) {
-        result.emplace_back(src_tims_map_(0, i), src_tims_map_(1, i));
+        result.emplace_back(tims_map(0, i), tims_map(1, i));
       }
     }
     return result;
@@ -658,43 +1331,63 @@ public:
    */
   inline std::vector<int> getInlierMaxClique() { return max_clique_; }
 
+  /**
+   * Return the indices of the measurements sampled to build the inlier graph (see
+   * Params::inlier_graph_sample_size). When sampling, the scale inliers, the inlier graph and the
+   * TIM getters refer to the sampled measurements, in this order.
+   * @return sorted indices of the sampled measurements. Empty if the last solve did not sample.
+   */
+  inline std::vector<int> getSampleIndices() { return sample_indices_; }
+
   inline std::vector<std::vector<int>> getInlierGraph() { return inlier_graph_.getAdjList(); }
 
   /**
    * Get TIMs built from source point cloud.
    * @return
    */
-  inline Eigen::Matrix<double, 3, Eigen::Dynamic> getSrcTIMs() { return src_tims_; }
+  inline Eigen::Matrix<double, 3, Eigen::Dynamic> getSrcTIMs() {
+    return workspace_.src_tims.view();
+  }
 
   /**
    * Get TIMs built from target point cloud.
    * @return
    */
-  inline Eigen::Matrix<double, 3, Eigen::Dynamic> getDstTIMs() { return dst_tims_; }
+  inline Eigen::Matrix<double, 3, Eigen::Dynamic> getDstTIMs() {
+    return workspace_.dst_tims.view();
+  }
 
   /**
    * Get TIMs built from source point cloud.
    * @return
    */
-  inline Eigen::Matrix<double, 3, Eigen::Dynamic> getMaxCliqueSrcTIMs() { return pruned_src_tims_; }
+  inline Eigen::Matrix<double, 3, Eigen::Dynamic> getMaxCliqueSrcTIMs() {
+    return workspace_.pruned_src_tims.view();
+  }
 
   /**
    * Get TIMs built from target point cloud.
    * @return
    */
-  inline Eigen::Matrix<double, 3, Eigen::Dynamic> getMaxCliqueDstTIMs() { return pruned_dst_tims_; }
+  inline Eigen::Matrix<double, 3, Eigen::Dynamic> getMaxCliqueDstTIMs() {
+    return workspace_.pruned_dst_tims.view();
+  }
 
   /**
    * Get the index map of the TIMs built from source point cloud.
    * @return
    */
-  inline Eigen::Matrix<int, 2, Eigen::Dynamic> getSrcTIMsMap() { return src_tims_map_; }
+  inline Eigen::Matrix<int, 2, Eigen::Dynamic> getSrcTIMsMap() {
+    return workspace_.tims_map.view();
+  }
 
   /**
    * Get the index map of the TIMs built from target point cloud.
    * @return
    */
-  inline Eigen::Matrix<int, 2, Eigen::Dynamic> getDstTIMsMap() { return dst_tims_map_; }
+  inline Eigen::Matrix<int, 2, Eigen::Dynamic> getDstTIMsMap() {
+    return workspace_.tims_map.view();
+  }
 
   /**
    * Reset the solver using the provided params
@@ -705,27 +1398,16 @@ public:
 
     // Initialize the scale estimator
     if (params_.estimate_scaling) {
-      setScaleEstimator(
-          std::make_unique<teaser::TLSScaleSolver>(params_.noise_bound, params_.cbar2));
+      setScaleEstimator(std::make_unique<teaser::TLSScaleSolver>(
+          params_.noise_bound, params_.cbar2, params_.scale_estimation_sample_size,
+          params_.cancellation_token));
     } else {
       setScaleEstimator(
           std::make_unique<teaser::ScaleInliersSelector>(params_.noise_bound, params_.cbar2));
     }
 
     // Initialize the rotation estimator
-    teaser::GNCRotationSolver::Params rotation_params{
-        params_.rotation_max_iterations, params_.rotation_cost_threshold,
-        params_.rotation_gnc_factor, params_.noise_bound};
-    switch (params_.rotation_estimation_algorithm) {
-    case ROTATION_ESTIMATION_ALGORITHM::GNC_TLS: { // GNC-TLS method
-      setRotationEstimator(std::make_unique<teaser::GNCTLSRotationSolver>(rotation_params));
-      break;
-    }
-    case ROTATION_ESTIMATION_ALGORITHM::FGR: { // FGR method
-      setRotationEstimator(std::make_unique<teaser::FastGlobalRegistrationSolver>(rotation_params));
-      break;
-    }
-    }
+    setRotationEstimator(makeRotationSolver(params_.noise_bound));
 
     // Initialize the translation estimator
     setTranslationEstimator(
@@ -738,28 +1420,195 @@ public:
    */
   Params getParams() { return params_; }
 
+  /**
+   * Preallocate the buffers reused across calls to solve() for problems with up to the provided
+   * number of measurements. Buffers also grow on demand, so calling this is optional; it only
+   * moves the allocations of the O(N^2) buffers out of the first solve (see
+   * RegistrationWorkspace for what still allocates).
+   * @param num_measurements
+   */
+  void reserve(size_t num_measurements) {
+    workspace_.reserve(num_measurements);
+    inlier_graph_.reserve(num_measurements);
+  }
+
 private:
+  /**
+   * Create the rotation solver selected by the params.
+   * @param noise_bound noise bound to initialize the rotation solver with
+   */
+  std::unique_ptr<GNCRotationSolver> makeRotationSolver(double noise_bound) const {
+    teaser::GNCRotationSolver::Params rotation_params{params_.rotation_max_iterations,
+                                                      params_.rotation_cost_threshold,
+                                                      params_.rotation_gnc_factor,
+                                                      noise_bound,
+                                                      params_.rotation_stop_on_stable_inliers,
+                                                      params_.rotation_stable_inliers_iterations,
+                                                      params_.rotation_delta_threshold,
+                                                      params_.cancellation_token};
+    switch (params_.rotation_estimation_algorithm) {
+    case ROTATION_ESTIMATION_ALGORITHM::FGR: { // FGR method
+      return std::make_unique<teaser::FastGlobalRegistrationSolver>(rotation_params);
+    }
+    case ROTATION_ESTIMATION_ALGORITHM::GNC_TLS: // GNC-TLS method
+    default: {
+      return std::make_unique<teaser::GNCTLSRotationSolver>(rotation_params);
+    }
+    }
+  }
+
+  /**
+   * Return the inlier selection mode, accounting for the deprecated params use_max_clique and
+   * max_clique_exact_solution. The params are not modified.
+   */
+  INLIER_SELECTION_MODE getInlierSelectionMode() const;
+
+  /**
+   * Compute the TIMs of all pairs of measurements into the provided matrix, laid out as in
+   * computeTIMs().
+   * @param v a 3-by-N matrix
+   * @param tims [out] a 3-by-N*(N-1)/2 matrix
+   * @param cancellation_token optional token polled once per measurement; the remaining TIMs are
+   * left unset once it is cancelled
+   */
+  static void writeTIMs(const MeasurementsRef& v,
+                        Eigen::Ref<Eigen::Matrix<double, 3, Eigen::Dynamic>> tims,
+                        const CancellationToken* cancellation_token = nullptr);
+
+  /**
+   * Compute the index map of the TIMs of N measurements into the provided matrix.
+   * @param num_measurements N
+   * @param map [out] a 2-by-N*(N-1)/2 matrix
+   */
+  static void writeTIMsMap(Eigen::Index num_measurements,
+                          Eigen::Ref<Eigen::Matrix<int, 2, Eigen::Dynamic>> map);
+
+  /**
+   * Compute the norms of the TIMs of all pairs of measurements, without forming the TIMs.
+   * @param v a 3-by-N matrix
+   * @param norms [out] a 1-by-N*(N-1)/2 row vector, laid out as in computeTIMs()
+   * @param cancellation_token optional token polled once per measurement
+   */
+  static void writeTIMNorms(const MeasurementsRef& v,
+                            Eigen::Ref<Eigen::Matrix<double, 1, Eigen::Dynamic>> norms,
+                            const CancellationToken* cancellation_token = nullptr);
+
+  /**
+   * Compute the TIMs of src and dst into the workspace. The index map is only recomputed when the
+   * number of measurements changes.
+   * @param src
+   * @param dst
+   */
+  void computeWorkspaceTIMs(const MeasurementsRef& src, const MeasurementsRef& dst);
+
+  /**
+   * Build the inlier graph from the scale inliers mask and the TIMs map.
+   * @param num_vertices number of measurements
+   */
+  void buildInlierGraph(int num_vertices);
+
+  /**
+   * Return the params of the max clique solver corresponding to the current inlier selection mode.
+   */
+  teaser::MaxCliqueSolver::Params getMaxCliqueSolverParams() const;
+
+  /**
+   * If the cancellation token of the params is cancelled, mark the solution as invalid and
+   * cancelled in the provided stage.
+   * @param stage the stage that was running
+   * @return true if the solve should stop
+   */
+  bool stopIfCancelled(RegistrationSolution::STAGE stage);
+
+  /**
+   * Randomly sample params_.inlier_graph_sample_size measurements into the workspace.
+   * @param src
+   * @param dst
+   */
+  void sampleMeasurements(const MeasurementsRef& src, const MeasurementsRef& dst);
+
+  /**
+   * Map the max clique of the sampled inlier graph to the original measurements, and add the
+   * measurements consistent with enough of its members.
+   * @param src
+   * @param dst
+   */
+  void verifySampledClique(const MeasurementsRef& src, const MeasurementsRef& dst);
+
+  /**
+   * Estimate rotation and translation from the measurements in the clique of a hypothesis.
+   * @param src
+   * @param dst
+   * @param scale estimated scale
+   * @param rotation_solver
+   * @param translation_solver
+   * @param hypothesis [in/out] hypothesis with its clique set
+   */
+  static void solveHypothesis(const MeasurementsRef& src, const MeasurementsRef& dst, double scale,
+                              GNCRotationSolver* rotation_solver,
+                              TLSTranslationSolver* translation_solver,
+                              RegistrationHypothesis* hypothesis);
+
+  /**
+   * Copy the statistics of a subsampled scale estimate into the stats.
+   * @param sample_stats
+   */
+  void setScaleSampleStats(const TLSScaleSolver::SampleStats& sample_stats) {
+    stats_.scale_sample_size = sample_stats.sample_size;
+    stats_.scale_standard_error = sample_stats.standard_error;
+    stats_.scale_sample_inlier_ratio = sample_stats.sample_inlier_ratio;
+    stats_.scale_inlier_ratio = sample_stats.inlier_ratio;
+  }
+
+  /**
+   * First half of solve(): TIMs, scale and inlier graph. Stats are accumulated into stats_, which
+   * has to be reset by the caller.
+   * @param src
+   * @param dst
+   * @return false if the solve stopped early, in which case solution_ holds the result
+   */
+  bool solveInlierGraph(const MeasurementsRef& src, const MeasurementsRef& dst);
+
+  /**
+   * Second half of solve(): max clique, rotation and translation, starting from the scale and the
+   * inlier graph found by solveInlierGraph() on the same measurements.
+   * @param src
+   * @param dst
+   */
+  RegistrationSolution solveFromInlierGraph(const MeasurementsRef& src,
+                                            const MeasurementsRef& dst);
+
+  // Runs the two halves of solve() for consecutive problems on different threads
+  friend class RegistrationPipeline;
+
+  // Holds a solver running the re-entrant solve
+  friend class RegistrationContext;
+
+  // Maintains the inlier graph itself and runs the second half of solve() on it
+  friend class IncrementalRegistrationSolver;
+
   Params params_;
   RegistrationSolution solution_;
+  RegistrationStats stats_;
 
   // Inlier Binary Vectors
   Eigen::Matrix<bool, 1, Eigen::Dynamic> scale_inliers_mask_;
   Eigen::Matrix<bool, 1, Eigen::Dynamic> rotation_inliers_mask_;
   Eigen::Matrix<bool, 1, Eigen::Dynamic> translation_inliers_mask_;
 
-  // TIMs
-  Eigen::Matrix<double, 3, Eigen::Dynamic> src_tims_;
-  Eigen::Matrix<double, 3, Eigen::Dynamic> dst_tims_;
-  Eigen::Matrix<double, 3, Eigen::Dynamic> pruned_src_tims_;
-  Eigen::Matrix<double, 3, Eigen::Dynamic> pruned_dst_tims_;
-
-  // TIM maps
-  Eigen::Matrix<int, 2, Eigen::Dynamic> src_tims_map_;
-  Eigen::Matrix<int, 2, Eigen::Dynamic> dst_tims_map_;
+  // TIMs, TIM map and other intermediate matrices, reused across solves
+  RegistrationWorkspace workspace_;
 
   // Max clique vector
   std::vector<int> max_clique_;
 
+  // Known clique of the inlier graph to warm-start the next max clique search with, if not empty.
+  // Cleared by the search.
+  std::vector<int> warm_start_clique_;
+
+  // Measurements sampled to build the inlier graph, empty if not sampling
+  std::vector<int> sample_indices_;
+
   // Inliers after rotation estimation
   std::vector<int> rotation_inliers_;
 
@@ -769,10 +1618,53 @@ private:
   // Inlier graph
   teaser::Graph inlier_graph_;
 
+  // Max clique solver, kept across solves to reuse its memory
+  teaser::MaxCliqueSolver clique_solver_;
+
   // Ptrs to Solvers
   std::unique_ptr<AbstractScaleSolver> scale_solver_;
   std::unique_ptr<GNCRotationSolver> rotation_solver_;
   std::unique_ptr<AbstractTranslationSolver> translation_solver_;
+
+  // Noise bound the rotation solver was set with, before scaling by the estimated scale
+  double rotation_noise_bound_ = 0;
+};
+
+/**
+ * Per-thread state of the re-entrant RobustRegistrationSolver::solve(src, dst, context): the
+ * buffers, solvers and results of the solves run with this context.
+ */
+class RegistrationContext {
+public:
+  /**
+   * @return the solution of the last solve run with this context
+   */
+  RegistrationSolution getSolution() const { return solver_.solution_; }
+
+  /**
+   * @return the stats of the last solve run with this context
+   */
+  RegistrationStats getStats() const { return solver_.stats_; }
+
+  /**
+   * @return indices of the measurements in the max clique of the last solve
+   */
+  std::vector<int> getInlierMaxClique() const { return solver_.max_clique_; }
+
+  /**
+   * @return indices of the measurements that are rotation inliers in the last solve
+   */
+  std::vector<int> getRotationInliers() const { return solver_.rotation_inliers_; }
+
+  /**
+   * @return indices of the measurements that are translation (final) inliers in the last solve
+   */
+  std::vector<int> getTranslationInliers() const { return solver_.translation_inliers_; }
+
+private:
+  friend class RobustRegistrationSolver;
+
+  RobustRegistrationSolver solver_;
 };
 
 } // namespace teaser
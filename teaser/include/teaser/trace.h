@@ -0,0 +1,107 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#pragma once
+
+#include <ostream>
+#include <string>
+
+/**
+ * Optional trace instrumentation, exported in the Chrome trace event format (can be opened with
+ * chrome://tracing or https://ui.perfetto.dev).
+ *
+ * Build with the CMake option ENABLE_TRACING to record events. It defines TEASER_ENABLE_TRACING
+ * publicly on the teaser_registration target, so that code linking against it sees the same
+ * setting. Otherwise TEASER_TRACE_SCOPE compiles to nothing, and the dump functions write an empty
+ * trace. The dump functions are compiled into the library, so they report the events of the
+ * library whichever way the calling code is built.
+ *
+ * Each thread records into its own fixed-size ring buffer, so recording is lock-free; once a
+ * buffer is full, the oldest events of that thread are overwritten. Buffers are registered (under
+ * a mutex) on the first event of each thread and live until the end of the program.
+ */
+
+#ifdef TEASER_ENABLE_TRACING
+
+#include <cstdint>
+
+#define TEASER_TRACE_CONCAT_IMPL(a, b) a##b
+#define TEASER_TRACE_CONCAT(a, b) TEASER_TRACE_CONCAT_IMPL(a, b)
+
+/**
+ * Record the enclosing scope as a trace event. The name has to be a string literal.
+ */
+#define TEASER_TRACE_SCOPE(name)                                                                   \
+  teaser::trace::ScopedEvent TEASER_TRACE_CONCAT(teaser_trace_event_, __LINE__)(name)
+
+#else
+
+#define TEASER_TRACE_SCOPE(name)                                                                   \
+  do {                                                                                             \
+  } while (0)
+
+#endif
+
+namespace teaser {
+namespace trace {
+
+#ifdef TEASER_ENABLE_TRACING
+
+/**
+ * @return nanoseconds since the trace epoch (the first use of the trace)
+ */
+int64_t now();
+
+/**
+ * Record a complete event (a named interval) in the buffer of the calling thread.
+ * @param name a string literal
+ * @param start_ns start time, as returned by now()
+ * @param duration_ns
+ */
+void recordEvent(const char* name, int64_t start_ns, int64_t duration_ns);
+
+/**
+ * RAII helper recording the lifetime of a scope as one event. Use through TEASER_TRACE_SCOPE.
+ */
+class ScopedEvent {
+public:
+  explicit ScopedEvent(const char* name) : name_(name), start_ns_(now()) {}
+
+  ~ScopedEvent() { recordEvent(name_, start_ns_, now() - start_ns_); }
+
+  ScopedEvent(const ScopedEvent&) = delete;
+  ScopedEvent& operator=(const ScopedEvent&) = delete;
+
+private:
+  const char* name_;
+  int64_t start_ns_;
+};
+
+#endif
+
+/**
+ * Write the recorded events as Chrome trace JSON. Events recorded concurrently with the dump may
+ * be partially written, so call this while the solvers are idle.
+ * @param os
+ */
+void writeChromeTrace(std::ostream& os);
+
+/**
+ * Write the recorded events as Chrome trace JSON to a file.
+ * @param file_name
+ * @return true if the file could be written
+ */
+bool writeChromeTrace(const std::string& file_name);
+
+/**
+ * Drop all recorded events. Call this while the solvers are idle.
+ */
+void clearTrace();
+
+} // namespace trace
+} // namespace teaser
@@ -8,6 +8,9 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <random>
 #include <unordered_set>
 #include <vector>
 
@@ -44,7 +47,7 @@ std::vector<T> randomSample(std::vector<T> input, size_t num_samples, URBG&& g)
     // if the sample is small, repeatedly sample with replacement until num_samples
     // unique values
     std::unordered_set<size_t> sample_indices;
-    std::uniform_int_distribution<> dis(0, input.size());
+    std::uniform_int_distribution<size_t> dis(0, input.size() - 1);
     while (sample_indices.size() < num_samples) {
       sample_indices.insert(dis(std::forward<URBG>(g)));
     }
@@ -111,6 +114,19 @@ template <class T, int D> float calculateDiameter(const Eigen::Matrix<T, D, Eige
   return 2 * std::sqrt(temp.maxCoeff());
 }
 
+/**
+ * Same as calculateDiameter(), on a view of 3D points (e.g., a map or a block of columns), without
+ * copying them
+ * @param X
+ * @return the diameter of the set of points given
+ */
+inline float
+calculateDiameter(const Eigen::Ref<const Eigen::Matrix<double, 3, Eigen::Dynamic>>& X) {
+  Eigen::Vector3d cog = X.rowwise().sum() / X.cols();
+  Eigen::Matrix<double, 1, Eigen::Dynamic> temp = (X.colwise() - cog).colwise().squaredNorm();
+  return 2 * std::sqrt(temp.maxCoeff());
+}
+
 /**
  * Helper function to use svd to estimate rotation.
  * Method described here: http://igl.ethz.ch/projects/ARAP/svd_rot.pdf
@@ -118,11 +134,15 @@ template <class T, int D> float calculateDiameter(const Eigen::Matrix<T, D, Eige
  * @param Y
  * @return a rotation matrix R
  */
-inline Eigen::Matrix3d svdRot(const Eigen::Matrix<double, 3, Eigen::Dynamic>& X,
-                              const Eigen::Matrix<double, 3, Eigen::Dynamic>& Y,
-                              const Eigen::Matrix<double, 1, Eigen::Dynamic>& W) {
-  // Assemble the correlation matrix H = X * Y'
-  Eigen::Matrix3d H = X * W.asDiagonal() * Y.transpose();
+inline Eigen::Matrix3d svdRot(const Eigen::Ref<const Eigen::Matrix<double, 3, Eigen::Dynamic>>& X,
+                              const Eigen::Ref<const Eigen::Matrix<double, 3, Eigen::Dynamic>>& Y,
+                              const Eigen::Ref<const Eigen::Matrix<double, 1, Eigen::Dynamic>>& W) {
+  // Assemble the correlation matrix H = X * diag(W) * Y', one column at a time to avoid a 3-by-N
+  // temporary
+  Eigen::Matrix3d H = Eigen::Matrix3d::Zero();
+  for (Eigen::Index i = 0; i < X.cols(); ++i) {
+    H.noalias() += W(i) * X.col(i) * Y.col(i).transpose();
+  }
 
   Eigen::JacobiSVD<Eigen::Matrix3d> svd(H, Eigen::ComputeFullU | Eigen::ComputeFullV);
   Eigen::Matrix3d U = svd.matrixU();
@@ -136,20 +156,35 @@ inline Eigen::Matrix3d svdRot(const Eigen::Matrix<double, 3, Eigen::Dynamic>& X,
 }
 
 /**
- * Use an boolean Eigen matrix to mask a vector
+ * Use an boolean Eigen matrix to mask a vector, writing into an existing vector so that its
+ * capacity is reused
  * @param mask a 1-by-N boolean Eigen matrix
  * @param elements vector to be masked
- * @return
+ * @param result [out] masked elements. Must not alias elements.
  */
 template <class T>
-inline std::vector<T> maskVector(Eigen::Matrix<bool, 1, Eigen::Dynamic> mask,
-                                 std::vector<T> elements) {
-  std::vector<T> result;
+inline void maskVector(const Eigen::Matrix<bool, 1, Eigen::Dynamic>& mask,
+                       const std::vector<T>& elements, std::vector<T>* result) {
+  assert(result != &elements);
+  result->clear();
   for (size_t i = 0; i < mask.cols(); ++i) {
     if (mask(i)) {
-      result.push_back(elements[i]);
+      result->push_back(elements[i]);
     }
   }
+}
+
+/**
+ * Use an boolean Eigen matrix to mask a vector
+ * @param mask a 1-by-N boolean Eigen matrix
+ * @param elements vector to be masked
+ * @return
+ */
+template <class T>
+inline std::vector<T> maskVector(const Eigen::Matrix<bool, 1, Eigen::Dynamic>& mask,
+                                 const std::vector<T>& elements) {
+  std::vector<T> result;
+  maskVector(mask, elements, &result);
   return result;
 }
 
@@ -0,0 +1,134 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+
+namespace teaser {
+
+/**
+ * A fixed-row, variable-column matrix buffer that keeps its storage across resizes.
+ *
+ * Resizing an Eigen::Matrix to a different number of columns always reallocates. This buffer
+ * instead only reallocates when the requested number of columns exceeds the largest one seen so
+ * far (high-water mark), and exposes the used columns through an Eigen::Map. Contents are
+ * preserved when the buffer grows.
+ *
+ * @tparam T scalar type
+ * @tparam Rows number of rows
+ */
+template <class T, int Rows> class ColumnBuffer {
+public:
+  using MatrixType = Eigen::Matrix<T, Rows, Eigen::Dynamic>;
+  using MapType = Eigen::Map<MatrixType>;
+  using ConstMapType = Eigen::Map<const MatrixType>;
+
+  /**
+   * Make sure the buffer can hold the provided number of columns without reallocating.
+   * @param cols
+   */
+  void reserve(Eigen::Index cols) {
+    if (cols > storage_.cols()) {
+      storage_.conservativeResize(Rows, cols);
+    }
+  }
+
+  /**
+   * Set the number of used columns, growing the storage if needed.
+   * @param cols
+   * @return a map over the used columns
+   */
+  MapType resize(Eigen::Index cols) {
+    reserve(cols);
+    cols_ = cols;
+    return view();
+  }
+
+  /**
+   * @return a map over the used columns
+   */
+  MapType view() { return MapType(storage_.data(), Rows, cols_); }
+
+  /**
+   * @return a read-only map over the used columns
+   */
+  ConstMapType view() const { return ConstMapType(storage_.data(), Rows, cols_); }
+
+  /**
+   * @return number of used columns
+   */
+  Eigen::Index cols() const { return cols_; }
+
+  /**
+   * @return number of columns the buffer can hold without reallocating
+   */
+  Eigen::Index capacity() const { return storage_.cols(); }
+
+private:
+  MatrixType storage_;
+  Eigen::Index cols_ = 0;
+};
+
+/**
+ * Buffers reused by RobustRegistrationSolver across calls to solve(), so that repeated solves of
+ * problems of similar sizes do not reallocate the O(N^2) intermediate matrices.
+ *
+ * The built-in scale, rotation and translation solvers and the dense graph path of MaxCliqueSolver
+ * keep their own intermediate buffers the same way, and the inlier masks and index lists of the
+ * solver keep their capacity. Once warmed up, solves of the same size then only allocate for the
+ * OpenMP thread teams, except when the max clique is searched with PMC, which allocates its own
+ * copy of the inlier graph on every call.
+ */
+struct RegistrationWorkspace {
+  // Measurements gathered from point clouds by correspondence indices
+  ColumnBuffer<double, 3> src;
+  ColumnBuffer<double, 3> dst;
+
+  // Randomly sampled measurements, input to the TIMs when sampling the inlier graph
+  ColumnBuffer<double, 3> sample_src;
+  ColumnBuffer<double, 3> sample_dst;
+
+  // TIMs of all pairs of measurements
+  ColumnBuffer<double, 3> src_tims;
+  ColumnBuffer<double, 3> dst_tims;
+
+  // Norms of the dst TIMs, when solving against a prepared source
+  ColumnBuffer<double, 1> dst_tim_norms;
+
+  // Index map of the TIMs. It only depends on the number of measurements, and is shared by the src
+  // and dst TIMs.
+  ColumnBuffer<int, 2> tims_map;
+
+  // TIMs between consecutive max clique members, input to rotation estimation
+  ColumnBuffer<double, 3> pruned_src_tims;
+  ColumnBuffer<double, 3> pruned_dst_tims;
+
+  // Rotation inliers, input to translation estimation
+  ColumnBuffer<double, 3> translation_src;
+  ColumnBuffer<double, 3> translation_dst;
+
+  /**
+   * Preallocate buffers for problems with up to the provided number of measurements.
+   * @param num_measurements
+   */
+  void reserve(Eigen::Index num_measurements) {
+    const Eigen::Index num_tims = num_measurements * (num_measurements - 1) / 2;
+    src.reserve(num_measurements);
+    dst.reserve(num_measurements);
+    src_tims.reserve(num_tims);
+    dst_tims.reserve(num_tims);
+    tims_map.reserve(num_tims);
+    pruned_src_tims.reserve(num_measurements);
+    pruned_dst_tims.reserve(num_measurements);
+    translation_src.reserve(num_measurements);
+    translation_dst.reserve(num_measurements);
+  }
+};
+
+} // namespace teaser
@@ -0,0 +1,338 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "teaser/certification.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include <Eigen/Cholesky>
+#include <Eigen/Eigenvalues>
+#include <Eigen/Geometry>
+
+#include "teaser/macros.h"
+
+Eigen::Matrix4d teaser::DRSCertifier::getQuaternionCorrelation(const Eigen::Vector3d& src,
+                                                               const Eigen::Vector3d& dst) {
+  Eigen::Matrix3d s = src * dst.transpose();
+  const double sxx = s(0, 0), sxy = s(0, 1), sxz = s(0, 2);
+  const double syx = s(1, 0), syy = s(1, 1), syz = s(1, 2);
+  const double szx = s(2, 0), szy = s(2, 1), szz = s(2, 2);
+  Eigen::Matrix4d n;
+  // clang-format off
+  n << sxx + syy + szz, syz - szy,        szx - sxz,        sxy - syx,
+       syz - szy,       sxx - syy - szz,  sxy + syx,        szx + sxz,
+       szx - sxz,       sxy + syx,        -sxx + syy - szz, syz + szy,
+       sxy - syx,       szx + sxz,        syz + szy,        -sxx - syy + szz;
+  // clang-format on
+  return n;
+}
+
+double teaser::DRSCertifier::computeMinEigenvalue(const Eigen::MatrixXd& m, size_t max_iterations,
+                                                  Eigen::VectorXd* v) {
+  const Eigen::Index n = m.rows();
+  const Eigen::Index k_max = std::min<Eigen::Index>(n, max_iterations);
+
+  // Lanczos iterations with full reorthogonalization, started from v (e.g., the Ritz vector from a
+  // previous call)
+  Eigen::MatrixXd basis(n, k_max);
+  Eigen::VectorXd alpha(k_max), beta(k_max);
+  Eigen::VectorXd w = v->size() == n && v->norm() > 0 ? *v : Eigen::VectorXd::Ones(n);
+  basis.col(0) = w.normalized();
+  Eigen::Index k = 0;
+  while (k < k_max) {
+    w.noalias() = m * basis.col(k);
+    alpha(k) = basis.col(k).dot(w);
+    w -= basis.leftCols(k + 1) * (basis.leftCols(k + 1).transpose() * w);
+    w -= basis.leftCols(k + 1) * (basis.leftCols(k + 1).transpose() * w);
+    beta(k) = w.norm();
+    ++k;
+    if (k == k_max || beta(k - 1) <= 1e-12 * std::abs(alpha(k - 1))) {
+      break;
+    }
+    basis.col(k) = w / beta(k - 1);
+  }
+
+  Eigen::MatrixXd tridiagonal = Eigen::MatrixXd::Zero(k, k);
+  tridiagonal.diagonal() = alpha.head(k);
+  tridiagonal.diagonal(1) = beta.head(k - 1);
+  tridiagonal.diagonal(-1) = beta.head(k - 1);
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es(tridiagonal);
+  *v = basis.leftCols(k) * es.eigenvectors().col(0);
+  return es.eigenvalues()(0);
+}
+
+teaser::CertificationResult
+teaser::DRSCertifier::certify(const Eigen::Matrix3d& rotation_solution,
+                              const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
+                              const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst,
+                              const Eigen::Matrix<bool, 1, Eigen::Dynamic>& theta) {
+  assert(src.cols() == dst.cols());
+  assert(src.cols() == theta.cols());
+  assert(params_.noise_bound > 0);
+  auto start = std::chrono::steady_clock::now();
+  auto elapsed = [&start]() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  };
+
+  const size_t N = src.cols();
+  const double noise_bound_sq = std::pow(params_.noise_bound, 2);
+  const Eigen::Matrix4d I4 = Eigen::Matrix4d::Identity();
+  CertificationResult result;
+
+  Eigen::Quaterniond quat(rotation_solution);
+  quat.normalize();
+  const Eigen::Vector4d q_est(quat.w(), quat.x(), quat.y(), quat.z());
+
+  // Cost matrix of the lifted problem: the first diagonal block Q_00 and the first block row Q_0i.
+  // With P_i such that q^T * P_i * q = ||dst_i - R * src_i||^2 / noise_bound^2, the TLS cost of
+  // (q, theta) is q^T * G * q, with G = Q_00 + 2 * sum_i theta_i * Q_0i.
+  Eigen::Matrix4d q00 = Eigen::Matrix4d::Zero();
+  BlockVector q0s(N);
+  Eigen::VectorXd signs(N + 1);
+  signs(0) = 1;
+  for (size_t i = 0; i < N; ++i) {
+    Eigen::Matrix4d p = ((src.col(i).squaredNorm() + dst.col(i).squaredNorm()) * I4 -
+                         2 * getQuaternionCorrelation(src.col(i), dst.col(i))) /
+                        noise_bound_sq;
+    q00 += 0.5 * (p + params_.cbar2 * I4);
+    q0s[i] = 0.25 * (p - params_.cbar2 * I4);
+    signs(i + 1) = theta(i) ? 1 : -1;
+  }
+  Eigen::Matrix4d g = q00;
+  for (size_t i = 0; i < N; ++i) {
+    g += 2 * signs(i + 1) * q0s[i];
+  }
+  const double cost = q_est.dot(g * q_est);
+  TEASER_DEBUG_INFO_MSG("Certifying rotation with TLS cost: " << cost);
+
+  // The TLS cost is nonnegative, so a zero cost is trivially optimal.
+  if (cost <= 0) {
+    result.is_optimal = true;
+    result.best_suboptimality = 0;
+    result.suboptimality_traj.push_back(0);
+    return result;
+  }
+
+  // Complementary slackness needs q to be stationary for the given inliers, which the estimate
+  // only is up to solver tolerance. Certify the minimizer of q^T * G * q instead: its cost mu is at
+  // most the cost of the estimate, and any lower bound on the optimum is valid for both.
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> g_es(g);
+  const Eigen::Vector4d q = g_es.eigenvectors().col(0);
+  const double mu = g_es.eigenvalues()(0);
+
+  // Change basis so that q = e_0: the left multiplication matrix of q is orthogonal with q as its
+  // first column. Block-wise orthogonal congruence preserves the PSD cone and the Frobenius norm.
+  Eigen::Matrix4d omega;
+  // clang-format off
+  omega << q(0), -q(1), -q(2), -q(3),
+           q(1),  q(0), -q(3),  q(2),
+           q(2),  q(3),  q(0), -q(1),
+           q(3), -q(2),  q(1),  q(0);
+  // clang-format on
+  q00 = omega.transpose() * q00 * omega;
+  for (auto& q0 : q0s) {
+    q0 = omega.transpose() * q0 * omega;
+  }
+  const Eigen::Matrix4d c = q00 - mu * I4;
+  Eigen::Vector3d weighted_g_sum = Eigen::Vector3d::Zero();
+  double weighted_q0_sum = 0;
+  for (size_t i = 0; i < N; ++i) {
+    weighted_g_sum += signs(i + 1) * q0s[i].block<3, 1>(1, 0);
+    weighted_q0_sum += signs(i + 1) * q0s[i](0, 0);
+  }
+
+  // Frobenius projection onto the affine set of dual matrices M with M * x = 0, where
+  // x = [e_0; theta_1 e_0; ...; theta_N e_0]:
+  // - Off-diagonal blocks are M_ij = Q_ij + S_ij, with S_ij skew-symmetric (from the redundant
+  //   constraints x_i * x_j^T = x_j * x_i^T). The first column s_ij of S_ij is constrained, the
+  //   rest is the skew-symmetric part of Z_ij.
+  // - Diagonal blocks are M_00 = C + sum_i Lambda_i and M_ii = -Lambda_i. M * x = 0 fixes the first
+  //   column of Lambda_i given the s_ij, and the rest is solved in closed form.
+  // With flows t_ij = theta_i * theta_j * s_ij on the edges of the complete graph over the N + 1
+  // blocks, the first columns of the diagonal blocks depend on the divergence of t, and the least
+  // squares problem min 4 * ||t - t_hat||^2 + 2 * ||div(t) - y||^2 is solved with the Laplacian
+  // (N + 1) * I - 1 * 1^T of the complete graph.
+  const Eigen::Index n = 4 * (N + 1);
+  auto project_affine = [&](const Eigen::MatrixXd& z, Eigen::MatrixXd* m) {
+    m->resize(n, n);
+    Eigen::Matrix3Xd div_hat = Eigen::Matrix3Xd::Zero(3, N + 1);
+    for (size_t i = 0; i <= N; ++i) {
+      for (size_t j = i + 1; j <= N; ++j) {
+        Eigen::Vector3d t_hat = 0.5 * signs(i) * signs(j) *
+                                (z.block<3, 1>(4 * i + 1, 4 * j) -
+                                 z.block<1, 3>(4 * i, 4 * j + 1).transpose());
+        div_hat.col(i) += t_hat;
+        div_hat.col(j) -= t_hat;
+      }
+    }
+    Eigen::Matrix3Xd y(3, N + 1);
+    y.col(0) = c.block<3, 1>(1, 0) + weighted_g_sum -
+               0.5 * (z.block<3, 1>(1, 0) + z.block<1, 3>(0, 1).transpose());
+    for (size_t i = 1; i <= N; ++i) {
+      Eigen::Matrix4d z_ii = z.block<4, 4>(4 * i, 4 * i);
+      y.col(i) = -signs(i) * q0s[i - 1].block<3, 1>(1, 0) -
+                 0.5 * (z_ii.block<3, 1>(1, 0) + z_ii.block<1, 3>(0, 1).transpose());
+    }
+    Eigen::Vector3d y_sum = y.rowwise().sum();
+    Eigen::Matrix3Xd div = (2 * div_hat + static_cast<double>(N + 1) * y).colwise() - y_sum;
+    div /= static_cast<double>(N + 3);
+    Eigen::Matrix3Xd potential = 0.5 * (y - div);
+
+    // Off-diagonal blocks
+    for (size_t i = 0; i <= N; ++i) {
+      for (size_t j = i + 1; j <= N; ++j) {
+        Eigen::Matrix4d z_ij = z.block<4, 4>(4 * i, 4 * j);
+        Eigen::Vector3d t_hat =
+            0.5 * signs(i) * signs(j) *
+            (z_ij.block<3, 1>(1, 0) - z_ij.block<1, 3>(0, 1).transpose());
+        Eigen::Vector3d s_ij =
+            signs(i) * signs(j) * (t_hat + potential.col(i) - potential.col(j));
+        Eigen::Matrix4d m_ij;
+        m_ij(0, 0) = 0;
+        m_ij.block<3, 1>(1, 0) = s_ij;
+        m_ij.block<1, 3>(0, 1) = -s_ij.transpose();
+        m_ij.block<3, 3>(1, 1) =
+            0.5 * (z_ij.block<3, 3>(1, 1) - z_ij.block<3, 3>(1, 1).transpose());
+        if (i == 0) {
+          m_ij += q0s[j - 1];
+        }
+        m->block<4, 4>(4 * i, 4 * j) = m_ij;
+        m->block<4, 4>(4 * j, 4 * i) = m_ij.transpose();
+      }
+    }
+
+    // Diagonal blocks
+    Eigen::Matrix3d z00 = z.block<3, 3>(1, 1);
+    Eigen::Matrix3d a0 = 0.5 * (z00 + z00.transpose()) - c.block<3, 3>(1, 1);
+    Eigen::Matrix3d b_sum = Eigen::Matrix3d::Zero();
+    for (size_t i = 1; i <= N; ++i) {
+      Eigen::Matrix3d z_ii = z.block<3, 3>(4 * i + 1, 4 * i + 1);
+      b_sum -= 0.5 * (z_ii + z_ii.transpose());
+    }
+    Eigen::Matrix3d shift = (b_sum + static_cast<double>(N) * a0) / (N + 1) - a0;
+
+    Eigen::Matrix4d m00;
+    m00(0, 0) = c(0, 0) + weighted_q0_sum;
+    m00.block<3, 1>(1, 0) = c.block<3, 1>(1, 0) + weighted_g_sum - div.col(0);
+    m00.block<1, 3>(0, 1) = m00.block<3, 1>(1, 0).transpose();
+    m00.block<3, 3>(1, 1) = c.block<3, 3>(1, 1) + a0 + shift;
+    m->topLeftCorner<4, 4>() = m00;
+    for (size_t i = 1; i <= N; ++i) {
+      Eigen::Matrix3d z_ii = z.block<3, 3>(4 * i + 1, 4 * i + 1);
+      Eigen::Matrix4d m_ii;
+      m_ii(0, 0) = -signs(i) * q0s[i - 1](0, 0);
+      m_ii.block<3, 1>(1, 0) = -signs(i) * q0s[i - 1].block<3, 1>(1, 0) - div.col(i);
+      m_ii.block<1, 3>(0, 1) = m_ii.block<3, 1>(1, 0).transpose();
+      m_ii.block<3, 3>(1, 1) = 0.5 * (z_ii + z_ii.transpose()) + shift;
+      m->block<4, 4>(4 * i, 4 * i) = m_ii;
+    }
+  };
+
+  // Initial guess: Lambda_i = -(P_i + cbar2 * I) / 4, which makes M a sum of PSD terms
+  // (x_0 + x_i)^T * P_i * (x_0 + x_i) / 4 + cbar2 * ||x_0 - x_i||^2 / 4 and certifies noiseless
+  // inliers, projected onto the affine set
+  Eigen::MatrixXd z = Eigen::MatrixXd::Zero(n, n);
+  z.topLeftCorner<4, 4>() = c;
+  for (size_t i = 1; i <= N; ++i) {
+    Eigen::Matrix4d lambda = -q0s[i - 1] - 0.5 * params_.cbar2 * I4;
+    z.topLeftCorner<4, 4>() += lambda;
+    z.block<4, 4>(0, 4 * i) = q0s[i - 1];
+    z.block<4, 4>(4 * i, 0) = q0s[i - 1];
+    z.block<4, 4>(4 * i, 4 * i) = -lambda;
+  }
+  Eigen::MatrixXd candidate;
+  project_affine(z, &candidate);
+  z = candidate;
+
+  // For any dual matrix M in the affine set, the optimum is at least mu + (N + 1) * min_eig(M). The
+  // minimum eigenvalue is estimated with Lanczos iterations. Those over-estimate it, so the estimate
+  // only picks a shift, and a Cholesky factorization of M + shift * I (which succeeds iff
+  // min_eig(M) > -shift) confirms the bound. If the factorization fails, the bound comes from the
+  // exact minimum eigenvalue.
+  //
+  // Each of those dense O(N^3) factorizations, and each PSD projection, is only started if it is
+  // expected to end within the time limit. Costs are extrapolated from the last Cholesky
+  // factorization (eigenvalues alone cost up to about 8 times more, eigenpairs up to about 50
+  // times more) until a PSD projection has been timed.
+  const double certified_shift =
+      std::max(0.0, params_.sub_optimality * cost - (cost - mu)) / (N + 1);
+  double cholesky_time = 0;
+  double projection_time = 0;
+  auto fits_in_time_limit = [&](double expected_time) {
+    return elapsed() + expected_time <= params_.time_limit;
+  };
+  Eigen::VectorXd ritz_vector;
+  // Returns false if no gap could be proven within the time limit
+  auto compute_gap = [&](const Eigen::MatrixXd& m, double* gap, bool* certified) {
+    auto to_gap = [&](double min_eig) {
+      double lower_bound = std::max(0.0, mu + static_cast<double>(N + 1) * std::min(0.0, min_eig));
+      return (cost - lower_bound) / cost;
+    };
+    const double estimate = computeMinEigenvalue(m, params_.lanczos_iterations, &ritz_vector);
+    *certified = to_gap(estimate) <= params_.sub_optimality;
+    if (!fits_in_time_limit(cholesky_time)) {
+      *certified = false;
+      return false;
+    }
+    // Otherwise, widen the estimated shift a little so that it can still be confirmed
+    const double shift = *certified ? certified_shift
+                                    : 1.1 * std::max(0.0, -estimate) +
+                                          1e-9 * std::max(1.0, m.diagonal().cwiseAbs().maxCoeff());
+    const double cholesky_start = elapsed();
+    Eigen::LLT<Eigen::MatrixXd> llt(m + shift * Eigen::MatrixXd::Identity(n, n));
+    cholesky_time = elapsed() - cholesky_start;
+    if (llt.info() == Eigen::Success) {
+      // The certified shift is chosen to give a gap of exactly sub_optimality, up to rounding
+      *gap = *certified ? std::min(params_.sub_optimality, to_gap(-shift)) : to_gap(-shift);
+      return true;
+    }
+    if (!fits_in_time_limit(8 * cholesky_time)) {
+      *certified = false;
+      return false;
+    }
+    *gap = to_gap(Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd>(m, Eigen::EigenvaluesOnly)
+                      .eigenvalues()(0));
+    *certified = *gap <= params_.sub_optimality;
+    return true;
+  };
+  auto record_gap = [&](const Eigen::MatrixXd& m) {
+    bool certified = false;
+    double gap;
+    if (compute_gap(m, &gap, &certified)) {
+      result.suboptimality_traj.push_back(gap);
+      result.best_suboptimality = result.suboptimality_traj.size() == 1
+                                      ? gap
+                                      : std::min(result.best_suboptimality, gap);
+      result.is_optimal = certified;
+    }
+  };
+  record_gap(z);
+
+  // Refine with Douglas-Rachford splitting between the PSD cone and the affine set
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es;
+  while (!result.is_optimal && result.iterations < params_.max_iterations &&
+         fits_in_time_limit(projection_time > 0 ? projection_time : 50 * cholesky_time)) {
+    const double projection_start = elapsed();
+    es.compute(z);
+    Eigen::MatrixXd y = es.eigenvectors() * es.eigenvalues().cwiseMax(0).asDiagonal() *
+                        es.eigenvectors().transpose();
+    projection_time = elapsed() - projection_start;
+    project_affine(2 * y - z, &candidate);
+    z += params_.gamma_tau * (candidate - y);
+    ++result.iterations;
+    record_gap(candidate);
+  }
+  TEASER_DEBUG_INFO_MSG("Certification finished after " << result.iterations
+                                                        << " DRS iterations with suboptimality "
+                                                        << result.best_suboptimality);
+  return result;
+}
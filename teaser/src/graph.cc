@@ -7,41 +7,269 @@
  */
 
 #include "teaser/graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "teaser/trace.h"
 #include "pmc/pmc.h"
 
-vector<int> teaser::MaxCliqueSolver::findMaxClique(teaser::Graph graph) {
+namespace {
+
+/**
+ * Exact minimum vertex cover search for graphs with small covers, using a bounded search tree:
+ * for the vertex v of max degree, either v or all of its neighbors are in the cover. With a cover
+ * budget of k, vertices of degree above k are forced into the cover without branching, so that
+ * e.g. the complement of an inlier graph (where outliers miss many edges) is solved in near-linear
+ * time.
+ *
+ * The search works in buffers provided by the caller, so that they can be reused across searches.
+ * It stops early (as if no cover was found) once the node budget or the time limit is exhausted,
+ * or the cancellation token is cancelled, which is checked at every node of the search tree.
+ */
+class VertexCoverSearch {
+public:
+  /**
+   * @param adj_list
+   * @param degrees buffer for the degrees of the vertices not in the cover
+   * @param in_cover buffer for the cover membership of each vertex. Once a cover is found, it is
+   * set for exactly the vertices of the cover.
+   * @param cover buffer for the vertices of the cover
+   * @param time_limit in seconds, from the construction of the search
+   * @param cancellation_token optional
+   */
+  VertexCoverSearch(const std::vector<std::vector<int>>& adj_list, std::vector<size_t>* degrees,
+                    std::vector<bool>* in_cover, std::vector<int>* cover, double time_limit,
+                    const teaser::CancellationToken* cancellation_token)
+      : adj_list_(adj_list), degrees_(*degrees), removed_(*in_cover), cover_(*cover),
+        start_(std::chrono::steady_clock::now()), time_limit_(time_limit),
+        cancellation_token_(cancellation_token) {
+    degrees_.resize(adj_list_.size());
+    removed_.assign(adj_list_.size(), false);
+    cover_.clear();
+    for (size_t v = 0; v < adj_list_.size(); ++v) {
+      degrees_[v] = adj_list_[v].size();
+      num_edges_ += degrees_[v];
+    }
+    num_edges_ /= 2;
+  }
+
+  /**
+   * Find a minimum vertex cover with up to max_size vertices.
+   * @param max_size
+   * @param max_nodes budget on the number of search tree nodes
+   * @return true if found, in which case the cover is left in the cover buffer
+   */
+  bool solve(size_t max_size, size_t max_nodes) {
+    // The size of a maximal matching is a lower bound on the size of any cover. The matched
+    // vertices are marked in the (still empty) cover membership buffer.
+    size_t lower_bound = 0;
+    for (size_t v = 0; v < adj_list_.size(); ++v) {
+      for (const auto& u : adj_list_[v]) {
+        if (!removed_[v] && !removed_[u]) {
+          removed_[v] = removed_[u] = true;
+          lower_bound++;
+        }
+      }
+    }
+    removed_.assign(adj_list_.size(), false);
+
+    max_nodes_ = max_nodes;
+    nodes_ = 0;
+    stopped_ = false;
+    for (size_t k = lower_bound; k <= max_size && !stopped_; ++k) {
+      if (search(k)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  /**
+   * Search for a cover of the remaining graph with up to k more vertices.
+   */
+  bool search(size_t k) {
+    if (num_edges_ == 0) {
+      return true;
+    }
+    if (k == 0 || stopped_) {
+      return false;
+    }
+    // Each node scans all vertices, which outweighs polling the clock and the token at every node
+    if (++nodes_ > max_nodes_ || shouldStop()) {
+      stopped_ = true;
+      return false;
+    }
+
+    int v = -1;
+    for (size_t u = 0; u < adj_list_.size(); ++u) {
+      if (!removed_[u] && (v < 0 || degrees_[u] > degrees_[v])) {
+        v = u;
+      }
+    }
+    // k vertices cover at most k times the max degree edges
+    const size_t max_degree = degrees_[v];
+    if (num_edges_ > k * max_degree) {
+      return false;
+    }
+
+    // Branch 1: v is in the cover
+    remove(v);
+    if (search(k - 1)) {
+      return true;
+    }
+    restore(v);
+
+    // Branch 2: all neighbors of v are in the cover. Impossible if v has more than k neighbors.
+    // Removing a neighbor does not change which other neighbors remain, and the removed
+    // neighbors end up last in the cover.
+    if (max_degree <= k) {
+      size_t num_neighbors = 0;
+      for (const auto& u : adj_list_[v]) {
+        if (!removed_[u]) {
+          remove(u);
+          num_neighbors++;
+        }
+      }
+      if (search(k - num_neighbors)) {
+        return true;
+      }
+      for (size_t i = 0; i < num_neighbors; ++i) {
+        restore(cover_.back());
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Move a vertex to the cover. Vertices have to be restored in reverse order of removal.
+   */
+  void remove(int v) {
+    removed_[v] = true;
+    cover_.push_back(v);
+    for (const auto& u : adj_list_[v]) {
+      if (!removed_[u]) {
+        degrees_[u]--;
+        num_edges_--;
+      }
+    }
+  }
+
+  void restore(int v) {
+    removed_[v] = false;
+    cover_.pop_back();
+    for (const auto& u : adj_list_[v]) {
+      if (!removed_[u]) {
+        degrees_[u]++;
+        num_edges_++;
+      }
+    }
+  }
+
+  /**
+   * @return true if the time limit has passed or the token is cancelled
+   */
+  bool shouldStop() const {
+    if (cancellation_token_ && cancellation_token_->isCancelled()) {
+      return true;
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count() >
+           time_limit_;
+  }
+
+  const std::vector<std::vector<int>>& adj_list_;
+  std::vector<size_t>& degrees_;
+  std::vector<bool>& removed_;
+  std::vector<int>& cover_;
+  size_t num_edges_ = 0;
+  size_t nodes_ = 0;
+  size_t max_nodes_ = 0;
+  bool stopped_ = false;
+  std::chrono::steady_clock::time_point start_;
+  double time_limit_;
+  const teaser::CancellationToken* cancellation_token_;
+};
+
+} // namespace
+
+vector<int> teaser::MaxCliqueSolver::findMaxClique(const teaser::Graph& graph) {
+  return findMaxClique(graph, {});
+}
+
+vector<int> teaser::MaxCliqueSolver::findMaxClique(const teaser::Graph& graph,
+                                                   const vector<int>& initial_clique) {
+  vector<int> C;
+  findMaxClique(graph, initial_clique, &C);
+  return C;
+}
+
+void teaser::MaxCliqueSolver::findMaxClique(const teaser::Graph& graph,
+                                            const vector<int>& initial_clique,
+                                            vector<int>* clique) {
+  TEASER_TRACE_SCOPE("MaxCliqueSolver::findMaxClique");
+  const auto start = std::chrono::steady_clock::now();
 
   // Handle deprecated field
   if (!params_.solve_exactly) {
     params_.solver_mode = CLIQUE_SOLVER_MODE::PMC_HEU;
   }
 
-  // Create a PMC graph from the TEASER graph
-  vector<int> edges;
-  vector<long long> vertices;
-  vertices.push_back(edges.size());
+  // Near-complete graphs: skip PMC
+  const double num_pairs = 0.5 * graph.numVertices() * (graph.numVertices() - 1);
+  if (num_pairs > 0 && graph.numEdges() >= params_.dense_graph_threshold * num_pairs) {
+    if (findMaxCliqueOnDenseGraph(graph, clique)) {
+      TEASER_DEBUG_INFO_MSG("Max clique found on dense graph.");
+      max_core_ = -1;
+      return;
+    }
+    // PMC cannot be interrupted, so do not start it once cancelled
+    if (isCancelled(params_.cancellation_token)) {
+      clique->clear();
+      return;
+    }
+  }
+
+  // Time spent on the dense graph path counts against the time limit
+  const double elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  *clique = findMaxCliqueWithPMC(graph, initial_clique, params_.time_limit - elapsed);
+}
 
-  const auto all_vertices = graph.getVertices();
-  for (const auto& i : all_vertices) {
+vector<int> teaser::MaxCliqueSolver::findMaxCliqueWithPMC(const teaser::Graph& graph,
+                                                          const vector<int>& initial_clique,
+                                                          double time_limit) {
+  // Create a PMC graph from the TEASER graph
+  const int num_vertices = graph.numVertices();
+  edges_.clear();
+  vertices_.clear();
+  edges_.reserve(2 * static_cast<size_t>(graph.numEdges()));
+  vertices_.reserve(num_vertices + 1);
+  vertices_.push_back(edges_.size());
+  for (int i = 0; i < num_vertices; ++i) {
     const auto& c_edges = graph.getEdges(i);
-    edges.insert(edges.end(), c_edges.begin(), c_edges.end());
-    vertices.push_back(edges.size());
+    edges_.insert(edges_.end(), c_edges.begin(), c_edges.end());
+    vertices_.push_back(edges_.size());
   }
 
   // Use PMC to calculate
-  pmc::pmc_graph G(vertices, edges);
+  pmc::pmc_graph G(vertices_, edges_);
 
   // Prepare PMC input
   // TODO: Incorporate this to the constructor
   pmc::input in;
   in.algorithm = 0;
-  in.threads = 12;
+  in.threads = params_.num_threads;
   in.experiment = 0;
   in.lb = 0;
   in.ub = 0;
   in.param_ub = 0;
   in.adj_limit = 20000;
-  in.time_limit = params_.time_limit;
+  in.time_limit = std::min(time_limit,
+                           params_.cancellation_token
+                               ? params_.cancellation_token->getRemainingTime()
+                               : std::numeric_limits<double>::infinity());
   in.remove_time = 4;
   in.graph_stats = false;
   in.verbose = false;
@@ -53,20 +281,44 @@ vector<int> teaser::MaxCliqueSolver::findMaxClique(teaser::Graph graph) {
 
   // vector to represent max clique
   vector<int> C;
+  if (isCancelled(params_.cancellation_token)) {
+    return C;
+  }
+
+  // Keep the largest prefix-consistent part of the initial clique: each kept vertex is adjacent to
+  // all the vertices kept before it
+  vector<int> warm_clique;
+  if (!initial_clique.empty()) {
+    vector<int> num_kept_neighbors(num_vertices, 0);
+    for (const auto& v : initial_clique) {
+      if (v < 0 || v >= num_vertices ||
+          num_kept_neighbors[v] != static_cast<int>(warm_clique.size())) {
+        continue;
+      }
+      warm_clique.push_back(v);
+      for (const auto& u : graph.getEdges(v)) {
+        num_kept_neighbors[u]++;
+      }
+    }
+  }
 
   // upper-bound of max clique
-  G.compute_cores();
+  {
+    TEASER_TRACE_SCOPE("PMC k-core decomposition");
+    G.compute_cores();
+  }
   auto max_core = G.get_max_core();
+  max_core_ = max_core;
 
   TEASER_DEBUG_INFO_MSG("Max core number: " << max_core);
-  TEASER_DEBUG_INFO_MSG("Num vertices: " << vertices.size());
+  TEASER_DEBUG_INFO_MSG("Num vertices: " << vertices_.size());
 
   // check for k-core heuristic threshold
   // check whether threshold equals 1 to short circuit the comparison
   if (params_.solver_mode == CLIQUE_SOLVER_MODE::KCORE_HEU &&
       params_.kcore_heuristic_threshold != 1 &&
       max_core > static_cast<int>(params_.kcore_heuristic_threshold *
-                                  static_cast<double>(all_vertices.size()))) {
+                                  static_cast<double>(num_vertices))) {
     TEASER_DEBUG_INFO_MSG("Using K-core heuristic finder.");
     // remove all nodes with core number less than max core number
     // k_cores is a vector saving the core number of each vertex
@@ -84,10 +336,26 @@ vector<int> teaser::MaxCliqueSolver::findMaxClique(teaser::Graph graph) {
     in.ub = max_core + 1;
   }
 
-  // lower-bound of max clique
-  if (in.lb == 0 && in.heu_strat != "0") { // skip if given as input
+  if (isCancelled(params_.cancellation_token)) {
+    return C;
+  }
+
+  // lower-bound of max clique. The exact search improves on a warm start clique anyway, so the
+  // heuristic search is only run without one, or when it is the final answer.
+  if (warm_clique.size() > 1) {
+    C = warm_clique;
+    in.lb = C.size();
+  }
+  if ((in.lb == 0 || params_.solver_mode != CLIQUE_SOLVER_MODE::PMC_EXACT) &&
+      in.heu_strat != "0") {
+    TEASER_TRACE_SCOPE("PMC heuristic search");
+    vector<int> heuristic_clique;
     pmc::pmc_heu maxclique(G, in);
-    in.lb = maxclique.search(G, C);
+    const int heuristic_lb = maxclique.search(G, heuristic_clique);
+    if (heuristic_lb > in.lb) {
+      in.lb = heuristic_lb;
+      C = std::move(heuristic_clique);
+    }
   }
 
   assert(in.lb != 0);
@@ -97,7 +365,7 @@ vector<int> teaser::MaxCliqueSolver::findMaxClique(teaser::Graph graph) {
     return C;
   }
 
-  if (in.lb == in.ub) {
+  if (in.lb == in.ub || isCancelled(params_.cancellation_token)) {
     return C;
   }
 
@@ -111,6 +379,7 @@ vector<int> teaser::MaxCliqueSolver::findMaxClique(teaser::Graph graph) {
     // R. A. Rossi, D. F. Gleich, and A. H. Gebremedhin, “Parallel Maximum Clique Algorithms with
     // Applications to Network Analysis,” SIAM J. Sci. Comput., vol. 37, no. 5, pp. C589–C616, Jan.
     // 2015.
+    TEASER_TRACE_SCOPE("PMC exact search");
     if (G.num_vertices() < in.adj_limit) {
       G.create_adj();
       pmc::pmcx_maxclique finder(G, in);
@@ -123,3 +392,65 @@ vector<int> teaser::MaxCliqueSolver::findMaxClique(teaser::Graph graph) {
 
   return C;
 }
+
+bool teaser::MaxCliqueSolver::findMaxCliqueOnDenseGraph(const teaser::Graph& graph,
+                                                        vector<int>* clique) {
+  TEASER_TRACE_SCOPE("MaxCliqueSolver::findMaxCliqueOnDenseGraph");
+
+  // Complement graph. The adjacency lists keep their capacity across calls.
+  const int num_vertices = graph.numVertices();
+  complement_.resize(num_vertices);
+  vector<bool>& is_neighbor = in_cover_;
+  is_neighbor.assign(num_vertices, false);
+  for (int i = 0; i < num_vertices; ++i) {
+    if (isCancelled(params_.cancellation_token)) {
+      return false;
+    }
+    complement_[i].clear();
+    for (const auto& j : graph.getEdges(i)) {
+      is_neighbor[j] = true;
+    }
+    for (int j = 0; j < num_vertices; ++j) {
+      if (j != i && !is_neighbor[j]) {
+        complement_[i].push_back(j);
+      }
+    }
+    for (const auto& j : graph.getEdges(i)) {
+      is_neighbor[j] = false;
+    }
+  }
+
+  // The budget on search tree nodes only matters for adversarial graphs; complements of inlier
+  // graphs are mostly resolved by forced choices. Each node costs O(N), so the budget bounds the
+  // total work to about 2^26 vertex visits.
+  const size_t max_nodes = std::max<size_t>(1 << 10, (size_t(1) << 26) / std::max(num_vertices, 1));
+  VertexCoverSearch search(complement_, &degrees_, &in_cover_, &cover_, params_.time_limit,
+                           params_.cancellation_token.get());
+  if (!search.solve(params_.dense_graph_max_cover_size, max_nodes)) {
+    return false;
+  }
+
+  clique->clear();
+  for (int i = 0; i < num_vertices; ++i) {
+    if (!in_cover_[i]) {
+      clique->push_back(i);
+    }
+  }
+  return true;
+}
+
+vector<vector<int>> teaser::MaxCliqueSolver::findMaxCliques(const teaser::Graph& graph,
+                                                            size_t num_cliques) {
+  vector<vector<int>> cliques;
+  teaser::Graph remaining = graph;
+  while (cliques.size() < num_cliques) {
+    auto clique = findMaxClique(remaining);
+    if (clique.size() <= 1 || isCancelled(params_.cancellation_token)) {
+      break;
+    }
+    // Isolate vertices already used by a clique, keeping vertex numbering intact
+    remaining.isolateVertices(clique);
+    cliques.push_back(std::move(clique));
+  }
+  return cliques;
+}
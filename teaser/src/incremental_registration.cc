@@ -0,0 +1,159 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "teaser/incremental_registration.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "teaser/trace.h"
+
+teaser::IncrementalRegistrationSolver::IncrementalRegistrationSolver(
+    const RobustRegistrationSolver::Params& params)
+    : solver_(params) {
+  assert(!params.estimate_scaling);
+  assert(solver_.getInlierSelectionMode() !=
+         RobustRegistrationSolver::INLIER_SELECTION_MODE::NONE);
+}
+
+std::vector<int>
+teaser::IncrementalRegistrationSolver::addCorrespondences(const teaser::MeasurementsRef& src,
+                                                          const teaser::MeasurementsRef& dst) {
+  TEASER_TRACE_SCOPE("IncrementalRegistrationSolver::addCorrespondences");
+  assert(src.cols() == dst.cols());
+  const auto start = std::chrono::steady_clock::now();
+
+  // Correspondences to check the new ones against; each new one joins them once checked, so that
+  // every new pair is checked exactly once
+  std::vector<int> others;
+  others.reserve(num_correspondences_ + src.cols());
+  for (size_t i = 0; i < num_ids_; ++i) {
+    if (active_[i]) {
+      others.push_back(i);
+    }
+  }
+
+  // Ids: reuse the free ones first, then grow the storage geometrically
+  std::vector<int> ids(src.cols());
+  for (auto& id : ids) {
+    if (!free_ids_.empty()) {
+      id = free_ids_.back();
+      free_ids_.pop_back();
+    } else {
+      id = num_ids_++;
+    }
+  }
+  if (num_ids_ > static_cast<size_t>(src_.cols())) {
+    const Eigen::Index capacity = std::max<Eigen::Index>(num_ids_, 2 * src_.cols());
+    src_.conservativeResize(3, capacity);
+    dst_.conservativeResize(3, capacity);
+  }
+  active_.resize(num_ids_, false);
+  solver_.inlier_graph_.populateVertices(num_ids_);
+
+  // Same test as the one applied to the TIMs by a full solve with known scale
+  ScaleInliersSelector selector(solver_.params_.noise_bound, solver_.params_.cbar2);
+  Eigen::RowVectorXd src_norms;
+  Eigen::RowVectorXd dst_norms;
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> edges_mask;
+  double scale;
+  for (size_t c = 0; c < ids.size(); ++c) {
+    int id = ids[c];
+    src_.col(id) = src.col(c);
+    dst_.col(id) = dst.col(c);
+
+    // TIMs between the new correspondence and all the others
+    Eigen::Index num_others = others.size();
+    src_norms.resize(num_others);
+    dst_norms.resize(num_others);
+#pragma omp parallel for default(none) shared(num_others, others, id, src_norms, dst_norms)
+    for (Eigen::Index j = 0; j < num_others; ++j) {
+      src_norms(j) = (src_.col(others[j]) - src_.col(id)).norm();
+      dst_norms(j) = (dst_.col(others[j]) - dst_.col(id)).norm();
+    }
+    selector.solveForScaleFromNorms(src_norms, dst_norms, &scale, &edges_mask);
+    for (Eigen::Index j = 0; j < num_others; ++j) {
+      if (edges_mask(j)) {
+        solver_.inlier_graph_.addEdgeUnchecked(id, others[j]);
+      }
+    }
+    num_checked_pairs_ += num_others;
+
+    active_[id] = true;
+    others.push_back(id);
+  }
+  num_correspondences_ += ids.size();
+
+  update_time_ +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return ids;
+}
+
+void teaser::IncrementalRegistrationSolver::removeCorrespondences(const std::vector<int>& ids) {
+  TEASER_TRACE_SCOPE("IncrementalRegistrationSolver::removeCorrespondences");
+  const auto start = std::chrono::steady_clock::now();
+  for (const auto& id : ids) {
+    assert(id >= 0 && static_cast<size_t>(id) < num_ids_ && active_[id]);
+    active_[id] = false;
+    free_ids_.push_back(id);
+  }
+  num_correspondences_ -= ids.size();
+  solver_.inlier_graph_.isolateVertices(ids);
+
+  // What remains of the last clique is still a clique: the edges between the remaining
+  // correspondences do not change
+  clique_.erase(std::remove_if(clique_.begin(), clique_.end(),
+                               [this](int id) { return !active_[id]; }),
+                clique_.end());
+
+  update_time_ +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void teaser::IncrementalRegistrationSolver::clear() {
+  num_ids_ = 0;
+  num_correspondences_ = 0;
+  active_.clear();
+  free_ids_.clear();
+  clique_.clear();
+  solver_.inlier_graph_.clearEdges();
+  solver_.inlier_graph_.populateVertices(0);
+}
+
+teaser::RegistrationSolution teaser::IncrementalRegistrationSolver::solve() {
+  TEASER_TRACE_SCOPE("IncrementalRegistrationSolver::solve");
+  auto& stats = solver_.stats_;
+  stats = RegistrationStats();
+  stats.num_measurements = num_correspondences_;
+  stats.num_tims = num_checked_pairs_;
+  stats.graph_time = update_time_;
+  stats.num_edges = solver_.inlier_graph_.numEdges();
+  if (num_correspondences_ > 1) {
+    stats.graph_density = static_cast<double>(stats.num_edges) /
+                          (0.5 * num_correspondences_ * (num_correspondences_ - 1));
+  }
+  num_checked_pairs_ = 0;
+  update_time_ = 0;
+
+  solver_.solution_ = RegistrationSolution();
+  solver_.solution_.scale = 1;
+  if (num_correspondences_ < 2) {
+    solver_.solution_.valid = false;
+    solver_.solution_.stage = RegistrationSolution::STAGE::MAX_CLIQUE;
+    solver_.max_clique_.clear();
+    solver_.translation_inliers_.clear();
+    return solver_.solution_;
+  }
+
+  // Removed ids are isolated vertices of the graph, so they are never part of the clique
+  solver_.sample_indices_.clear();
+  solver_.warm_start_clique_ = clique_;
+  auto solution = solver_.solveFromInlierGraph(src_.leftCols(num_ids_), dst_.leftCols(num_ids_));
+  clique_ = solver_.max_clique_;
+  return solution;
+}
@@ -0,0 +1,451 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "teaser/kernels.h"
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+
+// Runtime dispatch needs per-function target attributes and cpuid, i.e., GCC or Clang on x86.
+// Elsewhere, only the scalar kernels are built.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TEASER_KERNELS_DISPATCH 1
+#include <immintrin.h>
+#define TEASER_TARGET(isa) __attribute__((target(isa)))
+#define TEASER_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define TEASER_KERNELS_DISPATCH 0
+#define TEASER_ALWAYS_INLINE inline
+#endif
+
+namespace {
+
+using teaser::kernels::ISA;
+
+/**
+ * Squared norm of a TIM, summed in the same order as the vectorized kernels
+ */
+inline double squaredNorm(const double* v) { return v[0] * v[0] + v[1] * v[1] + v[2] * v[2]; }
+
+/**
+ * Scale check of up to 64 TIMs, one bit each. Any stride.
+ */
+inline uint64_t scaleInliersWordScalar(const double* src, const double* dst, size_t stride,
+                                       size_t count, double beta2) {
+  uint64_t word = 0;
+  for (size_t k = 0; k < count; ++k) {
+    const double s1 = squaredNorm(src + k * stride);
+    const double s2 = squaredNorm(dst + k * stride);
+    const double d = s1 + s2 - beta2;
+    const bool inlier = (d <= 0) | (d * d <= 4 * s1 * s2);
+    word |= static_cast<uint64_t>(inlier) << k;
+  }
+  return word;
+}
+
+/**
+ * Scale check of 64 contiguous TIMs
+ */
+uint64_t scaleInliersWordSCALAR(const double* src, const double* dst, double beta2) {
+  return scaleInliersWordScalar(src, dst, 3, 64, beta2);
+}
+
+/**
+ * The loop kernels below are written once, as plain loops, and compiled for every ISA by inlining
+ * them into functions with the matching target attribute (see TEASER_LOOP_KERNELS).
+ */
+
+/**
+ * TIMs of a segment: tims[:, k] = points[:, k] - origin
+ */
+TEASER_ALWAYS_INLINE void timSegmentLoop(const double* points, size_t points_stride,
+                                         size_t num_points, const double* origin, double* tims,
+                                         size_t tims_stride) {
+  if (points_stride == 3 && tims_stride == 3) {
+    // Contiguous columns: subtract a pattern of the origin repeated over 8 TIMs, which evenly
+    // fills vectors of any width
+    double pattern[24];
+    for (int k = 0; k < 24; ++k) {
+      pattern[k] = origin[k % 3];
+    }
+    const size_t num_blocks = num_points / 8;
+    for (size_t b = 0; b < num_blocks; ++b) {
+      const double* p = points + 24 * b;
+      double* t = tims + 24 * b;
+#pragma omp simd
+      for (int k = 0; k < 24; ++k) {
+        t[k] = p[k] - pattern[k];
+      }
+    }
+    for (size_t k = 24 * num_blocks; k < 3 * num_points; ++k) {
+      tims[k] = points[k] - pattern[k % 3];
+    }
+    return;
+  }
+  for (size_t j = 0; j < num_points; ++j) {
+    for (int r = 0; r < 3; ++r) {
+      tims[j * tims_stride + r] = points[j * points_stride + r] - origin[r];
+    }
+  }
+}
+
+/**
+ * Consensus sweep of the scalar TLS estimator, over a range of interval centers. Two passes over
+ * the measurements per center (weighted mean of the consensus set, then its residuals), without
+ * materializing the consensus set.
+ */
+TEASER_ALWAYS_INLINE void tlsConsensusSweepLoop(const double* X, const double* ranges,
+                                                const double* weights, size_t N,
+                                                const double* centers, size_t num_centers,
+                                                double* x_hat, double* x_cost) {
+  for (size_t i = 0; i < num_centers; ++i) {
+    const double center = centers[i];
+    double dot_X_weights = 0;
+    double dot_weights_consensus = 0;
+    double ranges_outliers_sum = 0;
+#pragma omp simd reduction(+ : dot_X_weights, dot_weights_consensus, ranges_outliers_sum)
+    for (size_t j = 0; j < N; ++j) {
+      const bool consensus = std::abs(X[j] - center) <= ranges[j];
+      dot_X_weights += consensus ? X[j] * weights[j] : 0.0;
+      dot_weights_consensus += consensus ? weights[j] : 0.0;
+      ranges_outliers_sum += consensus ? 0.0 : ranges[j];
+    }
+    const double estimate = dot_X_weights / dot_weights_consensus;
+
+    double residuals_sq_sum = 0;
+#pragma omp simd reduction(+ : residuals_sq_sum)
+    for (size_t j = 0; j < N; ++j) {
+      const bool consensus = std::abs(X[j] - center) <= ranges[j];
+      const double residual = X[j] - estimate;
+      residuals_sq_sum += consensus ? residual * residual : 0.0;
+    }
+    x_hat[i] = estimate;
+    x_cost[i] = residuals_sq_sum + ranges_outliers_sum;
+  }
+}
+
+/**
+ * Squared residuals ||dst[:, j] - R * src[:, j]||^2, with the strides known at compile time when
+ * possible, so that the column loads vectorize
+ */
+template <size_t SrcStride, size_t DstStride>
+TEASER_ALWAYS_INLINE void squaredResidualsStrided(const double* R, const double* src,
+                                                  size_t src_stride, const double* dst,
+                                                  size_t dst_stride, size_t num, double* out) {
+  const size_t ss = SrcStride ? SrcStride : src_stride;
+  const size_t ds = DstStride ? DstStride : dst_stride;
+  const double r00 = R[0], r10 = R[1], r20 = R[2];
+  const double r01 = R[3], r11 = R[4], r21 = R[5];
+  const double r02 = R[6], r12 = R[7], r22 = R[8];
+#pragma omp simd
+  for (size_t j = 0; j < num; ++j) {
+    const double* s = src + j * ss;
+    const double* d = dst + j * ds;
+    const double e0 = d[0] - (r00 * s[0] + r01 * s[1] + r02 * s[2]);
+    const double e1 = d[1] - (r10 * s[0] + r11 * s[1] + r12 * s[2]);
+    const double e2 = d[2] - (r20 * s[0] + r21 * s[1] + r22 * s[2]);
+    out[j] = e0 * e0 + e1 * e1 + e2 * e2;
+  }
+}
+
+TEASER_ALWAYS_INLINE void squaredResidualsLoop(const double* R, const double* src,
+                                               size_t src_stride, const double* dst,
+                                               size_t dst_stride, size_t num, double* out) {
+  if (src_stride == 3 && dst_stride == 3) {
+    squaredResidualsStrided<3, 3>(R, src, 3, dst, 3, num, out);
+  } else {
+    squaredResidualsStrided<0, 0>(R, src, src_stride, dst, dst_stride, num, out);
+  }
+}
+
+/**
+ * Define the loop kernels for one ISA, with the provided suffix and function attributes
+ */
+#define TEASER_LOOP_KERNELS(SUFFIX, ATTRIBUTES)                                                    \
+  ATTRIBUTES void timSegment##SUFFIX(const double* points, size_t points_stride,                  \
+                                     size_t num_points, const double* origin, double* tims,        \
+                                     size_t tims_stride) {                                         \
+    timSegmentLoop(points, points_stride, num_points, origin, tims, tims_stride);                  \
+  }                                                                                                \
+  ATTRIBUTES void tlsConsensusSweep##SUFFIX(const double* X, const double* ranges,                 \
+                                            const double* weights, size_t N,                       \
+                                            const double* centers, size_t num_centers,             \
+                                            double* x_hat, double* x_cost) {                       \
+    tlsConsensusSweepLoop(X, ranges, weights, N, centers, num_centers, x_hat, x_cost);             \
+  }                                                                                                \
+  ATTRIBUTES void squaredResiduals##SUFFIX(const double* R, const double* src, size_t src_stride,  \
+                                           const double* dst, size_t dst_stride, size_t num,       \
+                                           double* out) {                                          \
+    squaredResidualsLoop(R, src, src_stride, dst, dst_stride, num, out);                           \
+  }
+
+TEASER_LOOP_KERNELS(SCALAR, )
+
+#if TEASER_KERNELS_DISPATCH
+
+TEASER_LOOP_KERNELS(SSE4_2, TEASER_TARGET("sse4.2"))
+TEASER_LOOP_KERNELS(AVX2, TEASER_TARGET("avx2,fma"))
+TEASER_LOOP_KERNELS(AVX512, TEASER_TARGET("avx512f,avx2,fma"))
+
+/**
+ * Squared norms of 2 contiguous TIMs (6 doubles): a = [x0 y0], b = [z0 x1] and c = [y1 z1]
+ */
+TEASER_TARGET("sse4.2") inline __m128d squaredNorms2(const double* v) {
+  const __m128d a = _mm_loadu_pd(v);
+  const __m128d b = _mm_loadu_pd(v + 2);
+  const __m128d c = _mm_loadu_pd(v + 4);
+  const __m128d x = _mm_shuffle_pd(a, b, 0x2);
+  const __m128d y = _mm_shuffle_pd(a, c, 0x1);
+  const __m128d z = _mm_shuffle_pd(b, c, 0x2);
+  return _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y)), _mm_mul_pd(z, z));
+}
+
+/**
+ * Scale check of 64 contiguous TIMs
+ */
+TEASER_TARGET("sse4.2")
+uint64_t scaleInliersWordSSE4_2(const double* src, const double* dst, double beta2) {
+  const __m128d beta2_v = _mm_set1_pd(beta2);
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d four = _mm_set1_pd(4);
+  uint64_t word = 0;
+  for (int j = 0; j < 32; ++j) {
+    const __m128d s1 = squaredNorms2(src + 6 * j);
+    const __m128d s2 = squaredNorms2(dst + 6 * j);
+    const __m128d d = _mm_sub_pd(_mm_add_pd(s1, s2), beta2_v);
+    const __m128d inliers =
+        _mm_or_pd(_mm_cmple_pd(d, zero),
+                  _mm_cmple_pd(_mm_mul_pd(d, d), _mm_mul_pd(_mm_mul_pd(four, s1), s2)));
+    word |= static_cast<uint64_t>(_mm_movemask_pd(inliers)) << (2 * j);
+  }
+  return word;
+}
+
+/**
+ * Squared norms of 4 contiguous TIMs (12 doubles): a = [x0 y0 z0 x1], b = [y1 z1 x2 y2] and
+ * c = [z2 x3 y3 z3] are deinterleaved with lane permutes, blends and shuffles
+ */
+TEASER_TARGET("avx2,fma") inline __m256d squaredNorms4(const double* v) {
+  const __m256d a = _mm256_loadu_pd(v);
+  const __m256d b = _mm256_loadu_pd(v + 4);
+  const __m256d c = _mm256_loadu_pd(v + 8);
+  const __m256d u = _mm256_permute2f128_pd(a, c, 0x30); // x0 y0 y3 z3
+  const __m256d w = _mm256_permute2f128_pd(a, c, 0x21); // z0 x1 z2 x3
+  const __m256d x = _mm256_blend_pd(_mm256_blend_pd(u, w, 0xA), b, 0x4);
+  const __m256d y = _mm256_permute_pd(_mm256_shuffle_pd(u, b, 0x9), 0x6);
+  const __m256d z = _mm256_blend_pd(_mm256_shuffle_pd(w, b, 0x2), u, 0x8);
+  return _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)),
+                       _mm256_mul_pd(z, z));
+}
+
+/**
+ * Scale check of 64 contiguous TIMs
+ */
+TEASER_TARGET("avx2,fma")
+uint64_t scaleInliersWordAVX2(const double* src, const double* dst, double beta2) {
+  const __m256d beta2_v = _mm256_set1_pd(beta2);
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d four = _mm256_set1_pd(4);
+  uint64_t word = 0;
+  for (int j = 0; j < 16; ++j) {
+    const __m256d s1 = squaredNorms4(src + 12 * j);
+    const __m256d s2 = squaredNorms4(dst + 12 * j);
+    const __m256d d = _mm256_sub_pd(_mm256_add_pd(s1, s2), beta2_v);
+    const __m256d inliers = _mm256_or_pd(
+        _mm256_cmp_pd(d, zero, _CMP_LE_OQ),
+        _mm256_cmp_pd(_mm256_mul_pd(d, d), _mm256_mul_pd(_mm256_mul_pd(four, s1), s2),
+                      _CMP_LE_OQ));
+    word |= static_cast<uint64_t>(_mm256_movemask_pd(inliers)) << (4 * j);
+  }
+  return word;
+}
+
+/**
+ * Squared norms of 8 contiguous TIMs (24 doubles): deinterleave x, y and z with two-source
+ * permutes, then sum the squares
+ */
+TEASER_TARGET("avx512f,avx2,fma") inline __m512d squaredNorms8(const double* v) {
+  const __m512d a = _mm512_loadu_pd(v);
+  const __m512d b = _mm512_loadu_pd(v + 8);
+  const __m512d c = _mm512_loadu_pd(v + 16);
+  // Element k of the stream a|b|c belongs to TIM k / 3, coordinate k % 3
+  const __m512d x = _mm512_permutex2var_pd(
+      _mm512_permutex2var_pd(a, _mm512_setr_epi64(0, 3, 6, 9, 12, 15, 0, 0), b),
+      _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 10, 13), c);
+  const __m512d y = _mm512_permutex2var_pd(
+      _mm512_permutex2var_pd(a, _mm512_setr_epi64(1, 4, 7, 10, 13, 0, 0, 0), b),
+      _mm512_setr_epi64(0, 1, 2, 3, 4, 8, 11, 14), c);
+  const __m512d z = _mm512_permutex2var_pd(
+      _mm512_permutex2var_pd(a, _mm512_setr_epi64(2, 5, 8, 11, 14, 0, 0, 0), b),
+      _mm512_setr_epi64(0, 1, 2, 3, 4, 9, 12, 15), c);
+  return _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(x, x), _mm512_mul_pd(y, y)),
+                       _mm512_mul_pd(z, z));
+}
+
+/**
+ * Scale check of 64 contiguous TIMs
+ */
+TEASER_TARGET("avx512f,avx2,fma")
+uint64_t scaleInliersWordAVX512(const double* src, const double* dst, double beta2) {
+  const __m512d beta2_v = _mm512_set1_pd(beta2);
+  const __m512d zero = _mm512_setzero_pd();
+  const __m512d four = _mm512_set1_pd(4);
+  uint64_t word = 0;
+  for (int j = 0; j < 8; ++j) {
+    const __m512d s1 = squaredNorms8(src + 24 * j);
+    const __m512d s2 = squaredNorms8(dst + 24 * j);
+    const __m512d d = _mm512_sub_pd(_mm512_add_pd(s1, s2), beta2_v);
+    const __mmask8 inliers =
+        _mm512_cmp_pd_mask(d, zero, _CMP_LE_OQ) |
+        _mm512_cmp_pd_mask(_mm512_mul_pd(d, d), _mm512_mul_pd(_mm512_mul_pd(four, s1), s2),
+                           _CMP_LE_OQ);
+    word |= static_cast<uint64_t>(inliers) << (8 * j);
+  }
+  return word;
+}
+
+#endif
+
+/**
+ * Kernels compiled for one ISA
+ */
+struct KernelTable {
+  uint64_t (*scale_inliers_word)(const double*, const double*, double);
+  void (*tim_segment)(const double*, size_t, size_t, const double*, double*, size_t);
+  void (*tls_consensus_sweep)(const double*, const double*, const double*, size_t, const double*,
+                              size_t, double*, double*);
+  void (*squared_residuals)(const double*, const double*, size_t, const double*, size_t, size_t,
+                            double*);
+};
+
+#define TEASER_KERNEL_TABLE(SUFFIX)                                                                \
+  { scaleInliersWord##SUFFIX, timSegment##SUFFIX, tlsConsensusSweep##SUFFIX,                      \
+    squaredResiduals##SUFFIX }
+
+const KernelTable& kernelTable(ISA isa) {
+  static const KernelTable scalar = TEASER_KERNEL_TABLE(SCALAR);
+#if TEASER_KERNELS_DISPATCH
+  static const KernelTable sse4_2 = TEASER_KERNEL_TABLE(SSE4_2);
+  static const KernelTable avx2 = TEASER_KERNEL_TABLE(AVX2);
+  static const KernelTable avx512 = TEASER_KERNEL_TABLE(AVX512);
+  switch (isa) {
+  case ISA::AVX512:
+    return avx512;
+  case ISA::AVX2:
+    return avx2;
+  case ISA::SSE4_2:
+    return sse4_2;
+  default:
+    break;
+  }
+#endif
+  return scalar;
+}
+
+/**
+ * ISA of the kernels in use, resolved from cpuid the first time a kernel runs
+ */
+std::atomic<int>& activeISAStorage() {
+  static std::atomic<int> isa(static_cast<int>(teaser::kernels::bestSupportedISA()));
+  return isa;
+}
+
+const KernelTable& activeTable() {
+  return kernelTable(static_cast<ISA>(activeISAStorage().load(std::memory_order_relaxed)));
+}
+
+} // namespace
+
+teaser::kernels::ISA teaser::kernels::bestSupportedISA() {
+#if TEASER_KERNELS_DISPATCH
+  // The checks also cover the OS support for the wider registers
+  __builtin_cpu_init();
+  const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  if (avx2 && __builtin_cpu_supports("avx512f")) {
+    return ISA::AVX512;
+  }
+  if (avx2) {
+    return ISA::AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.2")) {
+    return ISA::SSE4_2;
+  }
+#endif
+  return ISA::SCALAR;
+}
+
+teaser::kernels::ISA teaser::kernels::activeISA() {
+  return static_cast<ISA>(activeISAStorage().load(std::memory_order_relaxed));
+}
+
+void teaser::kernels::setISA(ISA isa) {
+  assert(isa <= bestSupportedISA());
+  activeISAStorage().store(static_cast<int>(isa), std::memory_order_relaxed);
+}
+
+const char* teaser::kernels::isaName(ISA isa) {
+  switch (isa) {
+  case ISA::AVX512:
+    return "AVX-512";
+  case ISA::AVX2:
+    return "AVX2";
+  case ISA::SSE4_2:
+    return "SSE4.2";
+  default:
+    return "scalar";
+  }
+}
+
+void teaser::kernels::scaleInliersMask(const double* src_tims, const double* dst_tims,
+                                       size_t stride, size_t num_tims, double beta,
+                                       uint64_t* mask) {
+  double beta2 = beta * beta;
+  const size_t num_words = numMaskWords(num_tims);
+  size_t num_full_words = num_tims / 64;
+  if (stride == 3) {
+    auto scale_inliers_word = activeTable().scale_inliers_word;
+#pragma omp parallel for default(none)                                                            \
+    shared(src_tims, dst_tims, num_full_words, beta2, mask, scale_inliers_word)
+    for (size_t w = 0; w < num_full_words; ++w) {
+      mask[w] = scale_inliers_word(src_tims + 3 * 64 * w, dst_tims + 3 * 64 * w, beta2);
+    }
+  } else {
+#pragma omp parallel for default(none)                                                            \
+    shared(src_tims, dst_tims, stride, num_full_words, beta2, mask)
+    for (size_t w = 0; w < num_full_words; ++w) {
+      mask[w] = scaleInliersWordScalar(src_tims + stride * 64 * w, dst_tims + stride * 64 * w,
+                                       stride, 64, beta2);
+    }
+  }
+
+  // Last, partial word
+  if (num_words > num_full_words) {
+    const size_t begin = 64 * num_full_words;
+    mask[num_full_words] = scaleInliersWordScalar(src_tims + stride * begin,
+                                                  dst_tims + stride * begin, stride,
+                                                  num_tims - begin, beta2);
+  }
+}
+
+void teaser::kernels::timSegment(const double* points, size_t points_stride, size_t num_points,
+                                 const double* origin, double* tims, size_t tims_stride) {
+  activeTable().tim_segment(points, points_stride, num_points, origin, tims, tims_stride);
+}
+
+void teaser::kernels::tlsConsensusSweep(const double* X, const double* ranges,
+                                        const double* weights, size_t N, const double* centers,
+                                        size_t num_centers, double* x_hat, double* x_cost) {
+  activeTable().tls_consensus_sweep(X, ranges, weights, N, centers, num_centers, x_hat, x_cost);
+}
+
+void teaser::kernels::squaredResiduals(const double* rotation, const double* src,
+                                       size_t src_stride, const double* dst, size_t dst_stride,
+                                       size_t num, double* residuals_sq) {
+  activeTable().squared_residuals(rotation, src, src_stride, dst, dst_stride, num, residuals_sq);
+}
@@ -0,0 +1,220 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "teaser/localization.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "teaser/trace.h"
+
+namespace {
+
+/**
+ * Measure the wall times of consecutive stages
+ */
+class StageTimer {
+public:
+  StageTimer() : start_(std::chrono::steady_clock::now()) {}
+
+  /**
+   * @return time since the end of the previous stage (or construction), in seconds
+   */
+  double lap() {
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - start_).count();
+    start_ = now;
+    return elapsed;
+  }
+
+private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace
+
+int teaser::LocalizationEngine::addTile(const teaser::PointCloud& points) {
+  TEASER_TRACE_SCOPE("LocalizationEngine::addTile");
+  std::unique_ptr<Tile> tile(new Tile);
+  tile->points.resize(3, points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    tile->points.col(i) << points[i].x, points[i].y, points[i].z;
+  }
+  buildFeatureIndex(points, &(tile->index));
+  tiles_.push_back(std::move(tile));
+  return static_cast<int>(tiles_.size()) - 1;
+}
+
+void teaser::LocalizationEngine::buildFeatureIndex(const teaser::PointCloud& points,
+                                                   FeatureIndex* index) {
+  auto features = fpfh_.computeFPFHFeatures(points, params_.normal_search_radius,
+                                            params_.fpfh_search_radius);
+  index->num_features = features->size();
+  index->descriptors.resize(index->num_features * DESCRIPTOR_SIZE);
+  for (size_t i = 0; i < index->num_features; ++i) {
+    const auto& histogram = (*features)[i].histogram;
+    std::copy(histogram, histogram + DESCRIPTOR_SIZE,
+              index->descriptors.begin() + i * DESCRIPTOR_SIZE);
+  }
+
+  index->tree.reset();
+  if (index->num_features > 0) {
+    flann::Matrix<float> dataset(index->descriptors.data(), index->num_features, DESCRIPTOR_SIZE);
+    index->tree.reset(new KDTree(dataset, flann::KDTreeSingleIndexParams(15)));
+    index->tree->buildIndex();
+  }
+}
+
+std::vector<std::pair<int, int>>
+teaser::LocalizationEngine::match(FeatureIndex* query, FeatureIndex* tile) const {
+  std::vector<std::pair<int, int>> correspondences;
+  if (!query->tree || !tile->tree) {
+    return correspondences;
+  }
+
+  // Nearest tile feature of every query feature, as one batched search
+  const size_t num_queries = query->num_features;
+  flann::Matrix<float> queries(query->descriptors.data(), num_queries, DESCRIPTOR_SIZE);
+  std::vector<int> nearest(num_queries);
+  std::vector<float> dists(num_queries);
+  flann::Matrix<int> nearest_mat(nearest.data(), num_queries, 1);
+  flann::Matrix<float> dists_mat(dists.data(), num_queries, 1);
+  tile->tree->knnSearch(queries, nearest_mat, dists_mat, 1, flann::SearchParams(128));
+
+  // Cross check: the nearest query feature of the matched tile feature has to be the query
+  // feature itself. Only the matched tile features are searched, and each only once.
+  std::vector<int> reverse(tile->num_features, -1);
+  int reverse_nearest;
+  float reverse_dist;
+  flann::Matrix<int> reverse_nearest_mat(&reverse_nearest, 1, 1);
+  flann::Matrix<float> reverse_dist_mat(&reverse_dist, 1, 1);
+  for (size_t q = 0; q < num_queries; ++q) {
+    const int t = nearest[q];
+    if (t < 0) {
+      continue;
+    }
+    if (params_.use_crosscheck) {
+      if (reverse[t] == -1) {
+        query->tree->knnSearch(tile->row(t), reverse_nearest_mat, reverse_dist_mat, 1,
+                               flann::SearchParams(128));
+        reverse[t] = reverse_nearest;
+      }
+      if (reverse[t] != static_cast<int>(q)) {
+        continue;
+      }
+    }
+    correspondences.emplace_back(q, t);
+  }
+  return correspondences;
+}
+
+teaser::LocalizationResult teaser::LocalizationEngine::localize(const teaser::PointCloud& query) {
+  TEASER_TRACE_SCOPE("LocalizationEngine::localize");
+  StageTimer timer;
+  LocalizationResult result;
+
+  // Query features
+  FeatureIndex query_index;
+  buildFeatureIndex(query, &query_index);
+  double feature_time = timer.lap();
+
+  // Match against all tiles
+  int num_tiles = tiles_.size();
+  std::vector<std::vector<std::pair<int, int>>> correspondences(num_tiles);
+  {
+    TEASER_TRACE_SCOPE("LocalizationEngine matching");
+#pragma omp parallel for default(none) shared(num_tiles, correspondences, query_index)           \
+    schedule(dynamic, 1)
+    for (int t = 0; t < num_tiles; ++t) {
+      correspondences[t] = match(&query_index, &(tiles_[t]->index));
+    }
+  }
+
+  // Candidate tiles: the ones with the most correspondences
+  std::vector<int> candidates;
+  for (int t = 0; t < num_tiles; ++t) {
+    if (correspondences[t].size() >= std::max<size_t>(params_.min_correspondences, 2)) {
+      candidates.push_back(t);
+    }
+  }
+  std::stable_sort(candidates.begin(), candidates.end(), [&correspondences](int a, int b) {
+    return correspondences[a].size() > correspondences[b].size();
+  });
+  if (params_.max_candidate_tiles > 0 && candidates.size() > params_.max_candidate_tiles) {
+    candidates.resize(params_.max_candidate_tiles);
+  }
+  double matching_time = timer.lap();
+
+  // Batched solve over the candidate tiles, each thread with its own solver context. Query points
+  // are the source, so that the solutions map the query frame to the map frame.
+  RobustRegistrationSolver::Params solver_params = params_.solver_params;
+  solver_params.max_clique_num_threads = 1;
+  RobustRegistrationSolver solver(solver_params);
+  int num_candidates = candidates.size();
+  std::vector<RegistrationSolution> solutions(num_candidates);
+  std::vector<std::vector<int>> inliers(num_candidates);
+  {
+    TEASER_TRACE_SCOPE("LocalizationEngine solve");
+#pragma omp parallel default(none)                                                                 \
+    shared(num_candidates, candidates, correspondences, query, solver, solutions, inliers)
+    {
+#ifdef _OPENMP
+      // Tiles are solved concurrently; each solve uses one thread
+      omp_set_num_threads(1);
+#endif
+      RegistrationContext context;
+#pragma omp for schedule(dynamic, 1)
+      for (int c = 0; c < num_candidates; ++c) {
+        const auto& tile_correspondences = correspondences[candidates[c]];
+        const auto& tile_points = tiles_[candidates[c]]->points;
+        Eigen::Matrix<double, 3, Eigen::Dynamic> src(3, tile_correspondences.size());
+        Eigen::Matrix<double, 3, Eigen::Dynamic> dst(3, tile_correspondences.size());
+        for (size_t i = 0; i < tile_correspondences.size(); ++i) {
+          const auto& point = query[tile_correspondences[i].first];
+          src.col(i) << point.x, point.y, point.z;
+          dst.col(i) = tile_points.col(tile_correspondences[i].second);
+        }
+        solutions[c] = solver.solve(src, dst, &context);
+        if (solutions[c].valid) {
+          inliers[c] = context.getTranslationInliers();
+        }
+      }
+    }
+  }
+
+  // Best tile: most final inliers
+  int best = -1;
+  for (int c = 0; c < num_candidates; ++c) {
+    result.candidate_tiles.push_back(candidates[c]);
+    result.candidate_inliers.push_back(inliers[c].size());
+    if (solutions[c].valid && (best < 0 || inliers[c].size() > inliers[best].size())) {
+      best = c;
+    }
+  }
+  if (best >= 0) {
+    result.valid = true;
+    result.tile = candidates[best];
+    result.solution = solutions[best];
+    result.correspondences = std::move(correspondences[candidates[best]]);
+    result.inliers = std::move(inliers[best]);
+  }
+  double solve_time = timer.lap();
+
+  stats_.num_queries++;
+  stats_.feature_time += feature_time;
+  stats_.matching_time += matching_time;
+  stats_.solve_time += solve_time;
+  stats_.last_query_time = feature_time + matching_time + solve_time;
+  stats_.total_time += stats_.last_query_time;
+  return result;
+}
@@ -13,6 +13,7 @@
 #include <flann/flann.hpp>
 
 #include "teaser/geometry.h"
+#include "teaser/trace.h"
 
 namespace teaser {
 
@@ -20,6 +21,7 @@ std::vector<std::pair<int, int>> Matcher::calculateCorrespondences(
     teaser::PointCloud& source_points, teaser::PointCloud& target_points,
     teaser::FPFHCloud& source_features, teaser::FPFHCloud& target_features, bool use_absolute_scale,
     bool use_crosscheck, bool use_tuple_test, float tuple_scale) {
+  TEASER_TRACE_SCOPE("Matcher::calculateCorrespondences");
 
   Feature cloud_features;
   pointcloud_.push_back(source_points);
@@ -110,6 +112,7 @@ void Matcher::normalizePoints(bool use_absolute_scale) {
   }
 }
 void Matcher::advancedMatching(bool use_crosscheck, bool use_tuple_test, float tuple_scale) {
+  TEASER_TRACE_SCOPE("Matcher::advancedMatching");
 
   int fi = 0; // source idx
   int fj = 1; // destination idx
@@ -0,0 +1,229 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "teaser/pipeline.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "teaser/trace.h"
+
+namespace {
+
+/**
+ * Back off while waiting on a queue: spin with yields first, so that handoffs between busy stages
+ * stay fast, then block until the queues change, so that idle stages do not take cores from the
+ * other stage
+ */
+class Backoff {
+public:
+  /**
+   * @return true if the caller should retry right away, false once it should block
+   */
+  bool spin() {
+    if (count_ < 64) {
+      ++count_;
+      std::this_thread::yield();
+      return true;
+    }
+    return false;
+  }
+
+private:
+  int count_ = 0;
+};
+
+} // namespace
+
+teaser::RegistrationPipeline::RegistrationPipeline(
+    const RobustRegistrationSolver::Params& solver_params)
+    : RegistrationPipeline(solver_params, Params()) {}
+
+teaser::RegistrationPipeline::RegistrationPipeline(
+    const RobustRegistrationSolver::Params& solver_params, const Params& pipeline_params)
+    : solver_params_(solver_params), params_(pipeline_params),
+      input_queue_(pipeline_params.queue_capacity), graph_queue_(pipeline_params.queue_capacity),
+      output_queue_(pipeline_params.queue_capacity) {
+  assert(params_.queue_capacity > 0);
+  front_thread_ = std::thread(&RegistrationPipeline::runFrontStage, this);
+  back_thread_ = std::thread(&RegistrationPipeline::runBackStage, this);
+}
+
+teaser::RegistrationPipeline::~RegistrationPipeline() {
+  stop_.store(true, std::memory_order_release);
+  notifyChange();
+  front_thread_.join();
+  back_thread_.join();
+}
+
+void teaser::RegistrationPipeline::push(RegistrationProblem problem) {
+  Backoff backoff;
+  for (;;) {
+    const uint64_t epoch = epoch_.load();
+    if (tryPush(problem)) {
+      return;
+    }
+    if (!backoff.spin()) {
+      waitForChange(epoch);
+    }
+  }
+}
+
+bool teaser::RegistrationPipeline::tryPush(RegistrationProblem& problem) {
+  std::unique_ptr<Frame> frame(new Frame);
+  frame->problem.src.swap(problem.src);
+  frame->problem.dst.swap(problem.dst);
+  // Count the frame before it becomes visible to the stages, so that a concurrent pop waits for it
+  num_in_flight_.fetch_add(1, std::memory_order_acq_rel);
+  if (!input_queue_.tryPush(std::move(frame))) {
+    num_in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+    problem.src.swap(frame->problem.src);
+    problem.dst.swap(frame->problem.dst);
+    return false;
+  }
+  notifyChange();
+  return true;
+}
+
+bool teaser::RegistrationPipeline::pop(Result* result) {
+  Backoff backoff;
+  while (numInFlight() > 0) {
+    const uint64_t epoch = epoch_.load();
+    if (tryPop(result)) {
+      return true;
+    }
+    if (!backoff.spin()) {
+      waitForChange(epoch);
+    }
+  }
+  return false;
+}
+
+bool teaser::RegistrationPipeline::tryPop(Result* result) {
+  std::unique_ptr<Frame> frame;
+  if (!output_queue_.tryPop(&frame)) {
+    return false;
+  }
+  num_in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+  notifyChange();
+  result->solution = frame->solution;
+  result->stats = frame->stats;
+  result->inliers = std::move(frame->inliers);
+  return true;
+}
+
+bool teaser::RegistrationPipeline::waitPush(SPSCQueue<std::unique_ptr<Frame>>* queue,
+                                            std::unique_ptr<Frame> frame) {
+  Backoff backoff;
+  for (;;) {
+    const uint64_t epoch = epoch_.load();
+    if (queue->tryPush(std::move(frame))) {
+      notifyChange();
+      return true;
+    }
+    if (stop_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    if (!backoff.spin()) {
+      waitForChange(epoch);
+    }
+  }
+}
+
+bool teaser::RegistrationPipeline::waitPop(SPSCQueue<std::unique_ptr<Frame>>* queue,
+                                           std::unique_ptr<Frame>* frame) {
+  Backoff backoff;
+  for (;;) {
+    const uint64_t epoch = epoch_.load();
+    if (queue->tryPop(frame)) {
+      notifyChange();
+      return true;
+    }
+    if (stop_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    if (!backoff.spin()) {
+      waitForChange(epoch);
+    }
+  }
+}
+
+void teaser::RegistrationPipeline::notifyChange() {
+  // Sequentially consistent with the increment of num_waiting_ in waitForChange(): either the
+  // waiter sees the new epoch, or this sees the waiter and notifies it
+  epoch_.fetch_add(1);
+  if (num_waiting_.load() > 0) {
+    // Taking the mutex ensures the waiter is either before its check of the epoch or blocked
+    { std::lock_guard<std::mutex> lock(mutex_); }
+    changed_.notify_all();
+  }
+}
+
+void teaser::RegistrationPipeline::waitForChange(uint64_t epoch) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  num_waiting_.fetch_add(1);
+  changed_.wait(lock, [&] { return epoch_.load() != epoch; });
+  num_waiting_.fetch_sub(1);
+}
+
+void teaser::RegistrationPipeline::runFrontStage() {
+#ifdef _OPENMP
+  if (params_.num_front_threads > 0) {
+    omp_set_num_threads(params_.num_front_threads);
+  }
+#endif
+  RobustRegistrationSolver solver(solver_params_);
+
+  std::unique_ptr<Frame> frame;
+  while (waitPop(&input_queue_, &frame)) {
+    TEASER_TRACE_SCOPE("RegistrationPipeline front stage");
+    solver.stats_ = RegistrationStats();
+    frame->done = !solver.solveInlierGraph(frame->problem.src, frame->problem.dst);
+    frame->solution = solver.solution_;
+    frame->stats = solver.stats_;
+    frame->sample_indices = solver.sample_indices_;
+    std::swap(frame->inlier_graph, solver.inlier_graph_);
+    if (!waitPush(&graph_queue_, std::move(frame))) {
+      return;
+    }
+  }
+}
+
+void teaser::RegistrationPipeline::runBackStage() {
+#ifdef _OPENMP
+  if (params_.num_back_threads > 0) {
+    omp_set_num_threads(params_.num_back_threads);
+  }
+#endif
+  // PMC ignores the OpenMP settings. Without an explicit thread count, it runs on this thread only,
+  // as the front stage may use all the cores.
+  RobustRegistrationSolver::Params solver_params = solver_params_;
+  solver_params.max_clique_num_threads =
+      params_.num_back_threads > 0 ? params_.num_back_threads : 1;
+  RobustRegistrationSolver solver(solver_params);
+
+  std::unique_ptr<Frame> frame;
+  while (waitPop(&graph_queue_, &frame)) {
+    TEASER_TRACE_SCOPE("RegistrationPipeline back stage");
+    if (!frame->done) {
+      solver.solution_ = frame->solution;
+      solver.stats_ = frame->stats;
+      solver.sample_indices_ = std::move(frame->sample_indices);
+      std::swap(solver.inlier_graph_, frame->inlier_graph);
+      frame->solution = solver.solveFromInlierGraph(frame->problem.src, frame->problem.dst);
+      frame->stats = solver.stats_;
+      if (frame->solution.valid) {
+        frame->inliers = solver.translation_inliers_;
+      }
+    }
+    if (!waitPush(&output_queue_, std::move(frame))) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,283 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "teaser/planar_registration.h"
+
+#include <cmath>
+#include <limits>
+
+#include "teaser/utils.h"
+#include "teaser/macros.h"
+
+Eigen::Matrix<double, 2, Eigen::Dynamic>
+teaser::PlanarRegistrationSolver::computeTIMs(const Eigen::Matrix<double, 2, Eigen::Dynamic>& v,
+                                              Eigen::Matrix<int, 2, Eigen::Dynamic>* map) {
+  auto N = v.cols();
+  Eigen::Matrix<double, 2, Eigen::Dynamic> vtilde(2, N * (N - 1) / 2);
+  if (map) {
+    map->resize(2, N * (N - 1) / 2);
+  }
+
+#pragma omp parallel for default(none) shared(N, v, vtilde, map)
+  for (Eigen::Index i = 0; i < N - 1; i++) {
+    // See RobustRegistrationSolver::computeTIMs for the layout of the TIMs
+    Eigen::Index segment_start_idx = i * N - i * (i + 1) / 2;
+    Eigen::Index segment_cols = N - 1 - i;
+    for (Eigen::Index j = 0; j < segment_cols; ++j) {
+      vtilde.col(segment_start_idx + j) = v.col(i + 1 + j) - v.col(i);
+      if (map) {
+        (*map)(0, segment_start_idx + j) = i;
+        (*map)(1, segment_start_idx + j) = i + 1 + j;
+      }
+    }
+  }
+
+  return vtilde;
+}
+
+teaser::PlanarRegistrationSolution
+teaser::PlanarRegistrationSolver::solve(const Eigen::Matrix<double, 2, Eigen::Dynamic>& src,
+                                        const Eigen::Matrix<double, 2, Eigen::Dynamic>& dst) {
+  assert(src.cols() == dst.cols());
+  solution_.cancelled = false;
+
+  // Handle deprecated params
+  INLIER_SELECTION_MODE inlier_selection_mode = params_.inlier_selection_mode;
+  if (!params_.use_max_clique) {
+    inlier_selection_mode = INLIER_SELECTION_MODE::NONE;
+  }
+  if (!params_.max_clique_exact_solution) {
+    inlier_selection_mode = INLIER_SELECTION_MODE::PMC_HEU;
+  }
+
+  // Estimate scale from TIMs. The TIM maps of src and dst are identical, so only one is computed.
+  src_tims_ = computeTIMs(src, &tims_map_);
+  dst_tims_ = computeTIMs(dst, nullptr);
+  TEASER_DEBUG_INFO_MSG("Starting planar scale solver.");
+  solveForScale(src_tims_, dst_tims_);
+  TEASER_DEBUG_INFO_MSG("Planar scale estimation complete.");
+  if (stopIfCancelled()) {
+    return solution_;
+  }
+
+  // Calculate Maximum Clique
+  if (inlier_selection_mode != INLIER_SELECTION_MODE::NONE) {
+    inlier_graph_ = teaser::Graph();
+    inlier_graph_.populateVertices(src.cols());
+    // Each TIM maps to a distinct pair of vertices, so edges can't be duplicated
+    for (Eigen::Index i = 0; i < scale_inliers_mask_.cols(); ++i) {
+      if (scale_inliers_mask_(0, i)) {
+        inlier_graph_.addEdgeUnchecked(tims_map_(0, i), tims_map_(1, i));
+      }
+    }
+
+    teaser::MaxCliqueSolver::Params clique_params;
+    if (inlier_selection_mode == INLIER_SELECTION_MODE::PMC_EXACT) {
+      clique_params.solver_mode = teaser::MaxCliqueSolver::CLIQUE_SOLVER_MODE::PMC_EXACT;
+    } else if (inlier_selection_mode == INLIER_SELECTION_MODE::PMC_HEU) {
+      clique_params.solver_mode = teaser::MaxCliqueSolver::CLIQUE_SOLVER_MODE::PMC_HEU;
+    } else {
+      clique_params.solver_mode = teaser::MaxCliqueSolver::CLIQUE_SOLVER_MODE::KCORE_HEU;
+    }
+    clique_params.time_limit = params_.max_clique_time_limit;
+    clique_params.kcore_heuristic_threshold = params_.kcore_heuristic_threshold;
+    clique_params.num_threads = params_.max_clique_num_threads;
+    clique_params.cancellation_token = params_.cancellation_token;
+    clique_params.dense_graph_threshold = params_.dense_graph_threshold;
+    clique_params.dense_graph_max_cover_size = params_.dense_graph_max_cover_size;
+
+    teaser::MaxCliqueSolver clique_solver(clique_params);
+    max_clique_ = clique_solver.findMaxClique(inlier_graph_);
+    std::sort(max_clique_.begin(), max_clique_.end());
+    if (stopIfCancelled()) {
+      return solution_;
+    }
+
+    // Abort if max clique size <= 1
+    if (max_clique_.size() <= 1) {
+      TEASER_DEBUG_INFO_MSG("Clique size too small. Abort.");
+      solution_.valid = false;
+      return solution_;
+    }
+  } else {
+    max_clique_.resize(src.cols());
+    for (Eigen::Index i = 0; i < src.cols(); ++i) {
+      max_clique_[i] = i;
+    }
+  }
+
+  // TIMs between consecutive max clique members for rotation estimation
+  Eigen::Matrix<double, 2, Eigen::Dynamic> pruned_src_tims(2, max_clique_.size());
+  Eigen::Matrix<double, 2, Eigen::Dynamic> pruned_dst_tims(2, max_clique_.size());
+  for (size_t i = 0; i < max_clique_.size(); ++i) {
+    const auto& root = max_clique_[i];
+    const auto& leaf = max_clique_[(i + 1) % max_clique_.size()];
+    pruned_src_tims.col(i) = src.col(leaf) - src.col(root);
+    pruned_dst_tims.col(i) = dst.col(leaf) - dst.col(root);
+  }
+
+  // Remove scaling for rotation estimation
+  pruned_dst_tims *= (1 / solution_.scale);
+
+  TEASER_DEBUG_INFO_MSG("Starting planar rotation solver.");
+  solveForRotation(pruned_src_tims, pruned_dst_tims);
+  TEASER_DEBUG_INFO_MSG("Planar rotation estimation complete.");
+  if (stopIfCancelled()) {
+    return solution_;
+  }
+
+  rotation_inliers_ = utils::maskVector<int>(rotation_inliers_mask_, max_clique_);
+  Eigen::Matrix<double, 2, Eigen::Dynamic> rotation_pruned_src(2, rotation_inliers_.size());
+  Eigen::Matrix<double, 2, Eigen::Dynamic> rotation_pruned_dst(2, rotation_inliers_.size());
+  for (size_t i = 0; i < rotation_inliers_.size(); ++i) {
+    rotation_pruned_src.col(i) = src.col(rotation_inliers_[i]);
+    rotation_pruned_dst.col(i) = dst.col(rotation_inliers_[i]);
+  }
+
+  TEASER_DEBUG_INFO_MSG("Starting planar translation solver.");
+  solveForTranslation(solution_.scale * solution_.rotation * rotation_pruned_src,
+                      rotation_pruned_dst);
+  TEASER_DEBUG_INFO_MSG("Planar translation estimation complete.");
+
+  translation_inliers_ = utils::maskVector<int>(translation_inliers_mask_, rotation_inliers_);
+  if (stopIfCancelled()) {
+    return solution_;
+  }
+
+  solution_.valid = true;
+  return solution_;
+}
+
+double teaser::PlanarRegistrationSolver::solveForScale(
+    const Eigen::Matrix<double, 2, Eigen::Dynamic>& v1,
+    const Eigen::Matrix<double, 2, Eigen::Dynamic>& v2) {
+  Eigen::Matrix<double, 1, Eigen::Dynamic> v1_dist = v1.colwise().norm();
+  Eigen::Matrix<double, 1, Eigen::Dynamic> v2_dist = v2.colwise().norm();
+  double beta = 2 * params_.noise_bound * sqrt(params_.cbar2);
+  scale_inliers_mask_.resize(1, v1.cols());
+
+  if (params_.estimate_scaling) {
+    Eigen::Matrix<double, 1, Eigen::Dynamic> raw_scales = v2_dist.array() / v1_dist.array();
+    Eigen::Matrix<double, 1, Eigen::Dynamic> alphas = beta * v1_dist.cwiseInverse();
+    tls_estimator_.estimate(raw_scales, alphas, &(solution_.scale), &scale_inliers_mask_,
+                            params_.cancellation_token.get());
+  } else {
+    // Same test as ScaleInliersSelector: |v2| / |v1| and |v1| / |v2| have to be within
+    // beta / |v1| and beta / |v2| of 1 respectively, both of which reduce to ||v2| - |v1|| <= beta
+    solution_.scale = 1;
+    scale_inliers_mask_ = (v2_dist - v1_dist).array().abs() <= beta;
+  }
+  return solution_.scale;
+}
+
+Eigen::Matrix2d teaser::PlanarRegistrationSolver::solveForRotation(
+    const Eigen::Matrix<double, 2, Eigen::Dynamic>& v1,
+    const Eigen::Matrix<double, 2, Eigen::Dynamic>& v2) {
+  assert(v1.cols() == v2.cols());
+  assert(params_.rotation_gnc_factor > 1);
+
+  // GNC-TLS as in GNCTLSRotationSolver. The noise bound on TIMs is twice the noise bound on
+  // measurements, after removing the scale.
+  size_t match_size = v1.cols();
+  double noise_bound_sq = std::pow(2 * params_.noise_bound / solution_.scale, 2);
+  if (noise_bound_sq < 1e-16) {
+    noise_bound_sq = 1e-2;
+  }
+
+  // The weighted 2D Procrustes problem has a closed form solution:
+  // theta = atan2(sum w * (v1 x v2), sum w * (v1 . v2))
+  Eigen::Matrix<double, 1, Eigen::Dynamic> dots = v1.cwiseProduct(v2).colwise().sum();
+  Eigen::Matrix<double, 1, Eigen::Dynamic> crosses =
+      v1.row(0).cwiseProduct(v2.row(1)) - v1.row(1).cwiseProduct(v2.row(0));
+  Eigen::Matrix<double, 1, Eigen::Dynamic> sq_norms =
+      v1.colwise().squaredNorm() + v2.colwise().squaredNorm();
+
+  Eigen::Matrix<double, 1, Eigen::Dynamic> weights(1, match_size);
+  weights.setOnes();
+  Eigen::Matrix<double, 1, Eigen::Dynamic> residuals_sq(1, match_size);
+
+  double mu = 1;
+  double prev_cost = std::numeric_limits<double>::infinity();
+  rotation_cost_ = std::numeric_limits<double>::infinity();
+  double theta = 0;
+  for (size_t i = 0; i < params_.rotation_max_iterations; ++i) {
+    if (i > 0 && isCancelled(params_.cancellation_token)) {
+      TEASER_DEBUG_INFO_MSG("Planar GNC-TLS solver cancelled.");
+      break;
+    }
+    theta = std::atan2(weights.dot(crosses), weights.dot(dots));
+    residuals_sq = sq_norms - 2 * (std::cos(theta) * dots + std::sin(theta) * crosses);
+
+    if (i == 0) {
+      double max_residual = residuals_sq.maxCoeff();
+      mu = 1 / (2 * max_residual / noise_bound_sq - 1);
+      if (mu <= 0) {
+        TEASER_DEBUG_INFO_MSG(
+            "GNC-TLS terminated because maximum residual at initialization is very small.");
+        break;
+      }
+    }
+
+    double th1 = (mu + 1) / mu * noise_bound_sq;
+    double th2 = mu / (mu + 1) * noise_bound_sq;
+    rotation_cost_ = 0;
+    for (size_t j = 0; j < match_size; ++j) {
+      rotation_cost_ += weights(j) * residuals_sq(j);
+      if (residuals_sq(j) >= th1) {
+        weights(j) = 0;
+      } else if (residuals_sq(j) <= th2) {
+        weights(j) = 1;
+      } else {
+        weights(j) = sqrt(noise_bound_sq * mu * (mu + 1) / residuals_sq(j)) - mu;
+      }
+    }
+
+    double cost_diff = std::abs(rotation_cost_ - prev_cost);
+    mu = mu * params_.rotation_gnc_factor;
+    prev_cost = rotation_cost_;
+    if (cost_diff < params_.rotation_cost_threshold) {
+      TEASER_DEBUG_INFO_MSG("Planar GNC-TLS solver terminated due to cost convergence.");
+      break;
+    }
+  }
+
+  solution_.rotation << std::cos(theta), -std::sin(theta), std::sin(theta), std::cos(theta);
+  rotation_inliers_mask_ = weights.cast<bool>();
+  return solution_.rotation;
+}
+
+Eigen::Vector2d teaser::PlanarRegistrationSolver::solveForTranslation(
+    const Eigen::Matrix<double, 2, Eigen::Dynamic>& v1,
+    const Eigen::Matrix<double, 2, Eigen::Dynamic>& v2) {
+  assert(v1.cols() == v2.cols());
+  Eigen::Matrix<double, 2, Eigen::Dynamic> raw_translation = v2 - v1;
+
+  int N = v1.cols();
+  double beta = params_.noise_bound * sqrt(params_.cbar2);
+  Eigen::Matrix<double, 1, Eigen::Dynamic> alphas = beta * Eigen::MatrixXd::Ones(1, N);
+
+  // Estimate x and y components of translation: perform TLS on each row
+  translation_inliers_mask_ = Eigen::Matrix<bool, 1, Eigen::Dynamic>::Ones(1, N);
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> inliers_temp(1, N);
+  for (size_t i = 0; i < 2; ++i) {
+    tls_estimator_.estimate(raw_translation.row(i), alphas, &(solution_.translation(i)),
+                            &inliers_temp, params_.cancellation_token.get());
+    translation_inliers_mask_ = translation_inliers_mask_.cwiseProduct(inliers_temp);
+  }
+  return solution_.translation;
+}
+
+bool teaser::PlanarRegistrationSolver::stopIfCancelled() {
+  if (!isCancelled(params_.cancellation_token)) {
+    return false;
+  }
+  TEASER_DEBUG_INFO_MSG("Planar solve cancelled.");
+  solution_.valid = false;
+  solution_.cancelled = true;
+  return true;
+}
@@ -11,6 +11,27 @@
 #include <iostream>
 #include <memory>
 #include <cstring>
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+
+#include <locale.h>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "teaser/ply_io.h"
 #include "tinyply.h"
@@ -23,7 +44,642 @@ struct double3 {
   double x, y, z;
 };
 
+static_assert(sizeof(teaser::PointXYZ) == sizeof(float3), "PointXYZ has to be three packed floats");
+
+namespace {
+
+/**
+ * Property of a PLY element
+ */
+struct PLYProperty {
+  std::string name;
+  std::string type;
+  bool is_list = false;
+};
+
+/**
+ * Element of a PLY file, e.g., vertex or face
+ */
+struct PLYElement {
+  std::string name;
+  size_t count = 0;
+  std::vector<PLYProperty> properties;
+};
+
+/**
+ * @return size in bytes of a PLY scalar type, 0 for unknown types
+ */
+size_t plyTypeSize(const std::string& type) {
+  if (type == "char" || type == "int8" || type == "uchar" || type == "uint8") {
+    return 1;
+  }
+  if (type == "short" || type == "int16" || type == "ushort" || type == "uint16") {
+    return 2;
+  }
+  if (type == "int" || type == "int32" || type == "uint" || type == "uint32" || type == "float" ||
+      type == "float32") {
+    return 4;
+  }
+  if (type == "double" || type == "float64") {
+    return 8;
+  }
+  return 0;
+}
+
+/**
+ * @return size in bytes of a PLY floating point type, 0 for other types
+ */
+size_t plyFloatTypeSize(const std::string& type) {
+  if (type == "float" || type == "float32") {
+    return 4;
+  }
+  if (type == "double" || type == "float64") {
+    return 8;
+  }
+  return 0;
+}
+
+/**
+ * Parse the header of a PLY file and locate the vertex positions
+ * @param data contents of the file
+ * @param size size of the file
+ * @param layout [out] layout of the vertex positions
+ * @param error [out] reason of the failure
+ * @return true on success
+ */
+bool parsePLYHeader(const uint8_t* data, size_t size, teaser::PLYVertexLayout* layout,
+                    std::string* error) {
+  using Format = teaser::PLYVertexLayout::Format;
+  std::vector<PLYElement> elements;
+  bool has_format = false;
+  size_t line_start = 0;
+  bool first_line = true;
+  while (true) {
+    const auto* begin = reinterpret_cast<const char*>(data) + line_start;
+    const auto* end = static_cast<const char*>(std::memchr(begin, '\n', size - line_start));
+    if (!end) {
+      *error = "Missing end_header";
+      return false;
+    }
+    line_start += end - begin + 1;
+    std::istringstream line(std::string(begin, end));
+    std::string keyword;
+    line >> keyword;
+
+    if (first_line) {
+      if (keyword != "ply") {
+        *error = "Not a PLY file";
+        return false;
+      }
+      first_line = false;
+    } else if (keyword == "format") {
+      std::string format;
+      line >> format;
+      if (format == "ascii") {
+        layout->format = Format::ASCII;
+      } else if (format == "binary_little_endian") {
+        layout->format = Format::BINARY_LITTLE_ENDIAN;
+      } else if (format == "binary_big_endian") {
+        layout->format = Format::BINARY_BIG_ENDIAN;
+      } else {
+        *error = "Unknown format " + format;
+        return false;
+      }
+      has_format = true;
+    } else if (keyword == "element") {
+      PLYElement element;
+      if (!(line >> element.name >> element.count)) {
+        *error = "Invalid element";
+        return false;
+      }
+      elements.push_back(element);
+    } else if (keyword == "property") {
+      PLYProperty property;
+      line >> property.type;
+      if (property.type == "list") {
+        std::string count_type;
+        property.is_list = true;
+        line >> count_type >> property.type;
+      }
+      line >> property.name;
+      if (elements.empty() || !line || plyTypeSize(property.type) == 0) {
+        *error = "Invalid property " + property.name;
+        return false;
+      }
+      elements.back().properties.push_back(property);
+    } else if (keyword == "end_header") {
+      break;
+    }
+    // Other lines (comment, obj_info) are ignored
+  }
+  layout->header_size = line_start;
+  if (!has_format) {
+    *error = "Missing format";
+    return false;
+  }
+
+  // Vertex element, and offset of its data: the elements before it are skipped by size in binary
+  // formats (they need to have a fixed size), and line by line in the ASCII format
+  const PLYElement* vertex = nullptr;
+  size_t offset = layout->header_size;
+  size_t lines_before_vertices = 0;
+  for (const auto& element : elements) {
+    size_t element_size = 0;
+    bool has_list = false;
+    for (const auto& property : element.properties) {
+      element_size += plyTypeSize(property.type);
+      has_list |= property.is_list;
+    }
+    if (element.name == "vertex") {
+      vertex = &element;
+      layout->stride = has_list ? 0 : element_size;
+      break;
+    }
+    if (has_list && layout->format != Format::ASCII) {
+      *error = "Unsupported variable size element before the vertices";
+      return false;
+    }
+    offset += element.count * element_size;
+    lines_before_vertices += element.count;
+  }
+  if (!vertex) {
+    *error = "Missing vertex element";
+    return false;
+  }
+  if (layout->stride == 0) {
+    *error = "Unsupported variable size vertices";
+    return false;
+  }
+  layout->num_vertices = vertex->count;
+  if (layout->format == Format::ASCII) {
+    offset = layout->header_size;
+    for (size_t l = 0; l < lines_before_vertices; ++l) {
+      const auto* line_end = std::memchr(data + offset, '\n', size - offset);
+      if (!line_end) {
+        *error = "Truncated element data";
+        return false;
+      }
+      offset = static_cast<const uint8_t*>(line_end) - data + 1;
+    }
+  }
+  layout->vertex_data_offset = offset;
+
+  // x, y and z
+  const std::string names[3] = {"x", "y", "z"};
+  size_t* indices[3] = {&(layout->x_index), &(layout->y_index), &(layout->z_index)};
+  size_t* offsets[3] = {&(layout->x_offset), &(layout->y_offset), &(layout->z_offset)};
+  std::string types[3];
+  for (int c = 0; c < 3; ++c) {
+    size_t property_offset = 0;
+    for (size_t p = 0; p < vertex->properties.size(); ++p) {
+      const auto& property = vertex->properties[p];
+      if (property.name == names[c]) {
+        *indices[c] = p;
+        *offsets[c] = property_offset;
+        types[c] = property.type;
+        break;
+      }
+      property_offset += plyTypeSize(property.type);
+    }
+    if (types[c].empty()) {
+      *error = "Missing vertex property " + names[c];
+      return false;
+    }
+  }
+  if (layout->format == Format::ASCII) {
+    // Any numeric type can be parsed
+    return true;
+  }
+
+  // Binary formats: float or double coordinates at fixed offsets, within the file
+  layout->coordinate_size = plyFloatTypeSize(types[0]);
+  if (layout->coordinate_size == 0 || types[1] != types[0] || types[2] != types[0]) {
+    *error = "Unsupported vertex coordinate types " + types[0] + ", " + types[1] + ", " + types[2];
+    return false;
+  }
+  if (layout->vertex_data_offset > size ||
+      layout->num_vertices > (size - layout->vertex_data_offset) / layout->stride) {
+    *error = "Truncated vertex data";
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @return true if the host is little-endian
+ */
+bool isLittleEndianHost() {
+  const uint16_t one = 1;
+  uint8_t first_byte;
+  std::memcpy(&first_byte, &one, 1);
+  return first_byte == 1;
+}
+
+/**
+ * Load an unaligned coordinate, swapping its bytes if requested
+ */
+template <typename T, bool Swap>
+inline T loadCoordinate(const uint8_t* bytes) {
+  uint8_t value_bytes[sizeof(T)];
+  std::memcpy(value_bytes, bytes, sizeof(T));
+  if (Swap) {
+    std::reverse(value_bytes, value_bytes + sizeof(T));
+  }
+  T value;
+  std::memcpy(&value, value_bytes, sizeof(T));
+  return value;
+}
+
+/**
+ * Strided copy of binary vertices into points
+ */
+template <typename T, bool Swap>
+void copyVertices(const uint8_t* vertices, const teaser::PLYVertexLayout& layout,
+                  teaser::PointXYZ* points) {
+  for (size_t i = 0; i < layout.num_vertices; ++i) {
+    const uint8_t* vertex = vertices + i * layout.stride;
+    points[i] = {static_cast<float>(loadCoordinate<T, Swap>(vertex + layout.x_offset)),
+                 static_cast<float>(loadCoordinate<T, Swap>(vertex + layout.y_offset)),
+                 static_cast<float>(loadCoordinate<T, Swap>(vertex + layout.z_offset))};
+  }
+}
+
+/**
+ * Powers of 10 that are exactly representable as doubles
+ */
+const double EXACT_POWERS_OF_10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                     1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                     1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/**
+ * @return true for the characters separating the values on an ASCII PLY line
+ */
+inline bool isSeparator(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+/**
+ * strtof in the "C" locale, whatever the global locale (e.g., one with a decimal comma)
+ */
+float strtofClassic(const char* str, char** str_end) {
+  // Created once and kept for the lifetime of the process
+#ifdef _WIN32
+  static const _locale_t c_locale = _create_locale(LC_ALL, "C");
+  return _strtof_l(str, str_end, c_locale);
+#else
+  static const locale_t c_locale = newlocale(LC_ALL_MASK, "C", static_cast<locale_t>(0));
+  return strtof_l(str, str_end, c_locale);
+#endif
+}
+
+/**
+ * Parse a decimal number into a float, from_chars-style: it needs no null terminator, ignores the
+ * locale, and gives the same result as strtof in the "C" locale.
+ *
+ * Numbers of up to 19 significant digits with exponents of at most 22 (what point cloud writers
+ * produce) take a fast path: the digits make an exact integer, scaled by an exact power of 10, so
+ * that the double result is correctly rounded. Rounding that double to float is correct as well,
+ * unless it lies exactly halfway between two floats. Other numbers are parsed by strtof_l, in
+ * the "C" locale.
+ *
+ * @param begin first character of the number
+ * @param end end of the input
+ * @param value [out] parsed number
+ * @return pointer past the number, or nullptr if there is no number at begin
+ */
+const char* parseFloat(const char* begin, const char* end, float* value) {
+  const char* p = begin;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+
+  // Significant digits, and the power of 10 they are scaled by
+  uint64_t mantissa = 0;
+  int num_digits = 0;
+  int exponent = 0;
+  bool has_digits = false;
+  for (; p < end && isDigit(*p); ++p) {
+    has_digits = true;
+    if (mantissa != 0 || *p != '0') {
+      if (num_digits++ < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+      } else {
+        ++exponent;
+      }
+    }
+  }
+  if (p < end && *p == '.') {
+    for (++p; p < end && isDigit(*p); ++p) {
+      has_digits = true;
+      if (mantissa != 0 || *p != '0') {
+        if (num_digits++ < 19) {
+          mantissa = mantissa * 10 + (*p - '0');
+          --exponent;
+        }
+      } else {
+        --exponent;
+      }
+    }
+  }
+  if (has_digits && p < end && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    bool negative_exponent = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+      negative_exponent = *q == '-';
+      ++q;
+    }
+    if (q < end && isDigit(*q)) {
+      int explicit_exponent = 0;
+      for (; q < end && isDigit(*q); ++q) {
+        explicit_exponent = std::min(explicit_exponent * 10 + (*q - '0'), 100000);
+      }
+      exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+      p = q;
+    }
+  }
+
+  // Fast path
+  if (has_digits && num_digits <= 19 && mantissa <= (uint64_t(1) << 53) && exponent >= -22 &&
+      exponent <= 22) {
+    double result = static_cast<double>(mantissa);
+    result = exponent < 0 ? result / EXACT_POWERS_OF_10[-exponent]
+                          : result * EXACT_POWERS_OF_10[exponent];
+    uint64_t bits;
+    std::memcpy(&bits, &result, sizeof(bits));
+    const bool halfway = (bits & ((uint64_t(1) << 29) - 1)) == (uint64_t(1) << 28);
+    const bool float_range = result == 0 || (result >= std::numeric_limits<float>::min() &&
+                                             result <= std::numeric_limits<float>::max());
+    if (!halfway && float_range) {
+      *value = static_cast<float>(negative ? -result : result);
+      return p;
+    }
+  }
+
+  // Slow path, on a null-terminated copy of the token
+  const char* token_end = begin;
+  while (token_end < end && !isSeparator(*token_end) && *token_end != '\n') {
+    ++token_end;
+  }
+  const std::string token(begin, token_end);
+  char* parsed_end;
+  *value = strtofClassic(token.c_str(), &parsed_end);
+  if (parsed_end == token.c_str()) {
+    return nullptr;
+  }
+  return begin + (parsed_end - token.c_str());
+}
+
+/**
+ * Parse the coordinates on one vertex line
+ * @param begin start of the line
+ * @param end end of the line
+ * @param coordinates coordinate (0, 1 or 2 for x, y or z) of each leading property, -1 for the
+ * others
+ * @param point [out]
+ * @return true on success
+ */
+bool parseVertexLine(const char* begin, const char* end, const std::vector<int>& coordinates,
+                     teaser::PointXYZ* point) {
+  float values[3];
+  const char* p = begin;
+  for (const auto& coordinate : coordinates) {
+    while (p < end && isSeparator(*p)) {
+      ++p;
+    }
+    if (coordinate >= 0) {
+      p = parseFloat(p, end, &values[coordinate]);
+      if (!p || (p < end && !isSeparator(*p))) {
+        return false;
+      }
+    } else {
+      if (p == end) {
+        return false;
+      }
+      while (p < end && !isSeparator(*p)) {
+        ++p;
+      }
+    }
+  }
+  *point = {values[0], values[1], values[2]};
+  return true;
+}
+
+/**
+ * Parse ASCII vertices in parallel: the text is split in chunks at line boundaries, the lines of
+ * each chunk are counted to find the index of its first vertex, and each chunk is then parsed
+ * straight into the points.
+ * @param begin start of the first vertex line
+ * @param end end of the file
+ * @param layout
+ * @param points [out] layout.num_vertices points
+ * @param error [out] reason of the failure
+ * @return true on success
+ */
+bool parseASCIIVertices(const char* begin, const char* end, const teaser::PLYVertexLayout& layout,
+                        teaser::PointXYZ* points, std::string* error) {
+  // Chunks of at least 64 kB, a few per thread for load balancing
+  size_t size = end - begin;
+  size_t max_num_chunks = 1;
+#ifdef _OPENMP
+  max_num_chunks = 4 * omp_get_max_threads();
+#endif
+  size_t num_chunks = std::max<size_t>(1, std::min(max_num_chunks, size / (1 << 16)));
+
+  // Chunk c holds the lines starting in [chunk_starts[c], chunk_starts[c + 1])
+  std::vector<const char*> chunk_starts(num_chunks + 1, end);
+  chunk_starts[0] = begin;
+#pragma omp parallel for default(none) shared(begin, end, size, num_chunks, chunk_starts)
+  for (size_t c = 1; c < num_chunks; ++c) {
+    const char* nominal_start = begin + c * (size / num_chunks);
+    const auto* newline = static_cast<const char*>(
+        std::memchr(nominal_start - 1, '\n', end - (nominal_start - 1)));
+    chunk_starts[c] = newline ? newline + 1 : end;
+  }
+
+  // Index of the first line of each chunk
+  std::vector<size_t> first_lines(num_chunks + 1, 0);
+#pragma omp parallel for default(none) shared(num_chunks, chunk_starts, first_lines)
+  for (size_t c = 0; c < num_chunks; ++c) {
+    size_t num_newlines = 0;
+#pragma omp simd reduction(+ : num_newlines)
+    for (const char* p = chunk_starts[c]; p < chunk_starts[c + 1]; ++p) {
+      num_newlines += *p == '\n';
+    }
+    first_lines[c + 1] = num_newlines;
+  }
+  std::partial_sum(first_lines.begin(), first_lines.end(), first_lines.begin());
+  const size_t num_lines = first_lines[num_chunks] + (size > 0 && end[-1] != '\n' ? 1 : 0);
+  if (num_lines < layout.num_vertices) {
+    *error = "Truncated vertex data";
+    return false;
+  }
+
+  // Coordinate of each property, up to the last coordinate
+  std::vector<int> coordinates(std::max({layout.x_index, layout.y_index, layout.z_index}) + 1, -1);
+  coordinates[layout.x_index] = 0;
+  coordinates[layout.y_index] = 1;
+  coordinates[layout.z_index] = 2;
+
+  size_t num_vertices = layout.num_vertices;
+  size_t first_invalid_vertex = num_vertices;
+#pragma omp parallel for default(none) schedule(dynamic, 1)                                       \
+    shared(num_chunks, chunk_starts, first_lines, num_vertices, coordinates, points,              \
+           first_invalid_vertex)
+  for (size_t c = 0; c < num_chunks; ++c) {
+    const char* p = chunk_starts[c];
+    const char* chunk_end = chunk_starts[c + 1];
+    for (size_t i = first_lines[c]; i < num_vertices && p < chunk_end; ++i) {
+      const auto* line_end = static_cast<const char*>(std::memchr(p, '\n', chunk_end - p));
+      if (!line_end) {
+        line_end = chunk_end;
+      }
+      if (!parseVertexLine(p, line_end, coordinates, points + i)) {
+#pragma omp critical
+        first_invalid_vertex = std::min(first_invalid_vertex, i);
+        break;
+      }
+      p = line_end + 1;
+    }
+  }
+  if (first_invalid_vertex < num_vertices) {
+    *error = "Invalid vertex " + std::to_string(first_invalid_vertex);
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int teaser::MappedPLYFile::open(const std::string& file_name) {
+  close();
+  error_.clear();
+#ifdef _WIN32
+  // No mmap: read the whole file at once
+  std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+  if (!file) {
+    error_ = "Failed to open " + file_name;
+    return -1;
+  }
+  buffer_.resize(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(buffer_.data()), buffer_.size());
+  data_ = buffer_.data();
+  size_ = buffer_.size();
+#else
+  int fd = ::open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error_ = "Failed to open " + file_name;
+    return -1;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    ::close(fd);
+    error_ = "Failed to read " + file_name;
+    return -1;
+  }
+  size_ = file_stat.st_size;
+  int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+  // Fault the whole file in at once, rather than page by page while reading the vertices
+  flags |= MAP_POPULATE;
+#endif
+  void* address = mmap(nullptr, size_, PROT_READ, flags, fd, 0);
+  ::close(fd);
+  if (address == MAP_FAILED) {
+    size_ = 0;
+    error_ = "Failed to map " + file_name;
+    return -1;
+  }
+  madvise(address, size_, MADV_SEQUENTIAL);
+  data_ = static_cast<const uint8_t*>(address);
+  mapped_ = true;
+#endif
+
+  if (!parsePLYHeader(data_, size_, &layout_, &error_)) {
+    error_ = file_name + ": " + error_;
+    close();
+    return -1;
+  }
+  return 0;
+}
+
+void teaser::MappedPLYFile::close() {
+#ifndef _WIN32
+  if (mapped_) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+#endif
+  mapped_ = false;
+  buffer_ = std::vector<uint8_t>();
+  data_ = nullptr;
+  size_ = 0;
+  layout_ = PLYVertexLayout();
+}
+
+const teaser::PointXYZ* teaser::MappedPLYFile::points() const {
+  const auto native_format = isLittleEndianHost() ? PLYVertexLayout::Format::BINARY_LITTLE_ENDIAN
+                                                  : PLYVertexLayout::Format::BINARY_BIG_ENDIAN;
+  if (!data_ || layout_.format != native_format || layout_.coordinate_size != sizeof(float) ||
+      layout_.stride != sizeof(PointXYZ) || layout_.x_offset != offsetof(PointXYZ, x) ||
+      layout_.y_offset != offsetof(PointXYZ, y) || layout_.z_offset != offsetof(PointXYZ, z)) {
+    return nullptr;
+  }
+  const uint8_t* vertices = data_ + layout_.vertex_data_offset;
+  if (reinterpret_cast<uintptr_t>(vertices) % alignof(PointXYZ) != 0) {
+    return nullptr;
+  }
+  return reinterpret_cast<const PointXYZ*>(vertices);
+}
+
+int teaser::MappedPLYFile::readVertices(teaser::PointCloud& cloud) {
+  if (!data_) {
+    error_ = "No file open";
+    return -1;
+  }
+
+  const size_t first = cloud.size();
+  cloud.resize(first + layout_.num_vertices);
+  PointXYZ* out = cloud.data() + first;
+  if (layout_.format == PLYVertexLayout::Format::ASCII) {
+    const auto* text = reinterpret_cast<const char*>(data_);
+    if (!parseASCIIVertices(text + layout_.vertex_data_offset, text + size_, layout_, out,
+                            &error_)) {
+      cloud.resize(first);
+      return -1;
+    }
+    return 0;
+  }
+
+  const PointXYZ* view = points();
+  if (view) {
+    std::copy(view, view + layout_.num_vertices, out);
+    return 0;
+  }
+  const uint8_t* vertices = data_ + layout_.vertex_data_offset;
+  const bool swap =
+      (layout_.format == PLYVertexLayout::Format::BINARY_BIG_ENDIAN) == isLittleEndianHost();
+  if (layout_.coordinate_size == sizeof(float) && swap) {
+    copyVertices<float, true>(vertices, layout_, out);
+  } else if (layout_.coordinate_size == sizeof(float)) {
+    copyVertices<float, false>(vertices, layout_, out);
+  } else if (swap) {
+    copyVertices<double, true>(vertices, layout_, out);
+  } else {
+    copyVertices<double, false>(vertices, layout_, out);
+  }
+  return 0;
+}
+
 int teaser::PLYReader::read(const std::string& file_name, teaser::PointCloud& cloud) {
+  // Fast path: binary vertices copied straight out of the mapped file
+  MappedPLYFile mapped_file;
+  if (mapped_file.open(file_name) == 0 && mapped_file.readVertices(cloud) == 0) {
+    std::cout << "\tRead " << mapped_file.numVertices() << " total vertices " << std::endl;
+    return 0;
+  }
+
   std::unique_ptr<std::istream> file_stream;
   std::vector<uint8_t> byte_buffer;
 
@@ -51,6 +707,7 @@ int teaser::PLYReader::read(const std::string& file_name, teaser::PointCloud& cl
 
     if (vertices) {
       std::cout << "\tRead " << vertices->count << " total vertices " << std::endl;
+      cloud.reserve(cloud.size() + vertices->count);
       if (vertices->t == tinyply::Type::FLOAT32) {
         std::vector<float3> verts_floats(vertices->count);
         const size_t numVerticesBytes = vertices->buffer.size_bytes();
@@ -8,19 +8,55 @@
 
 #include "teaser/registration.h"
 
+#include <chrono>
 #include <cmath>
 #include <functional>
 #include <iostream>
 #include <limits>
 #include <iterator>
+#include <numeric>
+#include <random>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "teaser/utils.h"
 #include "teaser/graph.h"
+#include "teaser/kernels.h"
 #include "teaser/macros.h"
+#include "teaser/trace.h"
+
+namespace {
+
+/**
+ * Measure the wall times of consecutive stages
+ */
+class StageTimer {
+public:
+  StageTimer() : start_(std::chrono::steady_clock::now()) {}
+
+  /**
+   * @return time since the end of the previous stage (or construction), in seconds
+   */
+  double lap() {
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - start_).count();
+    start_ = now;
+    return elapsed;
+  }
 
-void teaser::ScalarTLSEstimator::estimate(const Eigen::RowVectorXd& X,
-                                          const Eigen::RowVectorXd& ranges, double* estimate,
-                                          Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
+private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace
+
+void teaser::ScalarTLSEstimator::estimate(const Eigen::Ref<const Eigen::RowVectorXd>& X,
+                                          const Eigen::Ref<const Eigen::RowVectorXd>& ranges,
+                                          double* estimate,
+                                          Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers,
+                                          const CancellationToken* cancellation_token) {
   // check input parameters
   bool dimension_inconsistent = (X.rows() != ranges.rows()) || (X.cols() != ranges.cols());
   if (inliers) {
@@ -32,49 +68,43 @@ void teaser::ScalarTLSEstimator::estimate(const Eigen::RowVectorXd& X,
 
   // Prepare variables for calculations
   int N = X.cols();
-  Eigen::RowVectorXd h(N * 2);
+  auto h = h_.resize(N * 2);
   h << X - ranges, X + ranges;
   // ascending order
   std::sort(h.data(), h.data() + h.cols(), [](double a, double b) { return a < b; });
   // calculate interval centers
-  Eigen::RowVectorXd h_centers = (h.head(h.cols() - 1) + h.tail(h.cols() - 1)) / 2;
+  auto h_centers = h_centers_.resize(h.cols() - 1);
+  h_centers = (h.head(h.cols() - 1) + h.tail(h.cols() - 1)) / 2;
   auto nr_centers = h_centers.cols();
 
   // calculate weights
-  Eigen::RowVectorXd weights = ranges.array().square();
-  weights = weights.array().inverse();
-
-  Eigen::RowVectorXd x_hat = Eigen::MatrixXd::Zero(1, nr_centers);
-  Eigen::RowVectorXd x_cost = Eigen::MatrixXd::Zero(1, nr_centers);
-
-#pragma omp parallel for default(none)                                                             \
-    shared(N, nr_centers, h_centers, X, ranges, weights, x_hat, x_cost)
-  for (size_t i = 0; i < nr_centers; ++i) {
-    double ranges_inverse_sum = 0;
-    double dot_X_weights = 0;
-    double dot_weights_consensus = 0;
-    std::vector<double> X_consensus_vec;
-
-    for (size_t j = 0; j < N; ++j) {
-      // consensus = (abs(X-h_centers(i)) <= ranges);
-      bool consensus = std::abs(X(j) - h_centers(i)) <= ranges(j);
-      if (consensus) {
-        dot_X_weights += X(j) * weights(j);
-        dot_weights_consensus += weights(j);
-        X_consensus_vec.push_back(X(j));
-      } else {
-        ranges_inverse_sum += ranges(j);
-      }
+  auto weights = weights_.resize(N);
+  weights = ranges.array().square().inverse();
+
+  auto x_hat = x_hat_.resize(nr_centers);
+  auto x_cost = x_cost_.resize(nr_centers);
+  x_hat.setZero();
+  x_cost.setZero();
+
+  // For each center: x_hat(i) = dot(X(consensus), weights(consensus)) / dot(weights, consensus)
+  // and x_cost(i) = dot(residual, residual) + sum(ranges(~consensus)), with
+  // consensus = (abs(X - h_centers(i)) <= ranges) and residual = X(consensus) - x_hat(i).
+  // Centers are split in blocks between the threads. Blocks skipped after a cancellation keep an
+  // infinite cost.
+  Eigen::Index block_size = 64;
+  Eigen::Index num_blocks = (nr_centers + block_size - 1) / block_size;
+#pragma omp parallel for default(none) shared(N, nr_centers, block_size, num_blocks, h_centers, X, \
+                                              ranges, weights, x_hat, x_cost, cancellation_token)
+  for (Eigen::Index b = 0; b < num_blocks; ++b) {
+    const Eigen::Index begin = b * block_size;
+    const Eigen::Index count = std::min(block_size, nr_centers - begin);
+    if (cancellation_token && cancellation_token->isCancelled()) {
+      x_cost.segment(begin, count).setConstant(std::numeric_limits<double>::infinity());
+      continue;
     }
-    // x_hat(i) = dot(X(consensus), weights(consensus)) / dot(weights, consensus);
-    x_hat(i) = dot_X_weights / dot_weights_consensus;
-
-    // residual = X(consensus)-x_hat(i);
-    Eigen::Map<Eigen::VectorXd> X_consensus(X_consensus_vec.data(), X_consensus_vec.size());
-    Eigen::VectorXd residual = X_consensus.array() - x_hat(i);
-
-    // x_cost(i) = dot(residual,residual) + sum(ranges(~consensus));
-    x_cost(i) = residual.squaredNorm() + ranges_inverse_sum;
+    teaser::kernels::tlsConsensusSweep(X.data(), ranges.data(), weights.data(), N,
+                                       h_centers.data() + begin, count, x_hat.data() + begin,
+                                       x_cost.data() + begin);
   }
 
   size_t min_idx;
@@ -206,10 +236,9 @@ void teaser::ScalarTLSEstimator::estimate_tiled(const Eigen::RowVectorXd& X,
   }
 }
 
-void teaser::FastGlobalRegistrationSolver::solveForRotation(
-    const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
-    const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst, Eigen::Matrix3d* rotation,
-    Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
+void teaser::FastGlobalRegistrationSolver::solveForRotationView(
+    const teaser::MeasurementsRef& src, const teaser::MeasurementsRef& dst,
+    Eigen::Matrix3d* rotation, Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
   assert(rotation);                 // make sure R is not a nullptr
   assert(src.cols() == dst.cols()); // check dimensions of input data
   assert(params_.gnc_factor > 1);   // make sure mu will decrease
@@ -222,10 +251,11 @@ void teaser::FastGlobalRegistrationSolver::solveForRotation(
   double noise_bound_sq = std::pow(params_.noise_bound, 2);
   size_t match_size = src.cols();
   cost_ = std::numeric_limits<double>::infinity();
+  iterations_ = 0;
 
   // Calculate the initial mu
-  double src_diameter = teaser::utils::calculateDiameter<double, 3>(src);
-  double dest_diameter = teaser::utils::calculateDiameter<double, 3>(dst);
+  double src_diameter = teaser::utils::calculateDiameter(src);
+  double dest_diameter = teaser::utils::calculateDiameter(dst);
   double global_scale = src_diameter > dest_diameter ? src_diameter : dest_diameter;
   global_scale /= noise_bound_sq;
   double mu = std::pow(global_scale, 2) / noise_bound_sq;
@@ -236,31 +266,53 @@ void teaser::FastGlobalRegistrationSolver::solveForRotation(
   Eigen::Matrix<double, 1, Eigen::Dynamic> l_pq(1, match_size);
   l_pq.setOnes(1, match_size);
 
+  // Squared residuals of the current rotation estimate. They are computed once per iteration and
+  // shared by the cost of this iteration and the line process update of the next one.
+  Eigen::Matrix<double, 1, Eigen::Dynamic> residuals_sq = (dst - src).colwise().squaredNorm();
+
+  // Only parallelize the residual computation when there are enough columns to amortize the
+  // OpenMP overhead. The columns are handed to the residual kernel in blocks.
+  const size_t parallel_threshold = 1000;
+  size_t block_size = 256;
+  size_t num_blocks = (match_size + block_size - 1) / block_size;
+
   // Assumptions of the two inputs:
   // they should be of the same scale,
   // outliers should be removed as much as possible
   // input vectors should contain TIM vectors (if only estimating rotation)
   for (size_t i = 0; i < params_.max_iterations; ++i) {
+    TEASER_TRACE_SCOPE("FGR iteration");
+    if (i > 0 && isCancelled(params_.cancellation_token)) {
+      TEASER_DEBUG_INFO_MSG("FGR solver cancelled.");
+      break;
+    }
     double scaled_mu = mu * noise_bound_sq;
 
     // 1. Optimize for line processes weights
-    Eigen::Matrix<double, 3, 1> q, p, rpq;
-    for (size_t j = 0; j < match_size; ++j) {
-      // p = Rq
-      q = src.col(j);
-      p = dst.col(j);
-      rpq = p - (*rotation) * q;
-      l_pq(j) = std::pow(scaled_mu / (scaled_mu + rpq.squaredNorm()), 2);
-    }
+    l_pq = (scaled_mu / (scaled_mu + residuals_sq.array())).square().matrix();
 
     // 2. Optimize for Rotation Matrix
     *rotation = teaser::utils::svdRot(src, dst, l_pq);
 
-    // update cost
-    Eigen::Matrix<double, 3, Eigen::Dynamic> diff = (dst - (*rotation) * src).array().square();
-    cost_ = ((scaled_mu * diff.colwise().sum()).array() /
-             (scaled_mu + diff.colwise().sum().array()).array())
-                .sum();
+    // 3. Update residuals and cost
+    const Eigen::Matrix3d R = *rotation;
+    double cost = 0;
+#pragma omp parallel for if (match_size >= parallel_threshold) default(none)                      \
+    shared(match_size, num_blocks, block_size, src, dst, R, residuals_sq, scaled_mu)              \
+    reduction(+ : cost)
+    for (size_t b = 0; b < num_blocks; ++b) {
+      const size_t begin = b * block_size;
+      const size_t end = std::min(begin + block_size, match_size);
+      teaser::kernels::squaredResiduals(R.data(), src.col(begin).data(), src.outerStride(),
+                                        dst.col(begin).data(), dst.outerStride(), end - begin,
+                                        residuals_sq.data() + begin);
+      for (size_t j = begin; j < end; ++j) {
+        double r = residuals_sq(j);
+        cost += scaled_mu * r / (scaled_mu + r);
+      }
+    }
+    cost_ = cost;
+    iterations_ = i + 1;
 
     // additional termination conditions
     if (cost_ < params_.cost_threshold || mu < min_mu) {
@@ -280,78 +332,137 @@ void teaser::FastGlobalRegistrationSolver::solveForRotation(
   }
 }
 
-void teaser::TLSScaleSolver::solveForScale(const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
-                                           const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst,
-                                           double* scale,
-                                           Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
+void teaser::TLSScaleSolver::solveForScaleView(const teaser::MeasurementsRef& src,
+                                               const teaser::MeasurementsRef& dst, double* scale,
+                                               Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
+
+  auto v1_dist = src_norms_.resize(src.cols());
+  v1_dist = src.colwise().norm();
+  auto v2_dist = dst_norms_.resize(dst.cols());
+  v2_dist = dst.colwise().norm();
 
-  Eigen::Matrix<double, 1, Eigen::Dynamic> v1_dist =
-      src.array().square().colwise().sum().array().sqrt();
-  Eigen::Matrix<double, 1, Eigen::Dynamic> v2_dist =
-      dst.array().square().colwise().sum().array().sqrt();
+  solveForScaleFromNorms(v1_dist, v2_dist, scale, inliers);
+}
 
-  Eigen::Matrix<double, 1, Eigen::Dynamic> raw_scales = v2_dist.array() / v1_dist.array();
+void teaser::TLSScaleSolver::solveForScaleFromNorms(
+    const Eigen::Ref<const Eigen::RowVectorXd>& src_norms,
+    const Eigen::Ref<const Eigen::RowVectorXd>& dst_norms, double* scale,
+    Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
   double beta = 2 * noise_bound_ * sqrt(cbar2_);
-  Eigen::Matrix<double, 1, Eigen::Dynamic> alphas = beta * v1_dist.cwiseInverse();
+  sample_stats_ = SampleStats();
+  const Eigen::Index num_tims = src_norms.cols();
+  if (sample_size_ < 2 || static_cast<size_t>(num_tims) <= sample_size_) {
+    auto raw_scales = raw_scales_.resize(num_tims);
+    raw_scales = dst_norms.array() / src_norms.array();
+    auto alphas = alphas_.resize(num_tims);
+    alphas = beta * src_norms.cwiseInverse();
+    tls_estimator_.estimate(raw_scales, alphas, scale, inliers, cancellation_token_.get());
+    return;
+  }
 
-  tls_estimator_.estimate(raw_scales, alphas, scale, inliers);
+  // Estimate on a random subsample of the TIMs, drawn with a fixed seed
+  std::vector<int> indices(num_tims);
+  std::iota(indices.begin(), indices.end(), 0);
+  std::mt19937 rng(0);
+  indices = utils::randomSample(std::move(indices), sample_size_, rng);
+  auto raw_scales = raw_scales_.resize(sample_size_);
+  auto alphas = alphas_.resize(sample_size_);
+  for (size_t i = 0; i < sample_size_; ++i) {
+    raw_scales(i) = dst_norms(indices[i]) / src_norms(indices[i]);
+    alphas(i) = beta / src_norms(indices[i]);
+  }
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> sample_inliers(1, sample_size_);
+  tls_estimator_.estimate(raw_scales, alphas, scale, &sample_inliers, cancellation_token_.get());
+
+  // Classify all TIMs: |dst / src - scale| <= beta / src, without the divisions
+  *inliers = (dst_norms - *scale * src_norms).array().abs() <= beta;
+
+  // Standard error of the estimate, as a weighted mean (with weights 1 / alpha^2) of the raw
+  // scales of the subsample inliers
+  double sum_weights = 0;
+  double sum_weighted_squared_residuals = 0;
+  for (size_t i = 0; i < sample_size_; ++i) {
+    if (sample_inliers(i)) {
+      const double weight = 1 / (alphas(i) * alphas(i));
+      const double residual = raw_scales(i) - *scale;
+      sum_weights += weight;
+      sum_weighted_squared_residuals += weight * weight * residual * residual;
+    }
+  }
+  sample_stats_.sample_size = sample_size_;
+  sample_stats_.standard_error = sum_weights > 0
+                                     ? std::sqrt(sum_weighted_squared_residuals) / sum_weights
+                                     : std::numeric_limits<double>::infinity();
+  sample_stats_.sample_inlier_ratio =
+      static_cast<double>(sample_inliers.count()) / static_cast<double>(sample_size_);
+  sample_stats_.inlier_ratio =
+      static_cast<double>(inliers->count()) / static_cast<double>(num_tims);
 }
 
-void teaser::ScaleInliersSelector::solveForScale(
-    const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
-    const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst, double* scale,
+void teaser::ScaleInliersSelector::solveForScaleView(
+    const teaser::MeasurementsRef& src, const teaser::MeasurementsRef& dst, double* scale,
     Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
   // We assume no scale difference between the two vectors of points.
   *scale = 1;
+  selectInliers(src, dst, &mask_);
 
-  Eigen::Matrix<double, 1, Eigen::Dynamic> v1_dist =
-      src.array().square().colwise().sum().array().sqrt();
-  Eigen::Matrix<double, 1, Eigen::Dynamic> v2_dist =
-      dst.array().square().colwise().sum().array().sqrt();
-  double beta = 2 * noise_bound_ * sqrt(cbar2_);
-
-  // A pair-wise correspondence is an inlier if it passes the following two tests:
-  // 1. dst / src is within maximum allowed error
-  // 2. src / dst is within maximum allowed error
-  Eigen::Matrix<double, 1, Eigen::Dynamic> alphas_forward = beta * v1_dist.cwiseInverse();
-  Eigen::Matrix<double, 1, Eigen::Dynamic> raw_scales_forward = v2_dist.array() / v1_dist.array();
-  Eigen::Matrix<bool, 1, Eigen::Dynamic> inliers_forward =
-      (raw_scales_forward.array() - *scale).array().abs() <= alphas_forward.array();
-
-  Eigen::Matrix<double, 1, Eigen::Dynamic> alphas_reverse = beta * v2_dist.cwiseInverse();
-  Eigen::Matrix<double, 1, Eigen::Dynamic> raw_scales_reverse = v1_dist.array() / v2_dist.array();
-  Eigen::Matrix<bool, 1, Eigen::Dynamic> inliers_reverse =
-      (raw_scales_reverse.array() - *scale).array().abs() <= alphas_reverse.array();
+  Eigen::Index num_measurements = src.cols();
+  inliers->resize(1, num_measurements);
+#pragma omp parallel for default(none) shared(num_measurements, inliers)
+  for (Eigen::Index i = 0; i < num_measurements; ++i) {
+    (*inliers)(i) = (mask_[i / 64] >> (i % 64)) & 1;
+  }
+}
 
-  // element-wise AND using component-wise product (Eigen 3.2 compatible)
-  *inliers = inliers_forward.cwiseProduct(inliers_reverse);
+void teaser::ScaleInliersSelector::selectInliers(const teaser::MeasurementsRef& src,
+                                                 const teaser::MeasurementsRef& dst,
+                                                 std::vector<uint64_t>* mask) const {
+  assert(src.cols() == dst.cols());
+  assert(src.outerStride() == dst.outerStride());
+  // A pair-wise correspondence is an inlier if dst / src and src / dst are both within the maximum
+  // allowed error, i.e., |dst / src - 1| <= beta / src and |src / dst - 1| <= beta / dst. Both
+  // reduce to |dst - src| <= beta, which the kernel checks on the squared norms.
+  const double beta = 2 * noise_bound_ * sqrt(cbar2_);
+  mask->resize(kernels::numMaskWords(src.cols()));
+  kernels::scaleInliersMask(src.data(), dst.data(), src.outerStride(), src.cols(), beta,
+                            mask->data());
 }
 
-void teaser::TLSTranslationSolver::solveForTranslation(
-    const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
-    const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst, Eigen::Vector3d* translation,
+void teaser::ScaleInliersSelector::solveForScaleFromNorms(
+    const Eigen::Ref<const Eigen::RowVectorXd>& src_norms,
+    const Eigen::Ref<const Eigen::RowVectorXd>& dst_norms, double* scale,
     Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
+  // Same test as solveForScale(), see selectInliers()
+  *scale = 1;
+  assert(src_norms.cols() == dst_norms.cols());
+  double beta = 2 * noise_bound_ * sqrt(cbar2_);
+  *inliers = (dst_norms - src_norms).array().abs() <= beta;
+}
+
+void teaser::TLSTranslationSolver::solveForTranslationView(
+    const teaser::MeasurementsRef& src, const teaser::MeasurementsRef& dst,
+    Eigen::Vector3d* translation, Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
   assert(src.cols() == dst.cols());
   if (inliers) {
     assert(inliers->cols() == src.cols());
   }
 
-  // Raw translation
-  Eigen::Matrix<double, 3, Eigen::Dynamic> raw_translation = dst - src;
-
   // Error bounds for each measurements
   int N = src.cols();
   double beta = noise_bound_ * sqrt(cbar2_);
-  Eigen::Matrix<double, 1, Eigen::Dynamic> alphas = beta * Eigen::MatrixXd::Ones(1, N);
-
-  // Estimate x, y, and z component of translation: perform TLS on each row
-  *inliers = Eigen::Matrix<bool, 1, Eigen::Dynamic>::Ones(1, N);
-  Eigen::Matrix<bool, 1, Eigen::Dynamic> inliers_temp(1, N);
-  for (size_t i = 0; i < raw_translation.rows(); ++i) {
-    tls_estimator_.estimate(raw_translation.row(i), alphas, &((*translation)(i)), &inliers_temp);
-    // element-wise AND using component-wise product (Eigen 3.2 compatible)
+  auto alphas = alphas_.resize(N);
+  alphas.setConstant(beta);
+
+  // Estimate x, y, and z component of translation: perform TLS on each row of the raw translations
+  inliers->setOnes(1, N);
+  auto raw_translation = raw_translation_.resize(N);
+  for (Eigen::Index i = 0; i < 3; ++i) {
+    raw_translation = dst.row(i) - src.row(i);
+    double& estimate = (*translation)(i);
+    tls_estimator_.estimate(raw_translation, alphas, &estimate, nullptr);
     // a point is an inlier iff. x,y,z are all inliers
-    *inliers = (*inliers).cwiseProduct(inliers_temp);
+    inliers->array() =
+        inliers->array() && ((raw_translation.array() - estimate).abs() <= alphas.array());
   }
 }
 
@@ -363,75 +474,163 @@ teaser::RobustRegistrationSolver::RobustRegistrationSolver(
 Eigen::Matrix<double, 3, Eigen::Dynamic>
 teaser::RobustRegistrationSolver::computeTIMs(const Eigen::Matrix<double, 3, Eigen::Dynamic>& v,
                                               Eigen::Matrix<int, 2, Eigen::Dynamic>* map) {
-
   auto N = v.cols();
   Eigen::Matrix<double, 3, Eigen::Dynamic> vtilde(3, N * (N - 1) / 2);
   map->resize(2, N * (N - 1) / 2);
+  writeTIMs(v, vtilde);
+  writeTIMsMap(N, *map);
+  return vtilde;
+}
 
-#pragma omp parallel for default(none) shared(N, v, vtilde, map)
-  for (size_t i = 0; i < N - 1; i++) {
-    // Calculate some important indices
-    // For each measurement, we compute the TIMs between itself and all the measurements after it.
-    // For example:
-    // i=0: add N-1 TIMs
-    // i=1: add N-2 TIMs
-    // etc..
-    // i=k: add N-1-k TIMs
-    // And by arithmatic series, we can get the starting index of each segment be:
-    // k*N - k*(k+1)/2
-    size_t segment_start_idx = i * N - i * (i + 1) / 2;
-    size_t segment_cols = N - 1 - i;
+void teaser::RobustRegistrationSolver::writeTIMs(
+    const teaser::MeasurementsRef& v, Eigen::Ref<Eigen::Matrix<double, 3, Eigen::Dynamic>> tims,
+    const teaser::CancellationToken* cancellation_token) {
+  Eigen::Index N = v.cols();
+  assert(tims.cols() == N * (N - 1) / 2);
+
+#pragma omp parallel default(none) shared(N, v, tims, cancellation_token)
+  {
+    TEASER_TRACE_SCOPE("TIMs worker");
+#pragma omp for
+    for (Eigen::Index i = 0; i < N - 1; i++) {
+      // Skip the remaining rows once cancelled (an OpenMP loop cannot be exited early)
+      if (cancellation_token && cancellation_token->isCancelled()) {
+        continue;
+      }
 
-    // calculate TIM
-    Eigen::Matrix<double, 3, 1> m = v.col(i);
-    Eigen::Matrix<double, 3, Eigen::Dynamic> temp = v - m * Eigen::MatrixXd::Ones(1, N);
+      // Calculate some important indices
+      // For each measurement, we compute the TIMs between itself and all the measurements after
+      // it. For example:
+      // i=0: add N-1 TIMs
+      // i=1: add N-2 TIMs
+      // etc..
+      // i=k: add N-1-k TIMs
+      // And by arithmatic series, we can get the starting index of each segment be:
+      // k*N - k*(k+1)/2
+      Eigen::Index segment_start_idx = i * N - i * (i + 1) / 2;
+      Eigen::Index segment_cols = N - 1 - i;
+
+      // TIMs between measurement i and all the measurements after it
+      teaser::kernels::timSegment(v.col(i + 1).data(), v.outerStride(), segment_cols,
+                                  v.col(i).data(), tims.col(segment_start_idx).data(),
+                                  tims.outerStride());
+    }
+  }
+}
+
+void teaser::RobustRegistrationSolver::writeTIMsMap(
+    Eigen::Index num_measurements, Eigen::Ref<Eigen::Matrix<int, 2, Eigen::Dynamic>> map) {
+  Eigen::Index N = num_measurements;
+  assert(map.cols() == N * (N - 1) / 2);
+
+#pragma omp parallel for default(none) shared(N, map)
+  for (Eigen::Index i = 0; i < N - 1; i++) {
+    // Same layout as the TIMs, see writeTIMs()
+    Eigen::Index segment_start_idx = i * N - i * (i + 1) / 2;
+    for (Eigen::Index j = i + 1; j < N; ++j) {
+      map(0, segment_start_idx + j - i - 1) = i;
+      map(1, segment_start_idx + j - i - 1) = j;
+    }
+  }
+}
 
-    // concatenate to the end of the tilde vector
-    vtilde.middleCols(segment_start_idx, segment_cols) = temp.rightCols(segment_cols);
+void teaser::RobustRegistrationSolver::writeTIMNorms(
+    const teaser::MeasurementsRef& v, Eigen::Ref<Eigen::Matrix<double, 1, Eigen::Dynamic>> norms,
+    const teaser::CancellationToken* cancellation_token) {
+  Eigen::Index N = v.cols();
+  assert(norms.cols() == N * (N - 1) / 2);
 
-    // populate the index map
-    Eigen::Matrix<int, 2, Eigen::Dynamic> map_addition(2, N);
-    for (size_t j = 0; j < N; ++j) {
-      map_addition(0, j) = i;
-      map_addition(1, j) = j;
+#pragma omp parallel for default(none) shared(N, v, norms, cancellation_token)
+  for (Eigen::Index i = 0; i < N - 1; i++) {
+    if (cancellation_token && cancellation_token->isCancelled()) {
+      continue;
     }
-    map->middleCols(segment_start_idx, segment_cols) = map_addition.rightCols(segment_cols);
+    // Same layout as the TIMs, see writeTIMs()
+    Eigen::Index segment_start_idx = i * N - i * (i + 1) / 2;
+    Eigen::Index segment_cols = N - 1 - i;
+    norms.segment(segment_start_idx, segment_cols) =
+        (v.rightCols(segment_cols).colwise() - v.col(i)).colwise().norm();
   }
+}
 
-  return vtilde;
+void teaser::RobustRegistrationSolver::computeWorkspaceTIMs(const teaser::MeasurementsRef& src,
+                                                            const teaser::MeasurementsRef& dst) {
+  TEASER_TRACE_SCOPE("TIMs");
+  assert(src.cols() == dst.cols());
+  const Eigen::Index N = src.cols();
+  const Eigen::Index num_tims = N * (N - 1) / 2;
+
+  auto src_tims = workspace_.src_tims.resize(num_tims);
+  auto dst_tims = workspace_.dst_tims.resize(num_tims);
+  writeTIMs(src, src_tims, params_.cancellation_token.get());
+  writeTIMs(dst, dst_tims, params_.cancellation_token.get());
+
+  // The map only depends on N, and num_tims is strictly increasing in N for N >= 1
+  if (workspace_.tims_map.cols() != num_tims) {
+    auto tims_map = workspace_.tims_map.resize(num_tims);
+    writeTIMsMap(N, tims_map);
+  }
 }
 
 teaser::RegistrationSolution
 teaser::RobustRegistrationSolver::solve(const teaser::PointCloud& src_cloud,
                                         const teaser::PointCloud& dst_cloud,
-                                        const std::vector<std::pair<int, int>> correspondences) {
-  Eigen::Matrix<double, 3, Eigen::Dynamic> src(3, correspondences.size());
-  Eigen::Matrix<double, 3, Eigen::Dynamic> dst(3, correspondences.size());
-  for (size_t i = 0; i < correspondences.size(); ++i) {
-    auto src_idx = std::get<0>(correspondences[i]);
-    auto dst_idx = std::get<1>(correspondences[i]);
-    src.col(i) << src_cloud[src_idx].x, src_cloud[src_idx].y, src_cloud[src_idx].z;
-    dst.col(i) << dst_cloud[dst_idx].x, dst_cloud[dst_idx].y, dst_cloud[dst_idx].z;
+                                        const std::vector<std::pair<int, int>>& correspondences) {
+  // Gather the corresponding points directly into the reused measurement buffers
+  const Eigen::Index N = correspondences.size();
+  auto src = workspace_.src.resize(N);
+  auto dst = workspace_.dst.resize(N);
+  for (Eigen::Index i = 0; i < N; ++i) {
+    const auto& src_point = src_cloud[correspondences[i].first];
+    const auto& dst_point = dst_cloud[correspondences[i].second];
+    src.col(i) << src_point.x, src_point.y, src_point.z;
+    dst.col(i) << dst_point.x, dst_point.y, dst_point.z;
+  }
+  return solve(src, dst);
+}
+
+teaser::RegistrationSolution teaser::RobustRegistrationSolver::solve(
+    const teaser::PointsRef& src_points, const teaser::PointsRef& dst_points,
+    const teaser::IndicesRef& src_indices, const teaser::IndicesRef& dst_indices) {
+  assert(src_indices.size() == dst_indices.size());
+
+  // Gather the corresponding points directly into the reused measurement buffers
+  const Eigen::Index N = src_indices.size();
+  auto src = workspace_.src.resize(N);
+  auto dst = workspace_.dst.resize(N);
+  for (Eigen::Index i = 0; i < N; ++i) {
+    assert(src_indices(i) >= 0 && src_indices(i) < src_points.cols());
+    assert(dst_indices(i) >= 0 && dst_indices(i) < dst_points.cols());
+    src.col(i) = src_points.col(src_indices(i)).cast<double>();
+    dst.col(i) = dst_points.col(dst_indices(i)).cast<double>();
   }
   return solve(src, dst);
 }
 
 teaser::RegistrationSolution
-teaser::RobustRegistrationSolver::solve(const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
-                                        const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst) {
-  assert(scale_solver_ && rotation_solver_ && translation_solver_);
+teaser::RobustRegistrationSolver::solve(const float* src_points, const float* dst_points,
+                                        size_t point_stride, const int* src_indices,
+                                        const int* dst_indices, size_t num_correspondences) {
+  assert(point_stride >= 3);
+  Eigen::Map<const Eigen::VectorXi> src_indices_map(src_indices, num_correspondences);
+  Eigen::Map<const Eigen::VectorXi> dst_indices_map(dst_indices, num_correspondences);
+
+  // Only the indexed points are read, so the maps just need to cover the largest index
+  using PointsMap =
+      Eigen::Map<const Eigen::Matrix<float, 3, Eigen::Dynamic>, 0, Eigen::OuterStride<>>;
+  const Eigen::Index num_src_points =
+      num_correspondences > 0 ? src_indices_map.maxCoeff() + 1 : 0;
+  const Eigen::Index num_dst_points =
+      num_correspondences > 0 ? dst_indices_map.maxCoeff() + 1 : 0;
+  PointsMap src_points_map(src_points, 3, num_src_points, Eigen::OuterStride<>(point_stride));
+  PointsMap dst_points_map(dst_points, 3, num_dst_points, Eigen::OuterStride<>(point_stride));
+  return solve(src_points_map, dst_points_map, src_indices_map, dst_indices_map);
+}
 
-  // Handle deprecated params
-  if (!params_.use_max_clique) {
-    TEASER_DEBUG_INFO_MSG(
-        "Using deprecated param field use_max_clique. Switch to inlier_selection_mode instead.");
-    params_.inlier_selection_mode = INLIER_SELECTION_MODE::NONE;
-  }
-  if (!params_.max_clique_exact_solution) {
-    TEASER_DEBUG_INFO_MSG("Using deprecated param field max_clique_exact_solution. Switch to "
-                          "inlier_selection_mode instead.");
-    params_.inlier_selection_mode = INLIER_SELECTION_MODE::PMC_HEU;
-  }
+teaser::RegistrationSolution
+teaser::RobustRegistrationSolver::solve(const teaser::MeasurementsRef& src,
+                                        const teaser::MeasurementsRef& dst) {
+  assert(scale_solver_ && rotation_solver_ && translation_solver_);
 
   /**
    * Steps to estimate T/R/s
@@ -447,42 +646,77 @@ teaser::RobustRegistrationSolver::solve(const Eigen::Matrix<double, 3, Eigen::Dy
    *
    * Estimate Translation
    */
-  src_tims_ = computeTIMs(src, &src_tims_map_);
-  dst_tims_ = computeTIMs(dst, &dst_tims_map_);
+  TEASER_TRACE_SCOPE("RobustRegistrationSolver::solve");
+  stats_ = RegistrationStats();
+  if (!solveInlierGraph(src, dst)) {
+    return solution_;
+  }
+  return solveFromInlierGraph(src, dst);
+}
+
+bool teaser::RobustRegistrationSolver::solveInlierGraph(const teaser::MeasurementsRef& src,
+                                                        const teaser::MeasurementsRef& dst) {
+  StageTimer timer;
+  stats_.num_measurements = src.cols();
+  solution_.cancelled = false;
+
+  // For large problems, the TIM-based stages only see a sample of the measurements
+  sample_indices_.clear();
+  if (getInlierSelectionMode() != INLIER_SELECTION_MODE::NONE &&
+      params_.inlier_graph_sample_size > 1 &&
+      static_cast<size_t>(src.cols()) > params_.inlier_graph_sample_size) {
+    sampleMeasurements(src, dst);
+    computeWorkspaceTIMs(workspace_.sample_src.view(), workspace_.sample_dst.view());
+  } else {
+    computeWorkspaceTIMs(src, dst);
+  }
+  stats_.num_tims = workspace_.src_tims.cols();
+  stats_.tims_time = timer.lap();
+  if (stopIfCancelled(RegistrationSolution::STAGE::TIMS)) {
+    return false;
+  }
+
   TEASER_DEBUG_INFO_MSG("Starting scale solver.");
-  solveForScale(src_tims_, dst_tims_);
+  solveForScale(workspace_.src_tims.view(), workspace_.dst_tims.view());
+  stats_.scale_time = timer.lap();
   TEASER_DEBUG_INFO_MSG("Scale estimation complete.");
+  if (stopIfCancelled(RegistrationSolution::STAGE::SCALE)) {
+    return false;
+  }
 
-  // Calculate Maximum Clique
-  // Note: the max_clique_ vector holds the indices of original measurements that are within the
-  // max clique of the built inlier graph.
-  if (params_.inlier_selection_mode != INLIER_SELECTION_MODE::NONE) {
-
-    // Create inlier graph: A graph with (indices of) original measurements as vertices, and edges
-    // only when the TIM between two measurements are inliers. Note: src_tims_map_ is the same as
-    // dst_tim_map_
-    inlier_graph_.populateVertices(src.cols());
-    for (size_t i = 0; i < scale_inliers_mask_.cols(); ++i) {
-      if (scale_inliers_mask_(0, i)) {
-        inlier_graph_.addEdge(src_tims_map_(0, i), src_tims_map_(1, i));
-      }
+  // Create inlier graph
+  if (getInlierSelectionMode() != INLIER_SELECTION_MODE::NONE) {
+    buildInlierGraph(sample_indices_.empty() ? src.cols() : sample_indices_.size());
+    stats_.graph_time = timer.lap();
+    if (stopIfCancelled(RegistrationSolution::STAGE::INLIER_GRAPH)) {
+      return false;
     }
+  }
+  return true;
+}
 
-    teaser::MaxCliqueSolver::Params clique_params;
+teaser::RegistrationSolution
+teaser::RobustRegistrationSolver::solveFromInlierGraph(const teaser::MeasurementsRef& src,
+                                                       const teaser::MeasurementsRef& dst) {
+  StageTimer timer;
 
-    if (params_.inlier_selection_mode == INLIER_SELECTION_MODE::PMC_EXACT) {
-      clique_params.solver_mode = teaser::MaxCliqueSolver::CLIQUE_SOLVER_MODE::PMC_EXACT;
-    } else if (params_.inlier_selection_mode == INLIER_SELECTION_MODE::PMC_HEU) {
-      clique_params.solver_mode = teaser::MaxCliqueSolver::CLIQUE_SOLVER_MODE::PMC_HEU;
-    } else {
-      clique_params.solver_mode = teaser::MaxCliqueSolver::CLIQUE_SOLVER_MODE::KCORE_HEU;
+  // Calculate Maximum Clique
+  // Note: the max_clique_ vector holds the indices of original measurements that are within the
+  // max clique of the built inlier graph.
+  if (getInlierSelectionMode() != INLIER_SELECTION_MODE::NONE) {
+    clique_solver_.setParams(getMaxCliqueSolverParams());
+    clique_solver_.findMaxClique(inlier_graph_, warm_start_clique_, &max_clique_);
+    warm_start_clique_.clear();
+    if (!sample_indices_.empty() && max_clique_.size() > 1) {
+      verifySampledClique(src, dst);
     }
-    clique_params.time_limit = params_.max_clique_time_limit;
-    clique_params.kcore_heuristic_threshold = params_.kcore_heuristic_threshold;
-
-    teaser::MaxCliqueSolver clique_solver(clique_params);
-    max_clique_ = clique_solver.findMaxClique(inlier_graph_);
     std::sort(max_clique_.begin(), max_clique_.end());
+    stats_.max_core = clique_solver_.getMaxCoreAtTermination();
+    stats_.clique_size = max_clique_.size();
+    stats_.clique_time = timer.lap();
+    if (stopIfCancelled(RegistrationSolution::STAGE::MAX_CLIQUE)) {
+      return solution_;
+    }
     TEASER_DEBUG_INFO_MSG("Max Clique of scale estimation inliers: ");
 #ifndef NDEBUG
     std::copy(max_clique_.begin(), max_clique_.end(), std::ostream_iterator<int>(std::cout, " "));
@@ -492,118 +726,662 @@ teaser::RobustRegistrationSolver::solve(const Eigen::Matrix<double, 3, Eigen::Dy
     if (max_clique_.size() <= 1) {
       TEASER_DEBUG_INFO_MSG("Clique size too small. Abort.");
       solution_.valid = false;
+      solution_.stage = RegistrationSolution::STAGE::MAX_CLIQUE;
       return solution_;
     }
 
-    // Calculate new measurements & TIMs based on max clique inliers
-    Eigen::Matrix<double, 3, Eigen::Dynamic> pruned_src(3, max_clique_.size());
-    Eigen::Matrix<double, 3, Eigen::Dynamic> pruned_dst(3, max_clique_.size());
-    pruned_src_tims_.resize(3, max_clique_.size());
-    pruned_dst_tims_.resize(3, max_clique_.size());
-    for (size_t i = 0; i < max_clique_.size(); ++i) {
-      const auto& root = max_clique_[i];
-      int leaf;
-      if (i != max_clique_.size() - 1) {
-        leaf = max_clique_[i + 1];
-      } else {
-        leaf = max_clique_[0];
-      }
-      pruned_src.col(i) = src.col(root);
-      pruned_dst.col(i) = dst.col(root);
-      pruned_src_tims_.col(i) = src.col(leaf) - src.col(root);
-      pruned_dst_tims_.col(i) = dst.col(leaf) - dst.col(root);
-    }
-
   } else {
-    max_clique_.reserve(src.cols());
-    pruned_src_tims_.resize(3, src.cols());
-    pruned_dst_tims_.resize(3, dst.cols());
+    max_clique_.resize(src.cols());
     for (size_t i = 0; i < src.cols(); ++i) {
-      const auto& root = i;
-      int leaf;
-      if (i != src.cols() - 1) {
-        leaf = i + 1;
-      } else {
-        leaf = 0;
-      }
-      pruned_src_tims_.col(i) = src.col(leaf) - src.col(root);
-      pruned_dst_tims_.col(i) = dst.col(leaf) - dst.col(root);
-      max_clique_.push_back(i);
+      max_clique_[i] = i;
     }
+    stats_.clique_size = max_clique_.size();
+  }
+
+  // Calculate new TIMs based on max clique inliers
+  auto pruned_src_tims = workspace_.pruned_src_tims.resize(max_clique_.size());
+  auto pruned_dst_tims = workspace_.pruned_dst_tims.resize(max_clique_.size());
+  for (size_t i = 0; i < max_clique_.size(); ++i) {
+    const auto& root = max_clique_[i];
+    int leaf;
+    if (i != max_clique_.size() - 1) {
+      leaf = max_clique_[i + 1];
+    } else {
+      leaf = max_clique_[0];
+    }
+    pruned_src_tims.col(i) = src.col(leaf) - src.col(root);
+    pruned_dst_tims.col(i) = dst.col(leaf) - dst.col(root);
   }
 
   // Remove scaling for rotation estimation
-  pruned_dst_tims_ *= (1 / solution_.scale);
+  pruned_dst_tims *= (1 / solution_.scale);
 
-  // Update GNC rotation solver's noise bound with the new information
-  // Note: this implicitly assume that rotation_solver_'s noise bound
-  // is set to the original noise bound of the measurements.
+  // Update GNC rotation solver's noise bound with the new information, starting from the noise
+  // bound the rotation solver was set with (so that it does not compound across solves)
   auto params = rotation_solver_->getParams();
-  params.noise_bound *= (2 / solution_.scale);
+  params.noise_bound = rotation_noise_bound_ * (2 / solution_.scale);
+  params.cancellation_token = params_.cancellation_token;
   rotation_solver_->setParams(params);
 
   // Solve for rotation
   TEASER_DEBUG_INFO_MSG("Starting rotation solver.");
-  solveForRotation(pruned_src_tims_, pruned_dst_tims_);
+  solveForRotation(pruned_src_tims, pruned_dst_tims);
+  stats_.rotation_iterations = rotation_solver_->getIterationsAtTermination();
+  stats_.rotation_time = timer.lap();
   TEASER_DEBUG_INFO_MSG("Rotation estimation complete.");
+  if (stopIfCancelled(RegistrationSolution::STAGE::ROTATION)) {
+    return solution_;
+  }
 
   // TODO: Pruning based on the weight vectors from the rotation solver.
   // Create a inlier vector and pass it to the solveForRotation function
   // The size of the rotation inlier vector is the same as the size of max clique / pruned_src/dst
   // where 0 indicates that the corresponding node in max clique is determined to be an outlier,
   // and 1 otherwise.
-  rotation_inliers_ = utils::maskVector<int>(rotation_inliers_mask_, max_clique_);
-  Eigen::Matrix<double, 3, Eigen::Dynamic> rotation_pruned_src(3, rotation_inliers_.size());
-  Eigen::Matrix<double, 3, Eigen::Dynamic> rotation_pruned_dst(3, rotation_inliers_.size());
+  utils::maskVector(rotation_inliers_mask_, max_clique_, &rotation_inliers_);
+  auto translation_src = workspace_.translation_src.resize(rotation_inliers_.size());
+  auto translation_dst = workspace_.translation_dst.resize(rotation_inliers_.size());
+  const Eigen::Matrix3d sR = solution_.scale * solution_.rotation;
   for (size_t i = 0; i < rotation_inliers_.size(); ++i) {
-    rotation_pruned_src.col(i) = src.col(rotation_inliers_[i]);
-    rotation_pruned_dst.col(i) = dst.col(rotation_inliers_[i]);
+    translation_src.col(i) = sR * src.col(rotation_inliers_[i]);
+    translation_dst.col(i) = dst.col(rotation_inliers_[i]);
   }
 
   // Solve for translation
   TEASER_DEBUG_INFO_MSG("Starting translation solver.");
-  solveForTranslation(solution_.scale * solution_.rotation * rotation_pruned_src,
-                      rotation_pruned_dst);
+  solveForTranslation(translation_src, translation_dst);
   TEASER_DEBUG_INFO_MSG("Translation estimation complete.");
 
   // Find the final inliers
-  translation_inliers_ = utils::maskVector<int>(translation_inliers_mask_, rotation_inliers_);
+  utils::maskVector(translation_inliers_mask_, rotation_inliers_, &translation_inliers_);
+  stats_.num_rotation_inliers = rotation_inliers_.size();
+  stats_.num_translation_inliers = translation_inliers_.size();
+  stats_.translation_time = timer.lap();
 
   // Update validity flag
   solution_.valid = true;
+  solution_.stage = RegistrationSolution::STAGE::DONE;
 
   return solution_;
 }
 
-double teaser::RobustRegistrationSolver::solveForScale(
-    const Eigen::Matrix<double, 3, Eigen::Dynamic>& v1,
-    const Eigen::Matrix<double, 3, Eigen::Dynamic>& v2) {
+teaser::PreparedSource
+teaser::RobustRegistrationSolver::prepareSource(const teaser::MeasurementsRef& src) {
+  PreparedSource source;
+  source.measurements = src;
+  const Eigen::Index N = src.cols();
+  source.tim_norms.resize(1, N * (N - 1) / 2);
+  writeTIMNorms(src, source.tim_norms);
+  return source;
+}
+
+teaser::RegistrationSolution
+teaser::RobustRegistrationSolver::solve(const teaser::PreparedSource& source,
+                                        const teaser::MeasurementsRef& dst) {
+  assert(source.measurements.cols() == dst.cols());
+  assert(source.tim_norms.cols() == dst.cols() * (dst.cols() - 1) / 2);
+
+  TEASER_TRACE_SCOPE("RobustRegistrationSolver::solve");
+  StageTimer timer;
+  stats_ = RegistrationStats();
+  stats_.num_measurements = dst.cols();
+  solution_.cancelled = false;
+  sample_indices_.clear();
+
+  // Only the dst side of the TIM stage is computed; the TIMs map only depends on N
+  {
+    TEASER_TRACE_SCOPE("TIMs");
+    const Eigen::Index N = dst.cols();
+    const Eigen::Index num_tims = N * (N - 1) / 2;
+    auto dst_tim_norms = workspace_.dst_tim_norms.resize(num_tims);
+    writeTIMNorms(dst, dst_tim_norms, params_.cancellation_token.get());
+    if (workspace_.tims_map.cols() != num_tims) {
+      auto tims_map = workspace_.tims_map.resize(num_tims);
+      writeTIMsMap(N, tims_map);
+    }
+    stats_.num_tims = num_tims;
+  }
+  stats_.tims_time = timer.lap();
+  if (stopIfCancelled(RegistrationSolution::STAGE::TIMS)) {
+    return solution_;
+  }
+
+  {
+    TEASER_TRACE_SCOPE("Scale");
+    const auto dst_tim_norms = workspace_.dst_tim_norms.view();
+    scale_inliers_mask_.resize(1, dst_tim_norms.cols());
+    if (params_.estimate_scaling) {
+      TLSScaleSolver scale_solver(params_.noise_bound, params_.cbar2,
+                                  params_.scale_estimation_sample_size, params_.cancellation_token);
+      scale_solver.solveForScaleFromNorms(source.tim_norms, dst_tim_norms, &(solution_.scale),
+                                          &scale_inliers_mask_);
+      setScaleSampleStats(scale_solver.getSampleStats());
+    } else {
+      ScaleInliersSelector scale_solver(params_.noise_bound, params_.cbar2);
+      scale_solver.solveForScaleFromNorms(source.tim_norms, dst_tim_norms, &(solution_.scale),
+                                          &scale_inliers_mask_);
+    }
+  }
+  stats_.scale_time = timer.lap();
+  if (stopIfCancelled(RegistrationSolution::STAGE::SCALE)) {
+    return solution_;
+  }
+
+  if (getInlierSelectionMode() != INLIER_SELECTION_MODE::NONE) {
+    buildInlierGraph(dst.cols());
+    stats_.graph_time = timer.lap();
+    if (stopIfCancelled(RegistrationSolution::STAGE::INLIER_GRAPH)) {
+      return solution_;
+    }
+  }
+  return solveFromInlierGraph(source.measurements, dst);
+}
+
+teaser::RegistrationSolution
+teaser::RobustRegistrationSolver::solve(const teaser::MeasurementsRef& src,
+                                        const teaser::MeasurementsRef& dst,
+                                        teaser::RegistrationContext* context) const {
+  assert(context);
+  // Only the params are shared; the solvers are recreated from them, which costs a few small
+  // allocations, while the buffers of the context are kept
+  context->solver_.reset(params_);
+  return context->solver_.solve(src, dst);
+}
+
+std::vector<teaser::RegistrationHypothesis> teaser::RobustRegistrationSolver::solveMultiHypothesis(
+    const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
+    const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst, size_t num_hypotheses) {
+  assert(scale_solver_);
+  assert(src.cols() == dst.cols());
+
+  // TIMs, scale and the inlier graph are shared by all hypotheses
+  TEASER_TRACE_SCOPE("RobustRegistrationSolver::solveMultiHypothesis");
+  StageTimer timer;
+  stats_ = RegistrationStats();
+  stats_.num_measurements = src.cols();
+  solution_.cancelled = false;
+  computeWorkspaceTIMs(src, dst);
+  stats_.num_tims = workspace_.src_tims.cols();
+  stats_.tims_time = timer.lap();
+  if (stopIfCancelled(RegistrationSolution::STAGE::TIMS)) {
+    return {};
+  }
+  solveForScale(workspace_.src_tims.view(), workspace_.dst_tims.view());
+  stats_.scale_time = timer.lap();
+  if (stopIfCancelled(RegistrationSolution::STAGE::SCALE)) {
+    return {};
+  }
+
+  std::vector<RegistrationHypothesis> hypotheses;
+  if (getInlierSelectionMode() != INLIER_SELECTION_MODE::NONE) {
+    buildInlierGraph(src.cols());
+    stats_.graph_time = timer.lap();
+    if (stopIfCancelled(RegistrationSolution::STAGE::INLIER_GRAPH)) {
+      return {};
+    }
+    clique_solver_.setParams(getMaxCliqueSolverParams());
+    auto cliques = clique_solver_.findMaxCliques(inlier_graph_, num_hypotheses);
+    stats_.max_core = clique_solver_.getMaxCoreAtTermination();
+    stats_.clique_size = cliques.empty() ? 0 : cliques[0].size();
+    stats_.clique_time = timer.lap();
+    if (stopIfCancelled(RegistrationSolution::STAGE::MAX_CLIQUE)) {
+      return {};
+    }
+    hypotheses.resize(cliques.size());
+    for (size_t h = 0; h < cliques.size(); ++h) {
+      hypotheses[h].clique = std::move(cliques[h]);
+      std::sort(hypotheses[h].clique.begin(), hypotheses[h].clique.end());
+    }
+  } else if (num_hypotheses > 0 && src.cols() > 1) {
+    hypotheses.resize(1);
+    hypotheses[0].clique.resize(src.cols());
+    for (size_t i = 0; i < src.cols(); ++i) {
+      hypotheses[0].clique[i] = i;
+    }
+  }
+  TEASER_DEBUG_INFO_MSG("Number of hypotheses: " << hypotheses.size());
+
+  // Each hypothesis gets its own solvers so that they can be run concurrently
+  double scale = solution_.scale;
+  std::vector<std::unique_ptr<GNCRotationSolver>> rotation_solvers;
+  for (size_t h = 0; h < hypotheses.size(); ++h) {
+    rotation_solvers.push_back(makeRotationSolver(params_.noise_bound * 2 / scale));
+  }
+
+#pragma omp parallel for default(none) shared(hypotheses, rotation_solvers, src, dst, scale)
+  for (size_t h = 0; h < hypotheses.size(); ++h) {
+    TLSTranslationSolver translation_solver(params_.noise_bound, params_.cbar2);
+    solveHypothesis(src, dst, scale, rotation_solvers[h].get(), &translation_solver,
+                    &hypotheses[h]);
+  }
+  if (stopIfCancelled(RegistrationSolution::STAGE::ROTATION)) {
+    return {};
+  }
+
+  // Rank by number of final inliers, then by rotation cost
+  std::stable_sort(hypotheses.begin(), hypotheses.end(),
+                   [](const RegistrationHypothesis& a, const RegistrationHypothesis& b) {
+                     if (a.translation_inliers.size() != b.translation_inliers.size()) {
+                       return a.translation_inliers.size() > b.translation_inliers.size();
+                     }
+                     return a.rotation_cost < b.rotation_cost;
+                   });
+
+  // Expose the best hypothesis through the usual getters
+  if (hypotheses.empty()) {
+    solution_.valid = false;
+    solution_.stage = RegistrationSolution::STAGE::MAX_CLIQUE;
+  } else {
+    const auto& best = hypotheses.front();
+    solution_ = best.solution;
+    max_clique_ = best.clique;
+    rotation_inliers_ = best.rotation_inliers;
+    translation_inliers_ = best.translation_inliers;
+  }
+  return hypotheses;
+}
+
+std::vector<teaser::RegistrationHypothesis> teaser::RobustRegistrationSolver::solveNoiseBoundSweep(
+    const teaser::MeasurementsRef& src, const teaser::MeasurementsRef& dst,
+    const std::vector<double>& noise_bounds) {
+  assert(src.cols() == dst.cols());
+
+  // TIMs are computed once for all noise bounds
+  TEASER_TRACE_SCOPE("RobustRegistrationSolver::solveNoiseBoundSweep");
+  StageTimer timer;
+  stats_ = RegistrationStats();
+  stats_.num_measurements = src.cols();
+  solution_.cancelled = false;
+  computeWorkspaceTIMs(src, dst);
+  stats_.num_tims = workspace_.src_tims.cols();
+  stats_.tims_time = timer.lap();
+  if (stopIfCancelled(RegistrationSolution::STAGE::TIMS)) {
+    return {};
+  }
+
+  // Noise bounds are processed in increasing order
+  std::vector<size_t> order(noise_bounds.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&noise_bounds](size_t a, size_t b) {
+    return noise_bounds[a] < noise_bounds[b];
+  });
+  std::vector<RegistrationHypothesis> hypotheses(noise_bounds.size());
+  const INLIER_SELECTION_MODE inlier_selection_mode = getInlierSelectionMode();
+  const auto src_tims = workspace_.src_tims.view();
+  const auto dst_tims = workspace_.dst_tims.view();
+  const auto tims_map = workspace_.tims_map.view();
+  const double beta_factor = 2 * std::sqrt(params_.cbar2);
+
+  // Without scale estimation, the TIM between two measurements is a scale inlier iff the
+  // difference of the TIM norms is at most 2 * noise_bound * sqrt(cbar2), so the inlier graphs of
+  // increasing noise bounds are nested. Sort the TIMs by the noise bound at which they become
+  // edges, and add them to one graph as the noise bound increases.
+  std::vector<double> edge_bounds;
+  std::vector<Eigen::Index> edge_order;
+  if (!params_.estimate_scaling && inlier_selection_mode != INLIER_SELECTION_MODE::NONE &&
+      !noise_bounds.empty()) {
+    const double max_noise_bound = noise_bounds[order.back()];
+    edge_bounds.resize(src_tims.cols());
+    for (Eigen::Index k = 0; k < src_tims.cols(); ++k) {
+      edge_bounds[k] = std::abs(dst_tims.col(k).norm() - src_tims.col(k).norm()) / beta_factor;
+      if (edge_bounds[k] <= max_noise_bound) {
+        edge_order.push_back(k);
+      }
+    }
+    std::sort(edge_order.begin(), edge_order.end(),
+              [&edge_bounds](Eigen::Index a, Eigen::Index b) {
+                return edge_bounds[a] < edge_bounds[b];
+              });
+  }
+  inlier_graph_.clearEdges();
+  inlier_graph_.populateVertices(src.cols());
+  size_t num_added_edges = 0;
+  std::vector<int> clique;
+  clique_solver_.setParams(getMaxCliqueSolverParams());
+  stats_.graph_time = timer.lap();
+
+  for (const auto& b : order) {
+    auto& hypothesis = hypotheses[b];
+    hypothesis.solution.scale = 1;
+    if (params_.estimate_scaling) {
+      // As in solve(), the scale is estimated with or without inlier selection
+      TLSScaleSolver scale_solver(noise_bounds[b], params_.cbar2,
+                                  params_.scale_estimation_sample_size, params_.cancellation_token);
+      scale_inliers_mask_.resize(1, src_tims.cols());
+      scale_solver.solveForScaleView(src_tims, dst_tims, &(hypothesis.solution.scale),
+                                     &scale_inliers_mask_);
+      stats_.scale_time += timer.lap();
+      if (stopIfCancelled(RegistrationSolution::STAGE::SCALE)) {
+        return {};
+      }
+    }
+    if (inlier_selection_mode == INLIER_SELECTION_MODE::NONE) {
+      hypothesis.clique.resize(src.cols());
+      std::iota(hypothesis.clique.begin(), hypothesis.clique.end(), 0);
+      continue;
+    }
+
+    bool graph_changed = false;
+    if (params_.estimate_scaling) {
+      // The scale estimate depends on the noise bound, so the graphs are not nested: rebuild
+      buildInlierGraph(src.cols());
+      graph_changed = true;
+    } else {
+      while (num_added_edges < edge_order.size() &&
+             edge_bounds[edge_order[num_added_edges]] <= noise_bounds[b]) {
+        const auto k = edge_order[num_added_edges++];
+        inlier_graph_.addEdgeUnchecked(tims_map(0, k), tims_map(1, k));
+        graph_changed = true;
+      }
+    }
+    stats_.graph_time += timer.lap();
+
+    // The clique of the previous noise bound is only recomputed if the graph changed. With nested
+    // graphs, it is still a clique; keep it if the solver (e.g., a heuristic) finds a smaller one.
+    if (graph_changed) {
+      auto new_clique = clique_solver_.findMaxClique(inlier_graph_);
+      std::sort(new_clique.begin(), new_clique.end());
+      if (params_.estimate_scaling || new_clique.size() >= clique.size()) {
+        clique = std::move(new_clique);
+      }
+    }
+    hypothesis.clique = clique;
+    stats_.clique_time += timer.lap();
+    if (stopIfCancelled(RegistrationSolution::STAGE::MAX_CLIQUE)) {
+      return {};
+    }
+  }
+  stats_.num_edges = inlier_graph_.numEdges();
+  stats_.clique_size = clique.size();
+  if (tims_map.cols() > 0) {
+    stats_.graph_density = static_cast<double>(stats_.num_edges) / tims_map.cols();
+  }
+
+  // Rotation and translation of all noise bounds run concurrently, each with its own solvers
+  std::vector<std::unique_ptr<GNCRotationSolver>> rotation_solvers;
+  std::vector<TLSTranslationSolver> translation_solvers;
+  for (size_t b = 0; b < noise_bounds.size(); ++b) {
+    rotation_solvers.push_back(
+        makeRotationSolver(noise_bounds[b] * 2 / hypotheses[b].solution.scale));
+    translation_solvers.emplace_back(noise_bounds[b], params_.cbar2);
+  }
+
+#pragma omp parallel for default(none)                                                             \
+    shared(hypotheses, rotation_solvers, translation_solvers, src, dst)
+  for (size_t b = 0; b < hypotheses.size(); ++b) {
+    auto& hypothesis = hypotheses[b];
+    if (hypothesis.clique.size() <= 1) {
+      hypothesis.solution.valid = false;
+      hypothesis.solution.stage = RegistrationSolution::STAGE::MAX_CLIQUE;
+      continue;
+    }
+    solveHypothesis(src, dst, hypothesis.solution.scale, rotation_solvers[b].get(),
+                    &translation_solvers[b], &hypothesis);
+  }
+  stats_.rotation_time = timer.lap();
+  if (stopIfCancelled(RegistrationSolution::STAGE::ROTATION)) {
+    return {};
+  }
+  return hypotheses;
+}
+
+void teaser::RobustRegistrationSolver::solveHypothesis(
+    const teaser::MeasurementsRef& src, const teaser::MeasurementsRef& dst, double scale,
+    teaser::GNCRotationSolver* rotation_solver, teaser::TLSTranslationSolver* translation_solver,
+    teaser::RegistrationHypothesis* hypothesis) {
+  const auto& clique = hypothesis->clique;
+  hypothesis->solution.scale = scale;
+
+  // TIMs between consecutive clique members, with scaling removed
+  Eigen::Matrix<double, 3, Eigen::Dynamic> pruned_src_tims(3, clique.size());
+  Eigen::Matrix<double, 3, Eigen::Dynamic> pruned_dst_tims(3, clique.size());
+  for (size_t i = 0; i < clique.size(); ++i) {
+    const auto& root = clique[i];
+    const auto& leaf = clique[(i + 1) % clique.size()];
+    pruned_src_tims.col(i) = src.col(leaf) - src.col(root);
+    pruned_dst_tims.col(i) = (dst.col(leaf) - dst.col(root)) / scale;
+  }
+
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> rotation_inliers_mask(1, clique.size());
+  rotation_solver->solveForRotationView(pruned_src_tims, pruned_dst_tims,
+                                        &(hypothesis->solution.rotation), &rotation_inliers_mask);
+  hypothesis->rotation_cost = rotation_solver->getCostAtTermination();
+  hypothesis->rotation_inliers = utils::maskVector<int>(rotation_inliers_mask, clique);
+
+  const auto& rotation_inliers = hypothesis->rotation_inliers;
+  Eigen::Matrix<double, 3, Eigen::Dynamic> rotation_pruned_src(3, rotation_inliers.size());
+  Eigen::Matrix<double, 3, Eigen::Dynamic> rotation_pruned_dst(3, rotation_inliers.size());
+  for (size_t i = 0; i < rotation_inliers.size(); ++i) {
+    rotation_pruned_src.col(i) = src.col(rotation_inliers[i]);
+    rotation_pruned_dst.col(i) = dst.col(rotation_inliers[i]);
+  }
+
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> translation_inliers_mask(1, rotation_inliers.size());
+  translation_solver->solveForTranslationView(
+      scale * hypothesis->solution.rotation * rotation_pruned_src, rotation_pruned_dst,
+      &(hypothesis->solution.translation), &translation_inliers_mask);
+  hypothesis->translation_inliers =
+      utils::maskVector<int>(translation_inliers_mask, rotation_inliers);
+  hypothesis->solution.valid = true;
+}
+
+std::vector<teaser::RegistrationSolution> teaser::RobustRegistrationSolver::solveBatch(
+    const std::vector<RegistrationProblem>& problems) {
+  std::vector<RegistrationSolution> solutions(problems.size());
+
+  std::vector<size_t> small_problems;
+  std::vector<size_t> large_problems;
+  for (size_t i = 0; i < problems.size(); ++i) {
+    assert(problems[i].src.cols() == problems[i].dst.cols());
+    if (static_cast<size_t>(problems[i].src.cols()) >= params_.batch_cooperative_size) {
+      large_problems.push_back(i);
+    } else {
+      small_problems.push_back(i);
+    }
+  }
+
+  // Large problems: one at a time, parallelized within each solve
+  Params params = params_;
+  if (!large_problems.empty()) {
+    RobustRegistrationSolver solver(params);
+    for (const auto& i : large_problems) {
+      solutions[i] = solver.solve(problems[i].src, problems[i].dst);
+    }
+  }
+
+  // Small problems: largest first, handed out one at a time to whichever thread is free, so that
+  // the threads finish at about the same time
+  std::stable_sort(small_problems.begin(), small_problems.end(), [&problems](size_t a, size_t b) {
+    return problems[a].src.cols() > problems[b].src.cols();
+  });
+  params.max_clique_num_threads = 1;
+#pragma omp parallel default(none) shared(params, problems, solutions, small_problems)
+  {
+#ifdef _OPENMP
+    // Nested parallel regions within the solves of this thread only use this thread
+    omp_set_num_threads(1);
+#endif
+    RobustRegistrationSolver solver(params);
+#pragma omp for schedule(dynamic, 1)
+    for (size_t k = 0; k < small_problems.size(); ++k) {
+      const auto& problem = problems[small_problems[k]];
+      solutions[small_problems[k]] = solver.solve(problem.src, problem.dst);
+    }
+  }
+
+  return solutions;
+}
+
+teaser::RobustRegistrationSolver::INLIER_SELECTION_MODE
+teaser::RobustRegistrationSolver::getInlierSelectionMode() const {
+  INLIER_SELECTION_MODE inlier_selection_mode = params_.inlier_selection_mode;
+  if (!params_.use_max_clique) {
+    TEASER_DEBUG_INFO_MSG(
+        "Using deprecated param field use_max_clique. Switch to inlier_selection_mode instead.");
+    inlier_selection_mode = INLIER_SELECTION_MODE::NONE;
+  }
+  if (!params_.max_clique_exact_solution) {
+    TEASER_DEBUG_INFO_MSG("Using deprecated param field max_clique_exact_solution. Switch to "
+                          "inlier_selection_mode instead.");
+    inlier_selection_mode = INLIER_SELECTION_MODE::PMC_HEU;
+  }
+  return inlier_selection_mode;
+}
+
+void teaser::RobustRegistrationSolver::buildInlierGraph(int num_vertices) {
+  TEASER_TRACE_SCOPE("Inlier graph");
+  // Create inlier graph: A graph with (indices of) original measurements as vertices, and edges
+  // only when the TIM between two measurements are inliers. Note: the src and dst TIMs share the
+  // same map. Edges from previous solves are cleared, but the memory of the adjacency lists is
+  // kept.
+  inlier_graph_.clearEdges();
+  inlier_graph_.populateVertices(num_vertices);
+  const auto tims_map = workspace_.tims_map.view();
+  for (size_t i = 0; i < scale_inliers_mask_.cols(); ++i) {
+    // Poll the cancellation token every few thousand TIMs (a few microseconds of work)
+    if (i % 4096 == 0 && isCancelled(params_.cancellation_token)) {
+      return;
+    }
+    // Every pair of measurements appears once in the map, so edges cannot be duplicated
+    if (scale_inliers_mask_(0, i)) {
+      inlier_graph_.addEdgeUnchecked(tims_map(0, i), tims_map(1, i));
+    }
+  }
+
+  stats_.num_edges = inlier_graph_.numEdges();
+  if (tims_map.cols() > 0) {
+    stats_.graph_density = static_cast<double>(stats_.num_edges) / tims_map.cols();
+  }
+}
+
+teaser::MaxCliqueSolver::Params teaser::RobustRegistrationSolver::getMaxCliqueSolverParams() const {
+  teaser::MaxCliqueSolver::Params clique_params;
+  const INLIER_SELECTION_MODE inlier_selection_mode = getInlierSelectionMode();
+  if (inlier_selection_mode == INLIER_SELECTION_MODE::PMC_EXACT) {
+    clique_params.solver_mode = teaser::MaxCliqueSolver::CLIQUE_SOLVER_MODE::PMC_EXACT;
+  } else if (inlier_selection_mode == INLIER_SELECTION_MODE::PMC_HEU) {
+    clique_params.solver_mode = teaser::MaxCliqueSolver::CLIQUE_SOLVER_MODE::PMC_HEU;
+  } else {
+    clique_params.solver_mode = teaser::MaxCliqueSolver::CLIQUE_SOLVER_MODE::KCORE_HEU;
+  }
+  clique_params.time_limit = params_.max_clique_time_limit;
+  clique_params.kcore_heuristic_threshold = params_.kcore_heuristic_threshold;
+  clique_params.num_threads = params_.max_clique_num_threads;
+  clique_params.cancellation_token = params_.cancellation_token;
+  clique_params.dense_graph_threshold = params_.dense_graph_threshold;
+  clique_params.dense_graph_max_cover_size = params_.dense_graph_max_cover_size;
+  return clique_params;
+}
+
+void teaser::RobustRegistrationSolver::sampleMeasurements(const teaser::MeasurementsRef& src,
+                                                          const teaser::MeasurementsRef& dst) {
+  TEASER_TRACE_SCOPE("Sample measurements");
+  std::vector<int> indices(src.cols());
+  std::iota(indices.begin(), indices.end(), 0);
+  std::mt19937 rng(0);
+  sample_indices_ =
+      utils::randomSample(std::move(indices), params_.inlier_graph_sample_size, rng);
+  std::sort(sample_indices_.begin(), sample_indices_.end());
+
+  auto sample_src = workspace_.sample_src.resize(sample_indices_.size());
+  auto sample_dst = workspace_.sample_dst.resize(sample_indices_.size());
+  for (size_t i = 0; i < sample_indices_.size(); ++i) {
+    sample_src.col(i) = src.col(sample_indices_[i]);
+    sample_dst.col(i) = dst.col(sample_indices_[i]);
+  }
+}
+
+void teaser::RobustRegistrationSolver::verifySampledClique(const teaser::MeasurementsRef& src,
+                                                           const teaser::MeasurementsRef& dst) {
+  TEASER_TRACE_SCOPE("Verify sampled clique");
+  std::vector<int> clique(max_clique_.size());
+  for (size_t i = 0; i < max_clique_.size(); ++i) {
+    clique[i] = sample_indices_[max_clique_[i]];
+  }
+
+  // A TIM is a scale inlier iff its dst length is within beta of its scaled src length (see
+  // TLSScaleSolver and ScaleInliersSelector). Measurements of the clique are not verified again.
+  Eigen::Index N = src.cols();
+  double beta = 2 * params_.noise_bound * std::sqrt(params_.cbar2);
+  double scale = solution_.scale;
+  size_t clique_size = clique.size();
+  size_t max_inconsistent =
+      clique_size -
+      static_cast<size_t>(std::ceil(params_.inlier_graph_sample_verification_ratio * clique_size));
+  std::vector<char> admitted(N, 1);
+  for (const auto& i : clique) {
+    admitted[i] = 0;
+  }
+  const CancellationToken* cancellation_token = params_.cancellation_token.get();
+
+#pragma omp parallel for default(none)                                                             \
+    shared(N, src, dst, clique, clique_size, admitted, beta, scale, max_inconsistent,              \
+           cancellation_token)
+  for (Eigen::Index i = 0; i < N; ++i) {
+    if (!admitted[i] || (cancellation_token && cancellation_token->isCancelled())) {
+      admitted[i] = 0;
+      continue;
+    }
+    // Stop as soon as too many clique members are inconsistent
+    size_t inconsistent = 0;
+    for (size_t k = 0; k < clique_size && inconsistent <= max_inconsistent; ++k) {
+      double src_dist = (src.col(clique[k]) - src.col(i)).norm();
+      double dst_dist = (dst.col(clique[k]) - dst.col(i)).norm();
+      inconsistent += std::abs(dst_dist - scale * src_dist) > beta;
+    }
+    admitted[i] = inconsistent <= max_inconsistent;
+  }
+
+  for (Eigen::Index i = 0; i < N; ++i) {
+    if (admitted[i]) {
+      clique.push_back(i);
+    }
+  }
+  max_clique_ = std::move(clique);
+}
+
+bool teaser::RobustRegistrationSolver::stopIfCancelled(RegistrationSolution::STAGE stage) {
+  if (!isCancelled(params_.cancellation_token)) {
+    return false;
+  }
+  TEASER_DEBUG_INFO_MSG("Solve cancelled.");
+  solution_.valid = false;
+  solution_.cancelled = true;
+  solution_.stage = stage;
+  return true;
+}
+
+double teaser::RobustRegistrationSolver::solveForScale(const teaser::MeasurementsRef& v1,
+                                                       const teaser::MeasurementsRef& v2) {
+  TEASER_TRACE_SCOPE("Scale");
   scale_inliers_mask_.resize(1, v1.cols());
-  scale_solver_->solveForScale(v1, v2, &(solution_.scale), &scale_inliers_mask_);
+  scale_solver_->solveForScaleView(v1, v2, &(solution_.scale), &scale_inliers_mask_);
+  if (const auto* tls_solver = dynamic_cast<const TLSScaleSolver*>(scale_solver_.get())) {
+    setScaleSampleStats(tls_solver->getSampleStats());
+  }
   return solution_.scale;
 }
 
 Eigen::Vector3d teaser::RobustRegistrationSolver::solveForTranslation(
-    const Eigen::Matrix<double, 3, Eigen::Dynamic>& v1,
-    const Eigen::Matrix<double, 3, Eigen::Dynamic>& v2) {
+    const teaser::MeasurementsRef& v1, const teaser::MeasurementsRef& v2) {
+  TEASER_TRACE_SCOPE("Translation");
   translation_inliers_mask_.resize(1, v1.cols());
-  translation_solver_->solveForTranslation(v1, v2, &(solution_.translation),
-                                           &translation_inliers_mask_);
+  translation_solver_->solveForTranslationView(v1, v2, &(solution_.translation),
+                                               &translation_inliers_mask_);
   return solution_.translation;
 }
 
 Eigen::Matrix3d teaser::RobustRegistrationSolver::solveForRotation(
-    const Eigen::Matrix<double, 3, Eigen::Dynamic>& v1,
-    const Eigen::Matrix<double, 3, Eigen::Dynamic>& v2) {
+    const teaser::MeasurementsRef& v1, const teaser::MeasurementsRef& v2) {
+  TEASER_TRACE_SCOPE("Rotation");
   rotation_inliers_mask_.resize(1, v1.cols());
-  rotation_solver_->solveForRotation(v1, v2, &(solution_.rotation), &rotation_inliers_mask_);
+  rotation_solver_->solveForRotationView(v1, v2, &(solution_.rotation), &rotation_inliers_mask_);
   return solution_.rotation;
 }
 
-void teaser::GNCTLSRotationSolver::solveForRotation(
-    const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
-    const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst, Eigen::Matrix3d* rotation,
-    Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
+void teaser::GNCTLSRotationSolver::solveForRotationView(
+    const teaser::MeasurementsRef& src, const teaser::MeasurementsRef& dst,
+    Eigen::Matrix3d* rotation, Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
   assert(rotation);                 // make sure R is not a nullptr
   assert(src.cols() == dst.cols()); // check dimensions of input data
   assert(params_.gnc_factor > 1);   // make sure mu will increase
@@ -616,6 +1394,7 @@ void teaser::GNCTLSRotationSolver::solveForRotation(
    * Loop: terminate when:
    *    1. the change in cost in two consecutive runs is smaller than a user-defined threshold
    *    2. # iterations exceeds the maximum allowed
+   *    3. (optional) the binary inlier set and the rotation are stable across iterations
    *
    * Within each loop:
    * 1. fix weights and solve for R
@@ -634,20 +1413,33 @@ void teaser::GNCTLSRotationSolver::solveForRotation(
     noise_bound_sq = 1e-2;
   }
 
-  Eigen::Matrix<double, 3, Eigen::Dynamic> diffs(3, match_size);
-  Eigen::Matrix<double, 1, Eigen::Dynamic> weights(1, match_size);
-  weights.setOnes(1, match_size);
-  Eigen::Matrix<double, 1, Eigen::Dynamic> residuals_sq(1, match_size);
+  auto weights = weights_.resize(match_size);
+  weights.setOnes();
+  auto residuals_sq = residuals_sq_.resize(match_size);
+  iterations_ = 0;
+
+  // Variables for early termination on a stable inlier set
+  auto binary_inliers = binary_inliers_.resize(match_size);
+  auto prev_binary_inliers = prev_binary_inliers_.resize(match_size);
+  Eigen::Matrix3d prev_rotation = Eigen::Matrix3d::Zero();
+  size_t stable_count = 0;
+  bool stable = false;
 
   // Loop for performing GNC-TLS
   for (size_t i = 0; i < params_.max_iterations; ++i) {
+    TEASER_TRACE_SCOPE("GNC-TLS iteration");
+    if (i > 0 && isCancelled(params_.cancellation_token)) {
+      TEASER_DEBUG_INFO_MSG("GNC-TLS solver cancelled.");
+      break;
+    }
+    iterations_ = i + 1;
 
     // Fix weights and perform SVD rotation estimation
     *rotation = teaser::utils::svdRot(src, dst, weights);
 
     // Calculate residuals squared
-    diffs = (dst - (*rotation) * src).array().square();
-    residuals_sq = diffs.colwise().sum();
+    teaser::kernels::squaredResiduals(rotation->data(), src.data(), src.outerStride(), dst.data(),
+                                      dst.outerStride(), match_size, residuals_sq.data());
     if (i == 0) {
       // Initialize rule for mu
       double max_residual = residuals_sq.maxCoeff();
@@ -693,9 +1485,179 @@ void teaser::GNCTLSRotationSolver::solveForRotation(
       TEASER_DEBUG_INFO_MSG("Iterations: " << i);
       break;
     }
+
+    if (params_.stop_on_stable_inliers) {
+      binary_inliers = residuals_sq.array() <= noise_bound_sq;
+      if (i > 0 && binary_inliers == prev_binary_inliers &&
+          (*rotation - prev_rotation).norm() < params_.rotation_delta_threshold) {
+        stable_count++;
+      } else {
+        stable_count = 0;
+      }
+      prev_binary_inliers = binary_inliers;
+      prev_rotation = *rotation;
+
+      if (stable_count >= params_.stable_inliers_iterations) {
+        TEASER_DEBUG_INFO_MSG("GNC-TLS solver terminated due to stable inlier set.");
+        TEASER_DEBUG_INFO_MSG("Iterations: " << i);
+        stable = true;
+        break;
+      }
+    }
   }
 
   if (inliers) {
-    *inliers = weights.cast<bool>();
+    if (stable) {
+      // Weights may not have reached binary values yet, use the stable binary inlier set instead
+      *inliers = binary_inliers;
+    } else {
+      *inliers = weights.cast<bool>();
+    }
+  }
+}
+
+teaser::GravityAlignedYawRotationSolver::GravityAlignedYawRotationSolver(
+    Params params, const Eigen::Vector3d& gravity)
+    : GNCRotationSolver(params) {
+  assert(gravity.norm() > 0); // make sure gravity direction is well defined
+  gravity_ = gravity.normalized();
+  axis_x_ = gravity_.unitOrthogonal();
+  axis_y_ = gravity_.cross(axis_x_);
+}
+
+void teaser::GravityAlignedYawRotationSolver::solveForRotationView(
+    const teaser::MeasurementsRef& src, const teaser::MeasurementsRef& dst,
+    Eigen::Matrix3d* rotation, Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) {
+  assert(rotation);                 // make sure R is not a nullptr
+  assert(src.cols() == dst.cols()); // check dimensions of input data
+  assert(params_.noise_bound != 0); // make sure noise bound is not zero
+  if (inliers) {
+    assert(inliers->cols() == src.cols());
+  }
+
+  /**
+   * With R a rotation of angle theta about gravity, the squared residual of a measurement is
+   *    r(theta) = k - 2 * (c * cos(theta) + s * sin(theta))
+   * where k collects the angle-independent terms, and (c, s) are the dot and cross products of
+   * the projections of src and dst onto the plane perpendicular to gravity. A measurement is an
+   * inlier iff. r(theta) <= noise_bound^2, which holds on a single arc of the circle.
+   *
+   * Within each arc between two consecutive arc endpoints the inlier set is fixed, and the TLS
+   * cost is a sinusoid in theta that can be minimized in closed form.
+   */
+  const double two_pi = 2 * M_PI;
+  auto wrap_angle = [two_pi](double theta) {
+    theta = std::fmod(theta, two_pi);
+    return theta < 0 ? theta + two_pi : theta;
+  };
+
+  size_t match_size = src.cols();
+  double noise_bound_sq = std::pow(params_.noise_bound, 2);
+
+  Eigen::Matrix<double, 1, Eigen::Dynamic> k(1, match_size);
+  Eigen::Matrix<double, 1, Eigen::Dynamic> c(1, match_size);
+  Eigen::Matrix<double, 1, Eigen::Dynamic> s(1, match_size);
+
+  // Sums over measurements that are inliers regardless of the angle
+  double base_k = 0, base_c = 0, base_s = 0;
+  size_t base_count = 0;
+
+  // Arc endpoints: (angle, measurement index, whether the measurement enters the inlier set)
+  std::vector<std::tuple<double, size_t, bool>> events;
+  events.reserve(2 * match_size);
+  std::vector<size_t> contains_zero;
+
+  for (size_t i = 0; i < match_size; ++i) {
+    double src_x = src.col(i).dot(axis_x_), src_y = src.col(i).dot(axis_y_);
+    double dst_x = dst.col(i).dot(axis_x_), dst_y = dst.col(i).dot(axis_y_);
+    double dz = (dst.col(i) - src.col(i)).dot(gravity_);
+    k(i) = dz * dz + src_x * src_x + src_y * src_y + dst_x * dst_x + dst_y * dst_y;
+    c(i) = src_x * dst_x + src_y * dst_y;
+    s(i) = src_x * dst_y - src_y * dst_x;
+
+    double w = std::sqrt(c(i) * c(i) + s(i) * s(i));
+    double kappa = w > 0 ? (k(i) - noise_bound_sq) / (2 * w)
+                         : (k(i) <= noise_bound_sq ? -1 : std::numeric_limits<double>::infinity());
+    if (kappa <= -1) {
+      base_k += k(i);
+      base_c += c(i);
+      base_s += s(i);
+      base_count++;
+    } else if (kappa <= 1) {
+      double phi = std::atan2(s(i), c(i));
+      double delta = std::acos(kappa);
+      double start = wrap_angle(phi - delta);
+      double end = wrap_angle(phi + delta);
+      events.emplace_back(start, i, true);
+      events.emplace_back(end, i, false);
+      if (start > end) {
+        contains_zero.push_back(i);
+      }
+    }
+  }
+
+  // Process entering endpoints first on ties, so that zero-length arcs hold the union
+  std::sort(events.begin(), events.end(), [](const std::tuple<double, size_t, bool>& a,
+                                             const std::tuple<double, size_t, bool>& b) {
+    if (std::get<0>(a) != std::get<0>(b)) {
+      return std::get<0>(a) < std::get<0>(b);
+    }
+    return std::get<2>(a) && !std::get<2>(b);
+  });
+
+  double best_theta = 0;
+  double best_cost = std::numeric_limits<double>::infinity();
+  auto evaluate_arc = [&](double lo, double hi, double sum_k, double sum_c, double sum_s,
+                          size_t count) {
+    auto cost_at = [&](double theta) {
+      return sum_k - 2 * (sum_c * std::cos(theta) + sum_s * std::sin(theta)) +
+             (match_size - count) * noise_bound_sq;
+    };
+    double candidates[3] = {lo, hi, std::atan2(sum_s, sum_c)};
+    size_t num_candidates = wrap_angle(candidates[2] - lo) <= hi - lo ? 3 : 2;
+    for (size_t j = 0; j < num_candidates; ++j) {
+      double cost = cost_at(candidates[j]);
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_theta = candidates[j];
+      }
+    }
+  };
+
+  double sum_k = base_k, sum_c = base_c, sum_s = base_s;
+  size_t count = base_count;
+  for (const auto& i : contains_zero) {
+    sum_k += k(i);
+    sum_c += c(i);
+    sum_s += s(i);
+    count++;
+  }
+
+  if (events.empty()) {
+    evaluate_arc(0, two_pi, sum_k, sum_c, sum_s, count);
+  } else {
+    // The arc wrapping around zero, between the last and the first endpoints
+    evaluate_arc(std::get<0>(events.back()) - two_pi, std::get<0>(events.front()), sum_k, sum_c,
+                 sum_s, count);
+    for (size_t e = 0; e + 1 < events.size(); ++e) {
+      size_t i = std::get<1>(events[e]);
+      double sign = std::get<2>(events[e]) ? 1 : -1;
+      sum_k += sign * k(i);
+      sum_c += sign * c(i);
+      sum_s += sign * s(i);
+      count = std::get<2>(events[e]) ? count + 1 : count - 1;
+      evaluate_arc(std::get<0>(events[e]), std::get<0>(events[e + 1]), sum_k, sum_c, sum_s, count);
+    }
+  }
+
+  yaw_ = wrap_angle(best_theta);
+  cost_ = best_cost;
+  iterations_ = 1;
+  *rotation = Eigen::AngleAxisd(yaw_, gravity_).toRotationMatrix();
+
+  if (inliers) {
+    Eigen::Matrix<double, 1, Eigen::Dynamic> residuals_sq =
+        (k.array() - 2 * (c.array() * std::cos(yaw_) + s.array() * std::sin(yaw_))).matrix();
+    *inliers = residuals_sq.array() <= noise_bound_sq;
   }
 }
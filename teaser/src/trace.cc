@@ -0,0 +1,179 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "teaser/trace.h"
+
+#include <fstream>
+
+#ifdef TEASER_ENABLE_TRACING
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+/**
+ * A complete event: a named interval on one thread
+ */
+struct Event {
+  const char* name;
+  int64_t start_ns;
+  int64_t duration_ns;
+};
+
+/**
+ * Single-producer ring buffer of the events of one thread
+ */
+class ThreadBuffer {
+public:
+  static constexpr size_t CAPACITY = 1 << 16;
+
+  explicit ThreadBuffer(int tid) : tid_(tid), events_(CAPACITY) {}
+
+  void push(const Event& event) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    events_[head % CAPACITY] = event;
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  /**
+   * Number of events ever pushed. Only the last CAPACITY ones are kept.
+   */
+  uint64_t size() const { return head_.load(std::memory_order_acquire); }
+
+  const Event& at(uint64_t i) const { return events_[i % CAPACITY]; }
+
+  void clear() { head_.store(0, std::memory_order_release); }
+
+  int tid() const { return tid_; }
+
+private:
+  int tid_;
+  std::vector<Event> events_;
+  std::atomic<uint64_t> head_{0};
+};
+
+constexpr size_t ThreadBuffer::CAPACITY;
+
+/**
+ * Registry of the buffers of all threads that recorded events
+ */
+class Registry {
+public:
+  static Registry& instance() {
+    static Registry registry;
+    return registry;
+  }
+
+  /**
+   * @return the buffer of the calling thread, registering it on first use
+   */
+  ThreadBuffer& threadBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      buffers_.push_back(std::make_unique<ThreadBuffer>(static_cast<int>(buffers_.size())));
+      buffer = buffers_.back().get();
+    }
+    return *buffer;
+  }
+
+  /**
+   * @return nanoseconds since the registry was created
+   */
+  int64_t now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                epoch_)
+        .count();
+  }
+
+  /**
+   * Write all recorded events as Chrome trace JSON.
+   * @param os
+   */
+  void write(std::ostream& os) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Microseconds with nanosecond resolution, never in scientific notation
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& buffer : buffers_) {
+      os << (first ? "" : ",") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+         << buffer->tid() << ",\"args\":{\"name\":\"thread " << buffer->tid() << "\"}}";
+      first = false;
+
+      uint64_t end = buffer->size();
+      uint64_t begin = end > ThreadBuffer::CAPACITY ? end - ThreadBuffer::CAPACITY : 0;
+      for (uint64_t i = begin; i < end; ++i) {
+        const auto& event = buffer->at(i);
+        os << ",{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+           << buffer->tid() << ",\"ts\":" << event.start_ns / 1000.0
+           << ",\"dur\":" << event.duration_ns / 1000.0 << "}";
+      }
+    }
+    os << "]}" << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+  }
+
+  /**
+   * Drop all recorded events.
+   */
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& buffer : buffers_) {
+      buffer->clear();
+    }
+  }
+
+private:
+  Registry() : epoch_(std::chrono::steady_clock::now()) {}
+
+  std::chrono::steady_clock::time_point epoch_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+};
+
+} // namespace
+
+int64_t teaser::trace::now() { return Registry::instance().now(); }
+
+void teaser::trace::recordEvent(const char* name, int64_t start_ns, int64_t duration_ns) {
+  Registry::instance().threadBuffer().push({name, start_ns, duration_ns});
+}
+
+#endif
+
+void teaser::trace::writeChromeTrace(std::ostream& os) {
+#ifdef TEASER_ENABLE_TRACING
+  Registry::instance().write(os);
+#else
+  os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[]}" << std::endl;
+#endif
+}
+
+bool teaser::trace::writeChromeTrace(const std::string& file_name) {
+  std::ofstream file(file_name);
+  if (!file) {
+    return false;
+  }
+  writeChromeTrace(file);
+  return static_cast<bool>(file);
+}
+
+void teaser::trace::clearTrace() {
+#ifdef TEASER_ENABLE_TRACING
+  Registry::instance().clear();
+#endif
+}
@@ -0,0 +1,171 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "teaser/ply_io.h"
+
+/**
+ * Throughput of reading PLY files of map tile size, in GB/s of file read.
+ */
+class PLYIOBenchmark : public ::testing::Test {
+protected:
+  /**
+   * Number of points of the generated files (a 60 MB file for float coordinates)
+   */
+  static constexpr size_t NUM_POINTS = 5000000;
+
+  /**
+   * Number of timed repetitions of each reader
+   */
+  static constexpr int NUM_REPETITIONS = 5;
+
+  /**
+   * Write a binary little-endian PLY file of NUM_POINTS random vertices
+   * @param file_name
+   * @param use_double write float64 coordinates instead of float32
+   * @param with_colors add uchar red, green and blue properties to the vertices
+   * @return size of the file in bytes
+   */
+  size_t writeFile(const std::string& file_name, bool use_double, bool with_colors) {
+    const std::string type = use_double ? "double" : "float";
+    std::ofstream file(file_name, std::ios::binary);
+    file << "ply\nformat binary_little_endian 1.0\nelement vertex " << NUM_POINTS << "\n"
+         << "property " << type << " x\nproperty " << type << " y\nproperty " << type << " z\n";
+    if (with_colors) {
+      file << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+    }
+    file << "end_header\n";
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> uniform(-100, 100);
+    const uint8_t color[3] = {255, 128, 0};
+    for (size_t i = 0; i < NUM_POINTS; ++i) {
+      for (int c = 0; c < 3; ++c) {
+        const float coordinate = uniform(rng);
+        if (use_double) {
+          const double value = coordinate;
+          file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        } else {
+          file.write(reinterpret_cast<const char*>(&coordinate), sizeof(coordinate));
+        }
+      }
+      if (with_colors) {
+        file.write(reinterpret_cast<const char*>(color), sizeof(color));
+      }
+    }
+    return static_cast<size_t>(file.tellp());
+  }
+
+  /**
+   * Write an ASCII PLY file of NUM_POINTS random vertices, with 6 decimals
+   * @param file_name
+   * @return size of the file in bytes
+   */
+  size_t writeASCIIFile(const std::string& file_name) {
+    std::ofstream file(file_name, std::ios::binary);
+    file << "ply\nformat ascii 1.0\nelement vertex " << NUM_POINTS << "\n"
+         << "property float x\nproperty float y\nproperty float z\nend_header\n";
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> uniform(-100, 100);
+    file << std::fixed << std::setprecision(6);
+    for (size_t i = 0; i < NUM_POINTS; ++i) {
+      file << uniform(rng) << " " << uniform(rng) << " " << uniform(rng) << "\n";
+    }
+    return static_cast<size_t>(file.tellp());
+  }
+
+  /**
+   * Time a reader and print its throughput
+   * @param name
+   * @param file_size bytes read per run
+   * @param read function reading the file, returning the number of points read
+   */
+  void benchmark(const std::string& name, size_t file_size, const std::function<size_t()>& read) {
+    double best_time = std::numeric_limits<double>::infinity();
+    for (int r = 0; r < NUM_REPETITIONS; ++r) {
+      auto start = std::chrono::high_resolution_clock::now();
+      size_t num_points = read();
+      auto stop = std::chrono::high_resolution_clock::now();
+      ASSERT_EQ(num_points, static_cast<size_t>(NUM_POINTS));
+      best_time = std::min(best_time, std::chrono::duration<double>(stop - start).count());
+    }
+    std::cout << std::left << std::setw(40) << name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(8) << file_size / best_time / 1e9 << " GB/s ("
+              << std::setprecision(1) << best_time * 1e3 << " ms)" << std::endl;
+  }
+
+  /**
+   * Benchmark all the readers on one file
+   */
+  void benchmarkFile(const std::string& file_name, size_t file_size) {
+    benchmark("PLYReader::read", file_size, [&file_name]() {
+      teaser::PLYReader reader;
+      teaser::PointCloud cloud;
+      reader.read(file_name, cloud);
+      return cloud.size();
+    });
+    benchmark("MappedPLYFile::readVertices", file_size, [&file_name]() {
+      teaser::MappedPLYFile file;
+      teaser::PointCloud cloud;
+      if (file.open(file_name) != 0 || file.readVertices(cloud) != 0) {
+        return size_t(0);
+      }
+      return cloud.size();
+    });
+
+    // Zero-copy view, when the layout allows it; the points are summed to touch them
+    teaser::MappedPLYFile file;
+    ASSERT_EQ(file.open(file_name), 0) << file.error();
+    if (file.points()) {
+      benchmark("MappedPLYFile::points", file_size, [&file_name]() {
+        teaser::MappedPLYFile file;
+        file.open(file_name);
+        const teaser::PointXYZ* points = file.points();
+        float sum = 0;
+        for (size_t i = 0; i < file.numVertices(); ++i) {
+          sum += points[i].x + points[i].y + points[i].z;
+        }
+        return sum == std::numeric_limits<float>::infinity() ? size_t(0) : file.numVertices();
+      });
+    }
+  }
+};
+
+TEST_F(PLYIOBenchmark, PackedFloats) {
+  const std::string file_name = "PLYIOBenchmark_PackedFloats.ply";
+  size_t file_size = writeFile(file_name, false, false);
+  benchmarkFile(file_name, file_size);
+  std::remove(file_name.c_str());
+}
+
+TEST_F(PLYIOBenchmark, DoublesWithColors) {
+  const std::string file_name = "PLYIOBenchmark_DoublesWithColors.ply";
+  size_t file_size = writeFile(file_name, true, true);
+  benchmarkFile(file_name, file_size);
+  std::remove(file_name.c_str());
+}
+
+TEST_F(PLYIOBenchmark, ASCII) {
+  const std::string file_name = "PLYIOBenchmark_ASCII.ply";
+  size_t file_size = writeASCIIFile(file_name);
+  benchmarkFile(file_name, file_size);
+  std::remove(file_name.c_str());
+}
@@ -176,6 +176,7 @@ protected:
     double s_err_ref_avg = 0, t_err_ref_avg = 0, R_err_ref_avg = 0, s_err_est_avg = 0,
            t_err_est_avg = 0, R_err_est_avg = 0;
     double duration_avg = 0;
+    teaser::RegistrationStats stats_avg;
 
     for (size_t i = 0; i < num_runs; ++i) {
       // Start the timer
@@ -214,6 +215,15 @@ protected:
       // Get the solution
       auto actual_solution = solver.getSolution();
 
+      // Per-stage timings
+      auto stats = solver.getStats();
+      stats_avg.tims_time += stats.tims_time;
+      stats_avg.scale_time += stats.scale_time;
+      stats_avg.graph_time += stats.graph_time;
+      stats_avg.clique_time += stats.clique_time;
+      stats_avg.rotation_time += stats.rotation_time;
+      stats_avg.translation_time += stats.translation_time;
+
       // Errors wrt ground truths
       double s_err_ref = std::abs(actual_solution.scale - data.s_ref);
       double t_err_ref = (actual_solution.translation - data.t_ref).norm();
@@ -244,6 +254,14 @@ protected:
     R_err_est_avg *= div_factor;
     t_err_est_avg *= div_factor;
     duration_avg *= div_factor;
+    // in microseconds, as the total duration
+    double stage_factor = 1e6 * div_factor;
+    stats_avg.tims_time *= stage_factor;
+    stats_avg.scale_time *= stage_factor;
+    stats_avg.graph_time *= stage_factor;
+    stats_avg.clique_time *= stage_factor;
+    stats_avg.rotation_time *= stage_factor;
+    stats_avg.translation_time *= stage_factor;
 
     // Print report
     std::cout << "==============================================" << std::endl;
@@ -263,6 +281,14 @@ protected:
     std::cout << "       in scale: " << s_err_est_avg << std::endl;
     std::cout << "    in rotation: " << R_err_est_avg << std::endl;
     std::cout << " in translation: " << t_err_est_avg << std::endl;
+    std::cout << "----------------------------------------------" << std::endl;
+    std::cout << "        Time per Stage (in microseconds)      " << std::endl;
+    std::cout << "           TIMs: " << stats_avg.tims_time << std::endl;
+    std::cout << "          scale: " << stats_avg.scale_time << std::endl;
+    std::cout << "   inlier graph: " << stats_avg.graph_time << std::endl;
+    std::cout << "     max clique: " << stats_avg.clique_time << std::endl;
+    std::cout << "       rotation: " << stats_avg.rotation_time << std::endl;
+    std::cout << "    translation: " << stats_avg.translation_time << std::endl;
     std::cout << "==============================================" << std::endl;
 
     std::cout << "Time taken to run benchmark: " << duration_avg << " microseconds." << std::endl;
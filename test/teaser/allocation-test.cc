@@ -0,0 +1,120 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <cstddef>
+#include <random>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "teaser/registration.h"
+
+// This binary replaces the glibc allocation functions, so that the heap allocations of Eigen
+// (which calls malloc directly) and of operator new are both counted, including those made inside
+// the shared registration library.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace {
+
+// Heap allocations made while counting_allocations is set
+std::atomic<bool> counting_allocations(false);
+std::atomic<size_t> num_allocations(0);
+
+void countAllocation(size_t size) {
+  if (counting_allocations.load(std::memory_order_relaxed)) {
+    num_allocations++;
+  }
+}
+
+} // namespace
+
+extern "C" {
+
+void* malloc(size_t size) {
+  countAllocation(size);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t num, size_t size) {
+  countAllocation(num * size);
+  return __libc_calloc(num, size);
+}
+
+void* realloc(void* p, size_t size) {
+  countAllocation(size);
+  return __libc_realloc(p, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+  countAllocation(size);
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+  countAllocation(size);
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** p, size_t alignment, size_t size) {
+  countAllocation(size);
+  *p = __libc_memalign(alignment, size);
+  return *p ? 0 : 12; // ENOMEM
+}
+
+} // extern "C"
+
+TEST(RegistrationTest, SteadyStateAllocations) {
+  // Once the buffers have grown, solves of the same size do not allocate, except for the thread
+  // teams that the OpenMP runtime sets up for the parallel regions. Inlier graphs with few outliers
+  // are dense, so that the max clique is found without PMC (which allocates on every call).
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> uniform(-1, 1);
+  Eigen::Matrix3d R =
+      Eigen::AngleAxisd(1.2, Eigen::Vector3d(1, 0, 1).normalized()).toRotationMatrix();
+  Eigen::Vector3d t(0.1, 0.2, -0.3);
+
+  for (const bool estimate_scaling : {false, true}) {
+    teaser::RobustRegistrationSolver::Params params;
+    params.noise_bound = 0.001;
+    params.estimate_scaling = estimate_scaling;
+    teaser::RobustRegistrationSolver solver(params);
+
+    std::vector<size_t> counts;
+    for (const int N : {100, 200}) {
+      Eigen::Matrix<double, 3, Eigen::Dynamic> src(3, N);
+      for (int i = 0; i < N; ++i) {
+        src.col(i) << uniform(rng), uniform(rng), uniform(rng);
+      }
+      Eigen::Matrix<double, 3, Eigen::Dynamic> dst = (R * src).colwise() + t;
+      for (int i = 0; i < N; i += 20) {
+        dst.col(i) << uniform(rng), uniform(rng), uniform(rng);
+      }
+      solver.solve(src, dst);
+
+      num_allocations = 0;
+      counting_allocations = true;
+      auto solution = solver.solve(src, dst);
+      counting_allocations = false;
+      EXPECT_TRUE(solution.valid);
+      // Max clique found on the dense graph path
+      EXPECT_EQ(solver.getStats().max_core, -1);
+      EXPECT_LE(num_allocations, 16);
+      counts.push_back(num_allocations);
+    }
+    // The remaining allocations do not depend on the problem size
+    EXPECT_EQ(counts[0], counts[1]);
+  }
+}
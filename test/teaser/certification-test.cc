@@ -0,0 +1,128 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <random>
+
+#include <Eigen/Geometry>
+
+#include "teaser/certification.h"
+#include "teaser/registration.h"
+
+TEST(CertificationTest, QuaternionCorrelation) {
+  std::default_random_engine re(5);
+  std::uniform_real_distribution<double> unif(-1, 1);
+  for (size_t k = 0; k < 10; ++k) {
+    Eigen::Quaterniond quat(unif(re), unif(re), unif(re), unif(re));
+    quat.normalize();
+    Eigen::Vector4d q(quat.w(), quat.x(), quat.y(), quat.z());
+    Eigen::Vector3d src = Eigen::Vector3d::Random();
+    Eigen::Vector3d dst = Eigen::Vector3d::Random();
+
+    Eigen::Matrix4d n = teaser::DRSCertifier::getQuaternionCorrelation(src, dst);
+    EXPECT_NEAR(q.dot(n * q), dst.dot(quat.toRotationMatrix() * src), 1e-12);
+  }
+}
+
+TEST(CertificationTest, GNCTLSRotation) {
+  const size_t N = 40;
+  const size_t N_OUTLIERS = 8;
+  const double NOISE = 0.01;
+  const double NOISE_BOUND = 0.055;
+  std::default_random_engine re(7);
+  std::uniform_real_distribution<double> unif(-1, 1);
+
+  Eigen::Matrix3d R =
+      Eigen::AngleAxisd(1.2, Eigen::Vector3d(1, 2, 3).normalized()).toRotationMatrix();
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src(3, N);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst(3, N);
+  for (size_t i = 0; i < N; ++i) {
+    src.col(i) << unif(re), unif(re), unif(re);
+    Eigen::Vector3d noise(unif(re), unif(re), unif(re));
+    dst.col(i) = R * src.col(i) + NOISE * noise;
+  }
+  for (size_t i = 0; i < N_OUTLIERS; ++i) {
+    dst.col(i) << unif(re), unif(re), unif(re);
+  }
+
+  teaser::GNCTLSRotationSolver::Params gnc_params{100, 1e-12, 1.4, NOISE_BOUND};
+  teaser::GNCTLSRotationSolver gnc_solver(gnc_params);
+  Eigen::Matrix3d R_est;
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> inliers(1, N);
+  gnc_solver.solveForRotation(src, dst, &R_est, &inliers);
+
+  teaser::DRSCertifier::Params params;
+  params.noise_bound = NOISE_BOUND;
+  params.time_limit = 5;
+  teaser::DRSCertifier certifier(params);
+
+  // The GNC-TLS estimate is globally optimal
+  auto result = certifier.certify(R_est, src, dst, inliers);
+  EXPECT_TRUE(result.is_optimal);
+  EXPECT_LE(result.best_suboptimality, params.sub_optimality);
+  EXPECT_EQ(result.suboptimality_traj.size(), result.iterations + 1);
+
+  // A wrong rotation is not; with no refinement budget only the initial guess is evaluated
+  Eigen::Matrix3d R_wrong = Eigen::AngleAxisd(0.5, Eigen::Vector3d::UnitX()).toRotationMatrix() * R;
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> all_inliers(1, N);
+  all_inliers.setOnes();
+  params.max_iterations = 0;
+  certifier.setParams(params);
+  result = certifier.certify(R_wrong, src, dst, all_inliers);
+  EXPECT_FALSE(result.is_optimal);
+  EXPECT_GT(result.best_suboptimality, params.sub_optimality);
+  EXPECT_EQ(result.iterations, 0);
+}
+
+TEST(CertificationTest, TimeLimit) {
+  // A single PSD projection over this many inliers takes seconds; none may start past the budget
+  const size_t N = 400;
+  std::default_random_engine re(11);
+  std::uniform_real_distribution<double> unif(-1, 1);
+  Eigen::Matrix3d R =
+      Eigen::AngleAxisd(0.7, Eigen::Vector3d(3, 1, 2).normalized()).toRotationMatrix();
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src(3, N);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst(3, N);
+  for (size_t i = 0; i < N; ++i) {
+    src.col(i) << unif(re), unif(re), unif(re);
+    dst.col(i) = R * src.col(i);
+  }
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> all_inliers(1, N);
+  all_inliers.setOnes();
+
+  teaser::DRSCertifier::Params params;
+  params.noise_bound = 0.01;
+  params.time_limit = 0.5;
+  teaser::DRSCertifier certifier(params);
+
+  // A wrong rotation needs refinement, which is cut short by the time limit
+  Eigen::Matrix3d R_wrong = Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitY()).toRotationMatrix() * R;
+  const auto start = std::chrono::steady_clock::now();
+  auto result = certifier.certify(R_wrong, src, dst, all_inliers);
+  const double elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  EXPECT_LT(elapsed, 2 * params.time_limit);
+  EXPECT_FALSE(result.is_optimal);
+  EXPECT_LT(result.iterations, params.max_iterations);
+  if (result.suboptimality_traj.empty()) {
+    EXPECT_EQ(result.best_suboptimality, -1);
+  } else {
+    EXPECT_GT(result.best_suboptimality, params.sub_optimality);
+  }
+
+  // No gap is proven without any time
+  params.time_limit = 0;
+  certifier.setParams(params);
+  result = certifier.certify(R_wrong, src, dst, all_inliers);
+  EXPECT_FALSE(result.is_optimal);
+  EXPECT_EQ(result.best_suboptimality, -1);
+  EXPECT_TRUE(result.suboptimality_traj.empty());
+  EXPECT_EQ(result.iterations, 0);
+}
@@ -9,8 +9,10 @@
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 
+#include <algorithm>
 #include <iostream>
 #include <map>
+#include <set>
 
 #include "pmc/pmc.h"
 #include "pmc/pmc_input.h"
@@ -296,4 +298,143 @@ TEST(MaxCliqueSolverTest, FindMaxClique) {
       EXPECT_TRUE(s.find(i) != s.end());
     }
   }
-}
\ No newline at end of file
+}
+
+TEST(MaxCliqueSolverTest, DenseGraph) {
+  // A near-complete graph: outliers miss most edges, and a few edges between inliers are missing
+  const int N = 40;
+  const std::set<int> outliers{3, 17, 29};
+  std::map<int, std::vector<int>> vertices_map;
+  for (int i = 0; i < N; ++i) {
+    vertices_map[i] = {};
+  }
+  for (int i = 0; i < N; ++i) {
+    for (int j = i + 1; j < N; ++j) {
+      bool is_outlier_edge = outliers.count(i) || outliers.count(j);
+      bool keep = is_outlier_edge ? (i + j) % 5 == 0 : (i * j) % 97 != 1;
+      if (keep) {
+        vertices_map[i].push_back(j);
+        vertices_map[j].push_back(i);
+      }
+    }
+  }
+  teaser::Graph graph(vertices_map);
+
+  teaser::MaxCliqueSolver::Params params;
+  params.dense_graph_threshold = 2;
+  teaser::MaxCliqueSolver pmc_solver(params);
+  auto pmc_clique = pmc_solver.findMaxClique(graph);
+
+  params.dense_graph_threshold = 0.8;
+  teaser::MaxCliqueSolver dense_solver(params);
+  auto clique = dense_solver.findMaxClique(graph);
+  EXPECT_EQ(dense_solver.getMaxCoreAtTermination(), -1);
+  EXPECT_EQ(clique.size(), pmc_clique.size());
+  for (size_t i = 0; i < clique.size(); ++i) {
+    EXPECT_EQ(outliers.count(clique[i]), 0);
+    for (size_t j = i + 1; j < clique.size(); ++j) {
+      EXPECT_TRUE(graph.hasEdge(clique[i], clique[j]));
+    }
+  }
+
+  // Covers larger than allowed fall back to PMC
+  params.dense_graph_max_cover_size = 1;
+  dense_solver.setParams(params);
+  clique = dense_solver.findMaxClique(graph);
+  EXPECT_GE(dense_solver.getMaxCoreAtTermination(), 0);
+  EXPECT_EQ(clique.size(), pmc_clique.size());
+}
+
+TEST(MaxCliqueSolverTest, DenseGraphCancellation) {
+  // Complete graph but for a few missing edges, solved on the dense graph path
+  const int N = 100;
+  teaser::Graph graph;
+  graph.populateVertices(N);
+  for (int i = 0; i < N; ++i) {
+    for (int j = i + 1; j < N; ++j) {
+      if (i % 10 != 0 || j != i + 1) {
+        graph.addEdge(i, j);
+      }
+    }
+  }
+
+  auto token = std::make_shared<teaser::CancellationToken>();
+  teaser::MaxCliqueSolver::Params params;
+  params.cancellation_token = token;
+  teaser::MaxCliqueSolver solver(params);
+  auto clique = solver.findMaxClique(graph);
+  EXPECT_EQ(solver.getMaxCoreAtTermination(), -1);
+  EXPECT_EQ(clique.size(), static_cast<size_t>(N - 10));
+
+  // An explicit cancellation or an expired deadline stops the search without a clique
+  token->cancel();
+  clique = solver.findMaxClique(graph);
+  EXPECT_TRUE(clique.empty());
+  token->reset();
+  token->setTimeout(-1);
+  clique = solver.findMaxClique(graph);
+  EXPECT_TRUE(clique.empty());
+}
+
+TEST(GraphTest, IsolateVertices) {
+  // Complete graph on 6 vertices
+  teaser::Graph graph;
+  graph.populateVertices(6);
+  for (int i = 0; i < 6; ++i) {
+    for (int j = i + 1; j < 6; ++j) {
+      graph.addEdge(i, j);
+    }
+  }
+  EXPECT_EQ(graph.numEdges(), 15);
+
+  graph.isolateVertices({1, 4});
+  EXPECT_EQ(graph.numVertices(), 6);
+  EXPECT_EQ(graph.numEdges(), 6);
+  EXPECT_TRUE(graph.getEdges(1).empty());
+  EXPECT_TRUE(graph.getEdges(4).empty());
+  EXPECT_THAT(graph.getEdges(0), testing::UnorderedElementsAre(2, 3, 5));
+  EXPECT_FALSE(graph.hasEdge(2, 4));
+  EXPECT_TRUE(graph.hasEdge(2, 5));
+}
+
+TEST(MaxCliqueSolverTest, WarmStart) {
+  // Two cliques, {0..5} and {6..9}, with a few edges between them
+  std::map<int, std::vector<int>> vertices_map;
+  auto add_clique = [&vertices_map](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      for (int j = begin; j < end; ++j) {
+        if (i != j) {
+          vertices_map[i].push_back(j);
+        }
+      }
+    }
+  };
+  add_clique(0, 6);
+  add_clique(6, 10);
+  vertices_map[0].push_back(6);
+  vertices_map[6].push_back(0);
+  teaser::Graph graph(vertices_map);
+
+  teaser::MaxCliqueSolver::Params params;
+  params.dense_graph_threshold = 2;
+  teaser::MaxCliqueSolver solver(params);
+  auto expected = solver.findMaxClique(graph);
+  std::sort(expected.begin(), expected.end());
+  EXPECT_THAT(expected, testing::ElementsAre(0, 1, 2, 3, 4, 5));
+
+  // Warm start with the smaller clique, with a vertex that breaks it and one out of range
+  auto clique = solver.findMaxClique(graph, {6, 7, 1, 8, 9, 42});
+  std::sort(clique.begin(), clique.end());
+  EXPECT_EQ(clique, expected);
+
+  // Warm start with the max clique itself
+  clique = solver.findMaxClique(graph, expected);
+  std::sort(clique.begin(), clique.end());
+  EXPECT_EQ(clique, expected);
+
+  // The heuristic mode keeps the better of the warm start and the heuristic clique
+  params.solver_mode = teaser::MaxCliqueSolver::CLIQUE_SOLVER_MODE::PMC_HEU;
+  solver.setParams(params);
+  clique = solver.findMaxClique(graph, {6, 7, 8, 9});
+  EXPECT_EQ(clique.size(), expected.size());
+}
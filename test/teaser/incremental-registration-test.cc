@@ -0,0 +1,110 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "teaser/incremental_registration.h"
+#include "teaser/registration.h"
+
+TEST(IncrementalRegistrationTest, MatchesFullSolves) {
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.01;
+  params.cbar2 = 1;
+  params.estimate_scaling = false;
+  params.rotation_max_iterations = 100;
+  params.rotation_gnc_factor = 1.4;
+  params.rotation_cost_threshold = 1e-12;
+
+  // A stream of correspondences of one rigid transformation, one in five an outlier
+  const int N = 120;
+  Eigen::Matrix3d R =
+      Eigen::AngleAxisd(0.4, Eigen::Vector3d(1, -2, 3).normalized()).toRotationMatrix();
+  Eigen::Vector3d t(0.3, -0.1, 0.5);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src =
+      Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, N);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst = (R * src).colwise() + t;
+  for (int i = 0; i < N; i += 5) {
+    dst.col(i) += Eigen::Vector3d(1, -1, 2) * (1 + 0.1 * i);
+  }
+
+  teaser::IncrementalRegistrationSolver solver(params);
+  std::vector<int> window_ids;
+  std::vector<int> window_columns;
+  for (int begin = 0; begin < N; begin += 20) {
+    // Slide the window: add 20 correspondences, retire the oldest ones beyond 60
+    const size_t num_before = solver.numCorrespondences();
+    auto ids = solver.addCorrespondences(src.middleCols(begin, 20), dst.middleCols(begin, 20));
+    ASSERT_EQ(ids.size(), 20);
+    for (int i = 0; i < 20; ++i) {
+      window_ids.push_back(ids[i]);
+      window_columns.push_back(begin + i);
+    }
+    if (window_ids.size() > 60) {
+      std::vector<int> retired(window_ids.begin(), window_ids.end() - 60);
+      solver.removeCorrespondences(retired);
+      window_ids.erase(window_ids.begin(), window_ids.end() - 60);
+      window_columns.erase(window_columns.begin(), window_columns.end() - 60);
+    }
+    ASSERT_EQ(solver.numCorrespondences(), window_ids.size());
+
+    auto solution = solver.solve();
+    ASSERT_TRUE(solution.valid);
+    EXPECT_TRUE(solution.rotation.isApprox(R, 1e-6));
+    EXPECT_TRUE(solution.translation.isApprox(t, 1e-6));
+
+    // Only the new pairs were checked
+    EXPECT_EQ(solver.getStats().num_tims, 20 * num_before + 20 * 19 / 2);
+
+    // Same inlier graph and clique as a full solve on the window
+    const int M = window_columns.size();
+    Eigen::Matrix<double, 3, Eigen::Dynamic> window_src(3, M);
+    Eigen::Matrix<double, 3, Eigen::Dynamic> window_dst(3, M);
+    for (int i = 0; i < M; ++i) {
+      window_src.col(i) = src.col(window_columns[i]);
+      window_dst.col(i) = dst.col(window_columns[i]);
+    }
+    teaser::RobustRegistrationSolver full_solver(params);
+    full_solver.solve(window_src, window_dst);
+
+    std::set<std::pair<int, int>> expected_edges;
+    auto full_graph = full_solver.getInlierGraph();
+    for (int i = 0; i < M; ++i) {
+      for (const auto& j : full_graph[i]) {
+        expected_edges.emplace(window_ids[i], window_ids[j]);
+      }
+    }
+    std::set<std::pair<int, int>> edges;
+    const auto& graph = solver.getInlierGraph();
+    for (int i = 0; i < graph.numVertices(); ++i) {
+      for (const auto& j : graph.getEdges(i)) {
+        edges.emplace(i, j);
+      }
+    }
+    EXPECT_EQ(edges, expected_edges);
+    EXPECT_EQ(solver.getStats().num_edges, expected_edges.size() / 2);
+
+    std::vector<int> expected_clique;
+    for (const auto& i : full_solver.getInlierMaxClique()) {
+      expected_clique.push_back(window_ids[i]);
+    }
+    std::sort(expected_clique.begin(), expected_clique.end());
+    EXPECT_EQ(solver.getInlierMaxClique(), expected_clique);
+  }
+
+  solver.clear();
+  EXPECT_EQ(solver.numCorrespondences(), 0);
+  EXPECT_FALSE(solver.solve().valid);
+}
@@ -8,7 +8,17 @@
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "teaser/ply_io.h"
 
@@ -43,3 +53,235 @@ TEST(IOTest, ImportBigPLY) {
   auto status = reader.read("./data/uw-rgbdv2-01.ply", cloud);
   EXPECT_EQ(status, 0);
 }
+
+namespace {
+
+/**
+ * Write a PLY file from its header and raw element data
+ */
+void writePLY(const std::string& file_name, const std::string& header,
+              const std::vector<uint8_t>& data) {
+  std::ofstream file(file_name, std::ios::binary);
+  file << header;
+  file.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+/**
+ * Append the bytes of a value, in big-endian order if requested
+ */
+template <typename T>
+void appendBytes(T value, bool big_endian, std::vector<uint8_t>* data) {
+  uint8_t bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+  const uint16_t one = 1;
+  const bool little_endian_host = *reinterpret_cast<const uint8_t*>(&one) == 1;
+  if (big_endian == little_endian_host) {
+    std::reverse(bytes, bytes + sizeof(T));
+  }
+  data->insert(data->end(), bytes, bytes + sizeof(T));
+}
+
+} // namespace
+
+TEST(IOTest, MappedBinaryPLY) {
+  const int N = 1000;
+  std::vector<teaser::PointXYZ> expected(N);
+  std::vector<uint8_t> data;
+  for (int i = 0; i < N; ++i) {
+    expected[i] = {0.5f * i, -0.25f * i, 1.0f / (i + 1)};
+    appendBytes(expected[i].x, false, &data);
+    appendBytes(expected[i].y, false, &data);
+    appendBytes(expected[i].z, false, &data);
+  }
+  // The comment pads the header to a multiple of 4 bytes, so that the vertices are aligned
+  std::string header = "ply\nformat binary_little_endian 1.0\nelement vertex " +
+                       std::to_string(N) +
+                       "\nproperty float x\nproperty float y\nproperty float z\nend_header\n";
+  header.insert(4, "comment " + std::string((4 - (header.size() + 9) % 4) % 4, 'a') + "\n");
+  ASSERT_EQ(header.size() % 4, 0);
+  const std::string file_name = "IOTest_MappedBinaryPLY.ply";
+  writePLY(file_name, header, data);
+
+  teaser::MappedPLYFile file;
+  ASSERT_EQ(file.open(file_name), 0) << file.error();
+  EXPECT_EQ(file.numVertices(), N);
+  EXPECT_EQ(file.vertexLayout().header_size, header.size());
+  EXPECT_EQ(file.vertexLayout().stride, 12);
+
+  // Zero-copy view, on little-endian hosts
+  const uint16_t one = 1;
+  if (*reinterpret_cast<const uint8_t*>(&one) == 1) {
+    const teaser::PointXYZ* points = file.points();
+    ASSERT_NE(points, nullptr);
+    for (int i = 0; i < N; ++i) {
+      EXPECT_EQ(points[i], expected[i]);
+    }
+  }
+
+  // Copy, appended to the existing points
+  teaser::PointCloud cloud;
+  cloud.push_back({1, 2, 3});
+  ASSERT_EQ(file.readVertices(cloud), 0);
+  ASSERT_EQ(cloud.size(), N + 1);
+  for (int i = 0; i < N; ++i) {
+    EXPECT_EQ(cloud[i + 1], expected[i]);
+  }
+
+  teaser::PLYReader reader;
+  teaser::PointCloud read_cloud;
+  EXPECT_EQ(reader.read(file_name, read_cloud), 0);
+  ASSERT_EQ(read_cloud.size(), N);
+  for (int i = 0; i < N; ++i) {
+    EXPECT_EQ(read_cloud[i], expected[i]);
+  }
+}
+
+TEST(IOTest, MappedStridedPLY) {
+  // Big-endian doubles interleaved with colors, after another fixed size element
+  const int N = 100;
+  std::vector<teaser::PointXYZ> expected(N);
+  std::vector<uint8_t> data;
+  appendBytes<int32_t>(42, true, &data);
+  for (int i = 0; i < N; ++i) {
+    expected[i] = {0.5f * i, -0.25f * i, 1.0f / (i + 1)};
+    appendBytes<uint8_t>(i, true, &data);
+    appendBytes<double>(expected[i].z, true, &data);
+    appendBytes<double>(expected[i].x, true, &data);
+    appendBytes<uint16_t>(i, true, &data);
+    appendBytes<double>(expected[i].y, true, &data);
+  }
+  const std::string header = "ply\nformat binary_big_endian 1.0\ncomment test\n"
+                             "element camera 1\nproperty int32 id\n"
+                             "element vertex " +
+                             std::to_string(N) +
+                             "\nproperty uchar red\nproperty double z\nproperty double x\n"
+                             "property ushort green\nproperty double y\nend_header\n";
+  const std::string file_name = "IOTest_MappedStridedPLY.ply";
+  writePLY(file_name, header, data);
+
+  teaser::MappedPLYFile file;
+  ASSERT_EQ(file.open(file_name), 0) << file.error();
+  const auto& layout = file.vertexLayout();
+  EXPECT_EQ(layout.vertex_data_offset, header.size() + 4);
+  EXPECT_EQ(layout.stride, 27);
+  EXPECT_EQ(layout.x_offset, 9);
+  EXPECT_EQ(layout.y_offset, 19);
+  EXPECT_EQ(layout.z_offset, 1);
+  EXPECT_EQ(layout.coordinate_size, 8);
+  EXPECT_EQ(file.points(), nullptr);
+
+  teaser::PointCloud cloud;
+  ASSERT_EQ(file.readVertices(cloud), 0);
+  ASSERT_EQ(cloud.size(), N);
+  for (int i = 0; i < N; ++i) {
+    EXPECT_EQ(cloud[i], expected[i]);
+  }
+
+  // Truncated file
+  data.resize(data.size() - 1);
+  writePLY(file_name, header, data);
+  EXPECT_EQ(file.open(file_name), -1);
+  EXPECT_EQ(file.numVertices(), 0);
+
+  // Missing coordinate
+  writePLY(file_name,
+           "ply\nformat binary_little_endian 1.0\nelement vertex 1\nproperty float x\n"
+           "property float y\nend_header\n",
+           std::vector<uint8_t>(8));
+  EXPECT_EQ(file.open(file_name), -1);
+}
+
+TEST(IOTest, MappedASCIIPLY) {
+  // Numbers in the formats of common writers, enough lines for several parsing chunks. The
+  // reference values are parsed by strtof.
+  const int N = 20000;
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> uniform(-1000, 1000);
+  std::vector<teaser::PointXYZ> expected(N);
+  std::ostringstream vertices;
+  for (int i = 0; i < N; ++i) {
+    char buffer[3][64];
+    for (int c = 0; c < 3; ++c) {
+      const double value = uniform(rng) * std::pow(10.0, i % 7 - 3);
+      switch ((i + c) % 5) {
+      case 0:
+        std::snprintf(buffer[c], sizeof(buffer[c]), "%.9g", value);
+        break;
+      case 1:
+        std::snprintf(buffer[c], sizeof(buffer[c]), "%f", value);
+        break;
+      case 2:
+        std::snprintf(buffer[c], sizeof(buffer[c]), "%.17e", value);
+        break;
+      case 3:
+        std::snprintf(buffer[c], sizeof(buffer[c]), "%d", static_cast<int>(value));
+        break;
+      default:
+        std::snprintf(buffer[c], sizeof(buffer[c]), "%.20f", value);
+        break;
+      }
+    }
+    expected[i] = {std::strtof(buffer[0], nullptr), std::strtof(buffer[1], nullptr),
+                   std::strtof(buffer[2], nullptr)};
+    // Intensity before the coordinates, color after them, and some lines ending with \r\n
+    vertices << i << "  " << buffer[0] << " " << buffer[1] << "\t" << buffer[2] << " 255 0 0"
+             << (i % 3 ? "\n" : " \r\n");
+  }
+  const std::string header = "ply\nformat ascii 1.0\ncomment test\nelement camera 2\n"
+                             "property list uchar int indices\nelement vertex " +
+                             std::to_string(N) +
+                             "\nproperty int intensity\nproperty float x\nproperty float y\n"
+                             "property double z\nproperty uchar red\nproperty uchar green\n"
+                             "property uchar blue\nelement face 1\n"
+                             "property list uchar int vertex_indices\nend_header\n"
+                             "3 0 1 2\n"
+                             "0\n";
+  const std::string faces = "3 0 1 2";
+  const std::string file_name = "IOTest_MappedASCIIPLY.ply";
+  {
+    std::ofstream file(file_name, std::ios::binary);
+    file << header << vertices.str() << faces;
+  }
+
+  teaser::MappedPLYFile file;
+  ASSERT_EQ(file.open(file_name), 0) << file.error();
+  EXPECT_EQ(file.vertexLayout().vertex_data_offset, header.size());
+  EXPECT_EQ(file.vertexLayout().x_index, 1);
+  EXPECT_EQ(file.vertexLayout().z_index, 3);
+  EXPECT_EQ(file.points(), nullptr);
+  teaser::PointCloud cloud;
+  ASSERT_EQ(file.readVertices(cloud), 0) << file.error();
+  ASSERT_EQ(cloud.size(), N);
+  for (int i = 0; i < N; ++i) {
+    ASSERT_EQ(cloud[i], expected[i]) << "Vertex " << i;
+  }
+
+  // The cube of the ASCII test data
+  teaser::PointCloud cube;
+  ASSERT_EQ(file.open("./data/cube.ply"), 0) << file.error();
+  ASSERT_EQ(file.readVertices(cube), 0) << file.error();
+  ASSERT_EQ(cube.size(), 8);
+  EXPECT_EQ(cube[0], teaser::PointXYZ({-1, -1, -1}));
+  EXPECT_EQ(cube[6], teaser::PointXYZ({1, 1, 1}));
+
+  // Invalid vertex
+  std::string invalid = vertices.str();
+  invalid.replace(invalid.find("\n1000 ") + 7, 1, "x");
+  {
+    std::ofstream invalid_file(file_name, std::ios::binary);
+    invalid_file << header << invalid << faces;
+  }
+  ASSERT_EQ(file.open(file_name), 0) << file.error();
+  EXPECT_EQ(file.readVertices(cloud), -1);
+  EXPECT_EQ(file.error(), "Invalid vertex 1000");
+  EXPECT_EQ(cloud.size(), N);
+
+  // Missing vertices
+  {
+    std::ofstream truncated_file(file_name, std::ios::binary);
+    truncated_file << header << vertices.str().substr(0, 1000);
+  }
+  ASSERT_EQ(file.open(file_name), 0) << file.error();
+  EXPECT_EQ(file.readVertices(cloud), -1);
+  EXPECT_EQ(cloud.size(), N);
+}
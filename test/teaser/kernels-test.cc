@@ -0,0 +1,121 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "gtest/gtest.h"
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "teaser/kernels.h"
+
+namespace {
+
+/**
+ * Outputs of all the kernels on fixed random inputs, with the active ISA
+ */
+struct KernelOutputs {
+  std::vector<uint64_t> mask;
+  Eigen::Matrix<double, 3, Eigen::Dynamic> tims;
+  Eigen::RowVectorXd x_hat;
+  Eigen::RowVectorXd x_cost;
+  Eigen::RowVectorXd residuals_sq;
+};
+
+KernelOutputs runKernels() {
+  // 1000 is not a multiple of the 64 bits of a mask word, nor of the SIMD widths
+  const int N = 1000;
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> uniform(-1, 1);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src(3, N);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst(3, N);
+  Eigen::RowVectorXd X(N);
+  Eigen::RowVectorXd ranges(N);
+  const Eigen::Matrix3d R =
+      Eigen::AngleAxisd(0.7, Eigen::Vector3d(1, 2, 3).normalized()).toRotationMatrix();
+  for (int i = 0; i < N; ++i) {
+    src.col(i) << uniform(rng), uniform(rng), uniform(rng);
+    dst.col(i) = R * src.col(i) * (1 + 0.2 * uniform(rng));
+    X(i) = i % 3 ? 2 + 0.01 * uniform(rng) : 5 * uniform(rng);
+    ranges(i) = 0.05 + 0.01 * uniform(rng);
+  }
+  Eigen::RowVectorXd weights = ranges.array().square().inverse();
+  // Centers at measurements, so that no consensus set is empty
+  Eigen::RowVectorXd centers = X.head(200);
+
+  KernelOutputs outputs;
+  outputs.mask.resize(teaser::kernels::numMaskWords(N));
+  teaser::kernels::scaleInliersMask(src.data(), dst.data(), 3, N, 0.1, outputs.mask.data());
+  outputs.tims.resize(3, N - 1);
+  teaser::kernels::timSegment(src.col(1).data(), 3, N - 1, src.col(0).data(),
+                              outputs.tims.data(), 3);
+  outputs.x_hat.resize(centers.cols());
+  outputs.x_cost.resize(centers.cols());
+  teaser::kernels::tlsConsensusSweep(X.data(), ranges.data(), weights.data(), N, centers.data(),
+                                     centers.cols(), outputs.x_hat.data(),
+                                     outputs.x_cost.data());
+  outputs.residuals_sq.resize(N);
+  teaser::kernels::squaredResiduals(R.data(), src.data(), 3, dst.data(), 3, N,
+                                    outputs.residuals_sq.data());
+  return outputs;
+}
+
+} // namespace
+
+TEST(KernelsTest, DispatchedVariantsMatchScalar) {
+  const auto best = teaser::kernels::bestSupportedISA();
+  EXPECT_EQ(teaser::kernels::activeISA(), best);
+  std::cout << "Best supported ISA: " << teaser::kernels::isaName(best) << std::endl;
+
+  teaser::kernels::setISA(teaser::kernels::ISA::SCALAR);
+  const auto expected = runKernels();
+
+  // Every variant the CPU can run. Summation orders differ, hence the tolerances.
+  for (int isa = 0; isa <= static_cast<int>(best); ++isa) {
+    teaser::kernels::setISA(static_cast<teaser::kernels::ISA>(isa));
+    SCOPED_TRACE(teaser::kernels::isaName(teaser::kernels::activeISA()));
+    const auto outputs = runKernels();
+    EXPECT_EQ(outputs.mask, expected.mask);
+    EXPECT_TRUE(outputs.tims.isApprox(expected.tims, 1e-15));
+    EXPECT_TRUE(outputs.x_hat.isApprox(expected.x_hat, 1e-12));
+    EXPECT_TRUE(outputs.x_cost.isApprox(expected.x_cost, 1e-12));
+    EXPECT_TRUE(outputs.residuals_sq.isApprox(expected.residuals_sq, 1e-12));
+  }
+  teaser::kernels::setISA(best);
+}
+
+TEST(KernelsTest, StridedColumns) {
+  // Columns 4 doubles apart, e.g., the top rows of a 4-by-N matrix
+  const int N = 100;
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> uniform(-1, 1);
+  Eigen::Matrix<double, 4, Eigen::Dynamic> src(4, N);
+  Eigen::Matrix<double, 4, Eigen::Dynamic> dst(4, N);
+  for (int i = 0; i < N; ++i) {
+    src.col(i) << uniform(rng), uniform(rng), uniform(rng), 0;
+    dst.col(i) << uniform(rng), uniform(rng), uniform(rng), 0;
+  }
+  const Eigen::Matrix3d R =
+      Eigen::AngleAxisd(-1.2, Eigen::Vector3d(0, 1, 1).normalized()).toRotationMatrix();
+
+  Eigen::Matrix<double, 4, Eigen::Dynamic> tims = Eigen::MatrixXd::Zero(4, N - 1);
+  teaser::kernels::timSegment(src.col(1).data(), 4, N - 1, src.col(0).data(), tims.data(), 4);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> expected_tims =
+      src.topRows<3>().rightCols(N - 1).colwise() - src.col(0).head<3>();
+  EXPECT_TRUE(tims.topRows<3>().isApprox(expected_tims));
+
+  Eigen::RowVectorXd residuals_sq(N);
+  teaser::kernels::squaredResiduals(R.data(), src.data(), 4, dst.data(), 4, N,
+                                    residuals_sq.data());
+  Eigen::RowVectorXd expected_residuals_sq =
+      (dst.topRows<3>() - R * src.topRows<3>()).colwise().squaredNorm();
+  EXPECT_TRUE(residuals_sq.isApprox(expected_residuals_sq));
+}
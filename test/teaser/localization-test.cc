@@ -0,0 +1,63 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "gtest/gtest.h"
+
+#include <Eigen/Geometry>
+
+#include <teaser/localization.h>
+#include <teaser/ply_io.h>
+
+TEST(LocalizationTest, LocalizeInMapTiles) {
+  teaser::PLYReader reader;
+  teaser::PointCloud object;
+  teaser::PointCloud distractor;
+  ASSERT_EQ(reader.read("./data/canstick.ply", object), 0);
+  ASSERT_EQ(reader.read("./data/matcher-test-object-1.ply", distractor), 0);
+
+  // Pose of the query frame in the map frame
+  Eigen::Matrix3d R = Eigen::AngleAxisd(0.7, Eigen::Vector3d(1, 2, 3).normalized()).matrix();
+  Eigen::Vector3d t(5, -2, 1);
+
+  // The query is the object in its own frame; the map contains the object at its pose
+  teaser::PointCloud tile;
+  for (const auto& p : object) {
+    Eigen::Vector3d q = R * Eigen::Vector3d(p.x, p.y, p.z) + t;
+    tile.push_back({static_cast<float>(q.x()), static_cast<float>(q.y()),
+                    static_cast<float>(q.z())});
+  }
+
+  teaser::LocalizationEngine::Params params;
+  params.solver_params.noise_bound = 0.01;
+  params.solver_params.estimate_scaling = false;
+  params.solver_params.rotation_estimation_algorithm =
+      teaser::RobustRegistrationSolver::ROTATION_ESTIMATION_ALGORITHM::GNC_TLS;
+  params.solver_params.rotation_cost_threshold = 1e-12;
+  teaser::LocalizationEngine engine(params);
+  EXPECT_EQ(engine.addTile(distractor), 0);
+  EXPECT_EQ(engine.addTile(tile), 1);
+  EXPECT_EQ(engine.numTiles(), 2);
+
+  auto result = engine.localize(object);
+  ASSERT_TRUE(result.valid);
+  EXPECT_EQ(result.tile, 1);
+  EXPECT_EQ(result.candidate_tiles.size(), result.candidate_inliers.size());
+  EXPECT_TRUE(result.solution.rotation.isApprox(R, 1e-3));
+  EXPECT_TRUE(result.solution.translation.isApprox(t, 1e-3));
+  EXPECT_GE(result.inliers.size(), 3);
+  for (const auto& i : result.inliers) {
+    ASSERT_LT(i, result.correspondences.size());
+  }
+
+  auto stats = engine.getStats();
+  EXPECT_EQ(stats.num_queries, 1);
+  EXPECT_GT(stats.total_time, 0);
+  EXPECT_DOUBLE_EQ(stats.getMeanLatency(), stats.total_time);
+  engine.resetStats();
+  EXPECT_EQ(engine.getStats().num_queries, 0);
+}
@@ -0,0 +1,116 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "teaser/pipeline.h"
+#include "teaser/registration.h"
+
+TEST(PipelineTest, SPSCQueue) {
+  teaser::SPSCQueue<int> queue(2);
+  int value = 1;
+  EXPECT_TRUE(queue.tryPush(std::move(value)));
+  value = 2;
+  EXPECT_TRUE(queue.tryPush(std::move(value)));
+  value = 3;
+  EXPECT_FALSE(queue.tryPush(std::move(value)));
+
+  int popped;
+  EXPECT_TRUE(queue.tryPop(&popped));
+  EXPECT_EQ(popped, 1);
+  EXPECT_TRUE(queue.tryPush(std::move(value)));
+  EXPECT_TRUE(queue.tryPop(&popped));
+  EXPECT_EQ(popped, 2);
+  EXPECT_TRUE(queue.tryPop(&popped));
+  EXPECT_EQ(popped, 3);
+  EXPECT_FALSE(queue.tryPop(&popped));
+}
+
+TEST(PipelineTest, MatchesSequentialSolves) {
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.01;
+  params.cbar2 = 1;
+  params.estimate_scaling = true;
+  params.rotation_max_iterations = 100;
+  params.rotation_gnc_factor = 1.4;
+  params.rotation_cost_threshold = 1e-12;
+
+  std::vector<teaser::RegistrationProblem> problems;
+  for (const int N : {30, 20, 45, 30, 25, 40}) {
+    Eigen::Matrix3d R =
+        Eigen::AngleAxisd(0.2 * problems.size(), Eigen::Vector3d(1, 2, 3).normalized())
+            .toRotationMatrix();
+    teaser::RegistrationProblem problem;
+    problem.src = Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, N);
+    problem.dst = (1.5 * R * problem.src).colwise() + Eigen::Vector3d(0.1, -0.2, 0.3);
+    problem.dst.col(0) += Eigen::Vector3d(1, 2, 3);
+    problem.dst.col(N - 1) -= Eigen::Vector3d(2, 0, 1);
+    problems.push_back(problem);
+  }
+
+  teaser::RegistrationPipeline::Params pipeline_params;
+  pipeline_params.queue_capacity = 1;
+  teaser::RegistrationPipeline pipeline(params, pipeline_params);
+
+  // Keep popping while pushing, as a streaming caller would
+  std::vector<teaser::RegistrationPipeline::Result> results;
+  teaser::RegistrationPipeline::Result result;
+  for (const auto& problem : problems) {
+    pipeline.push(problem);
+    while (pipeline.tryPop(&result)) {
+      results.push_back(result);
+    }
+  }
+  while (pipeline.pop(&result)) {
+    results.push_back(result);
+  }
+  EXPECT_EQ(pipeline.numInFlight(), 0);
+  EXPECT_FALSE(pipeline.tryPop(&result));
+
+  ASSERT_EQ(results.size(), problems.size());
+  for (size_t i = 0; i < problems.size(); ++i) {
+    teaser::RobustRegistrationSolver solver(params);
+    auto expected = solver.solve(problems[i].src, problems[i].dst);
+    EXPECT_TRUE(results[i].solution.valid);
+    EXPECT_NEAR(results[i].solution.scale, expected.scale, 1e-12);
+    EXPECT_TRUE(results[i].solution.rotation.isApprox(expected.rotation, 1e-9));
+    EXPECT_TRUE(results[i].solution.translation.isApprox(expected.translation, 1e-9));
+    EXPECT_EQ(results[i].inliers, solver.getTranslationInliers());
+    EXPECT_EQ(results[i].stats.num_measurements, problems[i].src.cols());
+    EXPECT_EQ(results[i].stats.clique_size, solver.getStats().clique_size);
+  }
+}
+
+TEST(PipelineTest, WakesUpWhenIdle) {
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.01;
+  teaser::RegistrationPipeline pipeline(params);
+
+  // Let both stages run out of spins and block on the empty queues
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  Eigen::Matrix3d R = Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  teaser::RegistrationProblem problem;
+  problem.src = Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, 20);
+  problem.dst = (R * problem.src).colwise() + Eigen::Vector3d(1, 0, 0);
+  pipeline.push(problem);
+
+  teaser::RegistrationPipeline::Result result;
+  ASSERT_TRUE(pipeline.pop(&result));
+  EXPECT_TRUE(result.solution.valid);
+  EXPECT_TRUE(result.solution.rotation.isApprox(R, 1e-6));
+
+  // The blocked stages are woken up by the destructor
+}
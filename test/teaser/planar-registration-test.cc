@@ -0,0 +1,100 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <random>
+
+#include <Eigen/Core>
+
+#include "teaser/planar_registration.h"
+
+TEST(PlanarRegistrationTest, KnownScale) {
+  std::uniform_real_distribution<double> unif(0, 2 * M_PI);
+  std::default_random_engine re;
+
+  int N = 40;
+  Eigen::Matrix<double, 2, Eigen::Dynamic> src =
+      Eigen::Matrix<double, 2, Eigen::Dynamic>::Random(2, N);
+  double theta = unif(re);
+  Eigen::Matrix2d R;
+  R << std::cos(theta), -std::sin(theta), std::sin(theta), std::cos(theta);
+  Eigen::Vector2d t(0.3, -0.7);
+  Eigen::Matrix<double, 2, Eigen::Dynamic> dst = (R * src).colwise() + t;
+
+  // Corrupt a quarter of the measurements
+  for (int i = 0; i < N / 4; ++i) {
+    dst.col(i) = 5 * Eigen::Vector2d::Random();
+  }
+
+  teaser::PlanarRegistrationSolver::Params params;
+  params.noise_bound = 0.01;
+  params.estimate_scaling = false;
+  params.rotation_cost_threshold = 1e-12;
+  teaser::PlanarRegistrationSolver solver(params);
+  auto solution = solver.solve(src, dst);
+
+  EXPECT_TRUE(solution.valid);
+  EXPECT_NEAR(solution.scale, 1, 1e-9);
+  EXPECT_LT((solution.rotation - R).norm(), 1e-6);
+  EXPECT_LT((solution.translation - t).norm(), 1e-6);
+
+  auto inliers = solver.getTranslationInliers();
+  EXPECT_EQ(inliers.size(), N - N / 4);
+  for (const auto& i : inliers) {
+    EXPECT_GE(i, N / 4);
+  }
+}
+
+TEST(PlanarRegistrationTest, UnknownScale) {
+  int N = 30;
+  Eigen::Matrix<double, 2, Eigen::Dynamic> src =
+      Eigen::Matrix<double, 2, Eigen::Dynamic>::Random(2, N);
+  double theta = 1.2;
+  double s = 1.7;
+  Eigen::Matrix2d R;
+  R << std::cos(theta), -std::sin(theta), std::sin(theta), std::cos(theta);
+  Eigen::Vector2d t(-1, 2);
+  Eigen::Matrix<double, 2, Eigen::Dynamic> dst = (s * R * src).colwise() + t;
+
+  teaser::PlanarRegistrationSolver::Params params;
+  params.noise_bound = 0.01;
+  params.estimate_scaling = true;
+  params.rotation_cost_threshold = 1e-12;
+  teaser::PlanarRegistrationSolver solver(params);
+  auto solution = solver.solve(src, dst);
+
+  EXPECT_TRUE(solution.valid);
+  EXPECT_NEAR(solution.scale, s, 1e-3);
+  EXPECT_LT((solution.rotation - R).norm(), 1e-3);
+  EXPECT_LT((solution.translation - t).norm(), 1e-2);
+}
+
+TEST(PlanarRegistrationTest, Cancellation) {
+  int N = 30;
+  Eigen::Matrix<double, 2, Eigen::Dynamic> src =
+      Eigen::Matrix<double, 2, Eigen::Dynamic>::Random(2, N);
+  Eigen::Matrix<double, 2, Eigen::Dynamic> dst = src.colwise() + Eigen::Vector2d(0.3, -0.7);
+
+  teaser::PlanarRegistrationSolver::Params params;
+  params.noise_bound = 0.01;
+  params.cancellation_token = std::make_shared<teaser::CancellationToken>();
+  params.cancellation_token->cancel();
+  teaser::PlanarRegistrationSolver solver(params);
+  auto solution = solver.solve(src, dst);
+  EXPECT_FALSE(solution.valid);
+  EXPECT_TRUE(solution.cancelled);
+
+  // The same solver completes once the token is reset
+  params.cancellation_token->reset();
+  solution = solver.solve(src, dst);
+  EXPECT_TRUE(solution.valid);
+  EXPECT_FALSE(solution.cancelled);
+  EXPECT_LT((solution.translation - Eigen::Vector2d(0.3, -0.7)).norm(), 1e-6);
+}
@@ -11,6 +11,7 @@
 #include <chrono>
 #include <fstream>
 #include <random>
+#include <thread>
 
 #include "gtest/gtest.h"
 
@@ -18,6 +19,32 @@
 #include "teaser/ply_io.h"
 #include "test_utils.h"
 
+namespace {
+
+/**
+ * Translation solver written against the original interface, taking matrices by const reference.
+ * It does not override solveForTranslationView(), which copies the views by default.
+ */
+class LegacyTranslationSolver : public teaser::AbstractTranslationSolver {
+public:
+  LegacyTranslationSolver(double noise_bound, int* num_calls)
+      : solver_(noise_bound, 1), num_calls_(num_calls) {}
+
+  void solveForTranslation(const Eigen::Matrix<double, 3, Eigen::Dynamic>& src,
+                           const Eigen::Matrix<double, 3, Eigen::Dynamic>& dst,
+                           Eigen::Vector3d* translation,
+                           Eigen::Matrix<bool, 1, Eigen::Dynamic>* inliers) override {
+    ++*num_calls_;
+    solver_.solveForTranslation(src, dst, translation, inliers);
+  }
+
+private:
+  teaser::TLSTranslationSolver solver_;
+  int* num_calls_;
+};
+
+} // namespace
+
 TEST(RegistrationTest, LargeModel) {
 
   std::string model_file = "./data/registration_test/1000point_model.ply";
@@ -555,3 +582,636 @@ TEST(RegistrationTest, CliqueFinderModes) {
     EXPECT_LE((T.topRightCorner(3, 1) - solution.translation).norm(), 0.1);
   }
 }
+
+TEST(RegistrationTest, MultiHypothesis) {
+  // Two groups of correspondences, each consistent with a different rigid transformation
+  int N1 = 20;
+  int N2 = 12;
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src =
+      Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, N1 + N2);
+
+  Eigen::Matrix3d R1 = Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  Eigen::Vector3d t1(0.1, -0.2, 0.3);
+  Eigen::Matrix3d R2 =
+      Eigen::AngleAxisd(2.1, Eigen::Vector3d(1, 1, 0).normalized()).toRotationMatrix();
+  Eigen::Vector3d t2(-1, 0.5, 2);
+
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst(3, N1 + N2);
+  dst.leftCols(N1) = (R1 * src.leftCols(N1)).colwise() + t1;
+  dst.rightCols(N2) = (R2 * src.rightCols(N2)).colwise() + t2;
+
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.001;
+  params.cbar2 = 1;
+  params.estimate_scaling = false;
+  params.rotation_max_iterations = 100;
+  params.rotation_gnc_factor = 1.4;
+  params.rotation_cost_threshold = 1e-12;
+  teaser::RobustRegistrationSolver solver(params);
+
+  auto hypotheses = solver.solveMultiHypothesis(src, dst, 3);
+  ASSERT_EQ(hypotheses.size(), 2);
+
+  EXPECT_EQ(hypotheses[0].translation_inliers.size(), N1);
+  EXPECT_LE(teaser::test::getAngularError(R1, hypotheses[0].solution.rotation), 1e-5);
+  EXPECT_LE((t1 - hypotheses[0].solution.translation).norm(), 1e-5);
+
+  EXPECT_EQ(hypotheses[1].translation_inliers.size(), N2);
+  EXPECT_LE(teaser::test::getAngularError(R2, hypotheses[1].solution.rotation), 1e-5);
+  EXPECT_LE((t2 - hypotheses[1].solution.translation).norm(), 1e-5);
+
+  // The getters reflect the best hypothesis
+  auto solution = solver.getSolution();
+  EXPECT_TRUE(solution.valid);
+  EXPECT_LE(teaser::test::getAngularError(R1, solution.rotation), 1e-5);
+  EXPECT_EQ(solver.getTranslationInliers().size(), N1);
+}
+
+TEST(RegistrationTest, RepeatedSolves) {
+  // Solving problems of different sizes with the same solver reuses its buffers, which should not
+  // affect the results
+  Eigen::Matrix3d R =
+      Eigen::AngleAxisd(0.7, Eigen::Vector3d(1, 2, 0).normalized()).toRotationMatrix();
+  Eigen::Vector3d t(0.3, -0.1, 0.5);
+
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.001;
+  params.cbar2 = 1;
+  params.estimate_scaling = false;
+  params.rotation_max_iterations = 100;
+  params.rotation_gnc_factor = 1.4;
+  params.rotation_cost_threshold = 1e-12;
+  teaser::RobustRegistrationSolver solver(params);
+  solver.reserve(25);
+
+  for (const int N : {25, 15, 40, 25}) {
+    Eigen::Matrix<double, 3, Eigen::Dynamic> src =
+        Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, N);
+    Eigen::Matrix<double, 3, Eigen::Dynamic> dst = (R * src).colwise() + t;
+    // Two outliers
+    dst.col(0) += Eigen::Vector3d(1, 2, 3);
+    dst.col(N - 1) -= Eigen::Vector3d(2, 0, 1);
+
+    auto solution = solver.solve(src, dst);
+    EXPECT_TRUE(solution.valid);
+    EXPECT_LE(teaser::test::getAngularError(R, solution.rotation), 1e-5);
+    EXPECT_LE((t - solution.translation).norm(), 1e-5);
+    EXPECT_EQ(solver.getTranslationInliers().size(), N - 2);
+
+    // The TIMs and their map match the ones computed from scratch
+    Eigen::Matrix<int, 2, Eigen::Dynamic> src_map;
+    Eigen::Matrix<int, 2, Eigen::Dynamic> dst_map;
+    auto src_tims = solver.computeTIMs(src, &src_map);
+    auto dst_tims = solver.computeTIMs(dst, &dst_map);
+    ASSERT_EQ(solver.getSrcTIMs().cols(), N * (N - 1) / 2);
+    EXPECT_TRUE(solver.getSrcTIMs() == src_tims);
+    EXPECT_TRUE(solver.getDstTIMs() == dst_tims);
+    EXPECT_TRUE(solver.getSrcTIMsMap() == src_map);
+    EXPECT_TRUE(solver.getDstTIMsMap() == dst_map);
+    EXPECT_EQ(solver.getMaxCliqueSrcTIMs().cols(), N - 2);
+  }
+}
+
+TEST(RegistrationTest, LegacySolverInterface) {
+  // Solvers implemented in the const Matrix& overloads are still called by the registration solver
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> uniform(-1, 1);
+  const int N = 30;
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src(3, N);
+  for (int i = 0; i < N; ++i) {
+    src.col(i) << uniform(rng), uniform(rng), uniform(rng);
+  }
+  Eigen::Matrix3d R =
+      Eigen::AngleAxisd(0.4, Eigen::Vector3d(0, 1, 2).normalized()).toRotationMatrix();
+  Eigen::Vector3d t(-0.2, 0.6, 0.1);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst = (R * src).colwise() + t;
+
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.001;
+  params.estimate_scaling = false;
+  teaser::RobustRegistrationSolver solver(params);
+  int num_calls = 0;
+  solver.setTranslationEstimator(
+      std::make_unique<LegacyTranslationSolver>(params.noise_bound, &num_calls));
+
+  auto solution = solver.solve(src, dst);
+  EXPECT_EQ(num_calls, 1);
+  EXPECT_TRUE(solution.valid);
+  EXPECT_LE(teaser::test::getAngularError(R, solution.rotation), 1e-5);
+  EXPECT_LE((t - solution.translation).norm(), 1e-5);
+}
+
+TEST(RegistrationTest, SolveBatch) {
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.001;
+  params.cbar2 = 1;
+  params.estimate_scaling = false;
+  params.rotation_max_iterations = 100;
+  params.rotation_gnc_factor = 1.4;
+  params.rotation_cost_threshold = 1e-12;
+  // Make the largest problems go through the cooperative path
+  params.batch_cooperative_size = 40;
+
+  std::vector<teaser::RegistrationProblem> problems;
+  std::vector<Eigen::Matrix3d> rotations;
+  std::vector<Eigen::Vector3d> translations;
+  for (const int N : {20, 45, 10, 30, 40, 15, 25}) {
+    Eigen::Matrix3d R =
+        Eigen::AngleAxisd(0.1 * N, Eigen::Vector3d(1, -1, 2).normalized()).toRotationMatrix();
+    Eigen::Vector3d t = Eigen::Vector3d::Random();
+    teaser::RegistrationProblem problem;
+    problem.src = Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, N);
+    problem.dst = (R * problem.src).colwise() + t;
+    problem.dst.col(N / 2) += Eigen::Vector3d(3, 2, 1); // one outlier
+    problems.push_back(problem);
+    rotations.push_back(R);
+    translations.push_back(t);
+  }
+
+  teaser::RobustRegistrationSolver solver(params);
+  auto solutions = solver.solveBatch(problems);
+  ASSERT_EQ(solutions.size(), problems.size());
+  for (size_t i = 0; i < problems.size(); ++i) {
+    EXPECT_TRUE(solutions[i].valid);
+    EXPECT_LE(teaser::test::getAngularError(rotations[i], solutions[i].rotation), 1e-5);
+    EXPECT_LE((translations[i] - solutions[i].translation).norm(), 1e-5);
+
+    // Same as solving the problem on its own
+    teaser::RobustRegistrationSolver single_solver(params);
+    auto solution = single_solver.solve(problems[i].src, problems[i].dst);
+    EXPECT_LE((solution.rotation - solutions[i].rotation).norm(), 1e-9);
+    EXPECT_LE((solution.translation - solutions[i].translation).norm(), 1e-9);
+  }
+}
+
+TEST(RegistrationTest, Stats) {
+  const int N = 30;
+  const int N_OUTLIERS = 3;
+  Eigen::Matrix3d R = Eigen::AngleAxisd(1.1, Eigen::Vector3d::UnitY()).toRotationMatrix();
+  Eigen::Vector3d t(1, 2, 3);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src =
+      Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, N);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst = (R * src).colwise() + t;
+  for (int i = 0; i < N_OUTLIERS; ++i) {
+    dst.col(i) += Eigen::Vector3d(5, 5 + i, 5 - i);
+  }
+
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.001;
+  params.estimate_scaling = false;
+  params.rotation_cost_threshold = 1e-12;
+  teaser::RobustRegistrationSolver solver(params);
+  solver.solve(src, dst);
+
+  auto stats = solver.getStats();
+  EXPECT_EQ(stats.num_measurements, N);
+  EXPECT_EQ(stats.num_tims, N * (N - 1) / 2);
+  EXPECT_EQ(stats.num_edges, solver.getScaleInliers().size());
+  EXPECT_NEAR(stats.graph_density, static_cast<double>(stats.num_edges) / stats.num_tims, 1e-12);
+  EXPECT_EQ(stats.clique_size, N - N_OUTLIERS);
+  EXPECT_GE(stats.max_core + 1, stats.clique_size);
+  EXPECT_GT(stats.rotation_iterations, 0);
+  EXPECT_EQ(stats.rotation_iterations, solver.getGNCRotationIterationsAtTermination());
+  EXPECT_EQ(stats.num_rotation_inliers, solver.getRotationInliers().size());
+  EXPECT_EQ(stats.num_translation_inliers, N - N_OUTLIERS);
+  for (double time : {stats.tims_time, stats.scale_time, stats.graph_time, stats.clique_time,
+                      stats.rotation_time, stats.translation_time}) {
+    EXPECT_GE(time, 0);
+  }
+}
+
+TEST(RegistrationTest, Cancellation) {
+  const int N = 30;
+  Eigen::Matrix3d R = Eigen::AngleAxisd(0.7, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  Eigen::Vector3d t(1, -2, 3);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src =
+      Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, N);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst = (R * src).colwise() + t;
+
+  auto token = std::make_shared<teaser::CancellationToken>();
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.001;
+  params.estimate_scaling = false;
+  params.cancellation_token = token;
+  teaser::RobustRegistrationSolver solver(params);
+
+  // Explicit cancellation and an expired deadline stop the solve at the first stage
+  token->cancel();
+  auto solution = solver.solve(src, dst);
+  EXPECT_FALSE(solution.valid);
+  EXPECT_TRUE(solution.cancelled);
+  EXPECT_EQ(solution.stage, teaser::RegistrationSolution::STAGE::TIMS);
+  token->reset();
+  token->setTimeout(0);
+  solution = solver.solve(src, dst);
+  EXPECT_TRUE(solution.cancelled);
+  EXPECT_EQ(solution.stage, teaser::RegistrationSolution::STAGE::TIMS);
+  EXPECT_TRUE(solver.solveMultiHypothesis(src, dst, 2).empty());
+  EXPECT_TRUE(solver.getSolution().cancelled);
+
+  // Once reset, the same solver solves normally
+  token->reset();
+  token->setTimeout(60);
+  solution = solver.solve(src, dst);
+  EXPECT_TRUE(solution.valid);
+  EXPECT_FALSE(solution.cancelled);
+  EXPECT_EQ(solution.stage, teaser::RegistrationSolution::STAGE::DONE);
+  EXPECT_TRUE(solution.rotation.isApprox(R, 1e-6));
+
+  // A cancelled GNC-TLS solver stops after its first iteration
+  teaser::GNCTLSRotationSolver::Params gnc_params{100, 1e-12, 1.4, 0.01};
+  gnc_params.cancellation_token = token;
+  teaser::GNCTLSRotationSolver gnc_solver(gnc_params);
+  token->cancel();
+  Eigen::Matrix3d R_est;
+  gnc_solver.solveForRotation(src, R * src, &R_est, nullptr);
+  EXPECT_EQ(gnc_solver.getIterationsAtTermination(), 1);
+  EXPECT_TRUE(R_est.isApprox(R, 1e-6));
+
+  // An expired deadline stops the solve like a cancelled token
+  token->reset();
+  token->setTimeout(0);
+  solution = solver.solve(src, dst);
+  EXPECT_FALSE(solution.valid);
+  EXPECT_TRUE(solution.cancelled);
+  EXPECT_EQ(solution.stage, teaser::RegistrationSolution::STAGE::TIMS);
+}
+
+TEST(RegistrationTest, IndexedSolve) {
+  const int NUM_POINTS = 40;
+  const int N = 25;
+  Eigen::Matrix3d R =
+      Eigen::AngleAxisd(0.9, Eigen::Vector3d(1, 1, 0).normalized()).toRotationMatrix();
+  Eigen::Vector3d t(-1, 0.5, 2);
+
+  // Points stored as xyz plus one float of padding
+  Eigen::Matrix<float, 4, Eigen::Dynamic> src_points(4, NUM_POINTS);
+  Eigen::Matrix<float, 4, Eigen::Dynamic> dst_points(4, NUM_POINTS);
+  src_points.setRandom();
+  dst_points.topRows<3>() =
+      ((R * src_points.topRows<3>().cast<double>()).colwise() + t).cast<float>();
+  dst_points.row(3).setZero();
+
+  // Correspondences between shuffled subsets of the points
+  Eigen::VectorXi src_indices(N);
+  Eigen::VectorXi dst_indices(N);
+  teaser::PointCloud src_cloud;
+  teaser::PointCloud dst_cloud;
+  std::vector<std::pair<int, int>> correspondences;
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src(3, N);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst(3, N);
+  for (int i = 0; i < NUM_POINTS; ++i) {
+    src_cloud.push_back({src_points(0, i), src_points(1, i), src_points(2, i)});
+    dst_cloud.push_back({dst_points(0, i), dst_points(1, i), dst_points(2, i)});
+  }
+  for (int i = 0; i < N; ++i) {
+    src_indices(i) = (7 * i + 3) % NUM_POINTS;
+    dst_indices(i) = src_indices(i);
+    correspondences.emplace_back(src_indices(i), dst_indices(i));
+    src.col(i) = src_points.col(src_indices(i)).head<3>().cast<double>();
+    dst.col(i) = dst_points.col(dst_indices(i)).head<3>().cast<double>();
+  }
+
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.001;
+  params.estimate_scaling = false;
+  teaser::RobustRegistrationSolver solver(params);
+  auto expected = solver.solve(src, dst);
+  ASSERT_TRUE(expected.valid);
+  EXPECT_TRUE(expected.rotation.isApprox(R, 1e-5));
+
+  auto expectSameSolution = [&expected](const teaser::RegistrationSolution& solution) {
+    EXPECT_TRUE(solution.valid);
+    EXPECT_TRUE(solution.rotation.isApprox(expected.rotation, 1e-12));
+    EXPECT_TRUE(solution.translation.isApprox(expected.translation, 1e-12));
+  };
+
+  // Strided float views with index vectors
+  Eigen::Map<const Eigen::Matrix<float, 3, Eigen::Dynamic>, 0, Eigen::OuterStride<>> src_view(
+      src_points.data(), 3, NUM_POINTS, Eigen::OuterStride<>(4));
+  Eigen::Map<const Eigen::Matrix<float, 3, Eigen::Dynamic>, 0, Eigen::OuterStride<>> dst_view(
+      dst_points.data(), 3, NUM_POINTS, Eigen::OuterStride<>(4));
+  expectSameSolution(solver.solve(src_view, dst_view, src_indices, dst_indices));
+
+  // Raw pointers
+  expectSameSolution(solver.solve(src_points.data(), dst_points.data(), 4, src_indices.data(),
+                                  dst_indices.data(), N));
+
+  // Point clouds
+  expectSameSolution(solver.solve(src_cloud, dst_cloud, correspondences));
+}
+
+TEST(RegistrationTest, DenseInlierGraph) {
+  const int N = 60;
+  const int N_OUTLIERS = 2;
+  Eigen::Matrix3d R = Eigen::AngleAxisd(-0.4, Eigen::Vector3d::UnitX()).toRotationMatrix();
+  Eigen::Vector3d t(0.3, 0.2, -1);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src =
+      Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, N);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst = (R * src).colwise() + t;
+  for (int i = 0; i < N_OUTLIERS; ++i) {
+    dst.col(10 * i) += Eigen::Vector3d(3, -2 + i, 4);
+  }
+
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.001;
+  params.estimate_scaling = false;
+  params.dense_graph_threshold = 2;
+  teaser::RobustRegistrationSolver pmc_solver(params);
+  pmc_solver.solve(src, dst);
+
+  // The inlier graph is near-complete, so the clique is found without PMC
+  params.dense_graph_threshold = 0.9;
+  teaser::RobustRegistrationSolver solver(params);
+  auto solution = solver.solve(src, dst);
+  EXPECT_GE(solver.getStats().graph_density, 0.9);
+  EXPECT_EQ(solver.getStats().max_core, -1);
+  EXPECT_TRUE(solution.valid);
+  EXPECT_EQ(solver.getInlierMaxClique(), pmc_solver.getInlierMaxClique());
+  EXPECT_EQ(solver.getInlierMaxClique().size(), N - N_OUTLIERS);
+  EXPECT_TRUE(solution.rotation.isApprox(R, 1e-6));
+  EXPECT_TRUE(solution.translation.isApprox(t, 1e-6));
+}
+
+TEST(RegistrationTest, SampledInlierGraph) {
+  const int N = 2000;
+  const int N_OUTLIERS = 200;
+  const int SAMPLE_SIZE = 300;
+  std::default_random_engine re(3);
+  std::uniform_real_distribution<double> unif(-1, 1);
+  Eigen::Matrix3d R =
+      Eigen::AngleAxisd(2.1, Eigen::Vector3d(0, 1, 1).normalized()).toRotationMatrix();
+  Eigen::Vector3d t(-0.5, 1, 0.25);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src =
+      Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, N);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst = (R * src).colwise() + t;
+  for (int i = 0; i < N; ++i) {
+    dst.col(i) += 0.0005 * Eigen::Vector3d(unif(re), unif(re), unif(re));
+  }
+  for (int i = 0; i < N_OUTLIERS; ++i) {
+    dst.col(i * N / N_OUTLIERS) = 3 * Eigen::Vector3d(unif(re), unif(re), unif(re));
+  }
+
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.002;
+  params.estimate_scaling = false;
+  params.inlier_graph_sample_size = SAMPLE_SIZE;
+  teaser::RobustRegistrationSolver solver(params);
+  auto solution = solver.solve(src, dst);
+
+  EXPECT_TRUE(solution.valid);
+  EXPECT_EQ(solver.getSampleIndices().size(), SAMPLE_SIZE);
+  EXPECT_EQ(solver.getStats().num_tims, SAMPLE_SIZE * (SAMPLE_SIZE - 1) / 2);
+  EXPECT_TRUE(solution.rotation.isApprox(R, 1e-3));
+  EXPECT_TRUE(solution.translation.isApprox(t, 1e-3));
+
+  // The verification phase recovers (nearly) all inliers and no outlier
+  const auto clique = solver.getInlierMaxClique();
+  EXPECT_GE(clique.size(), 0.99 * (N - N_OUTLIERS));
+  for (const auto& i : clique) {
+    EXPECT_NE(i % (N / N_OUTLIERS), 0);
+  }
+}
+
+TEST(RegistrationTest, RepeatedSolvesRotationNoiseBound) {
+  // The rotation noise bound depends on the estimated scale; it must not compound when the same
+  // problem is solved again
+  Eigen::Matrix3d R =
+      Eigen::AngleAxisd(0.4, Eigen::Vector3d(0, 1, 1).normalized()).toRotationMatrix();
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src = Eigen::Matrix<double, 3, 40>::Random();
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst =
+      (0.5 * R * src).colwise() + Eigen::Vector3d(1, 0, 0);
+  dst += 0.002 * Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, 40);
+  dst.col(3) += Eigen::Vector3d(0.5, -0.5, 0.2);
+
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.01;
+  params.estimate_scaling = true;
+  teaser::RobustRegistrationSolver solver(params);
+  auto first = solver.solve(src, dst);
+  auto first_stats = solver.getStats();
+  for (int i = 0; i < 3; ++i) {
+    auto solution = solver.solve(src, dst);
+    EXPECT_EQ(solution.rotation, first.rotation);
+    EXPECT_EQ(solution.translation, first.translation);
+    EXPECT_EQ(solver.getStats().rotation_iterations, first_stats.rotation_iterations);
+    EXPECT_EQ(solver.getParams().inlier_selection_mode, params.inlier_selection_mode);
+  }
+}
+
+TEST(RegistrationTest, ConcurrentConstSolves) {
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.01;
+  params.estimate_scaling = true;
+  params.rotation_max_iterations = 100;
+  params.rotation_gnc_factor = 1.4;
+  params.rotation_cost_threshold = 1e-12;
+  // Deprecated params are handled without modifying the shared params
+  params.max_clique_exact_solution = false;
+  const teaser::RobustRegistrationSolver solver(params);
+
+  std::vector<teaser::RegistrationProblem> problems;
+  for (int k = 0; k < 8; ++k) {
+    const int N = 20 + 5 * k;
+    Eigen::Matrix3d R =
+        Eigen::AngleAxisd(0.3 * k, Eigen::Vector3d(1, 2, 3).normalized()).toRotationMatrix();
+    teaser::RegistrationProblem problem;
+    problem.src = Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, N);
+    problem.dst = (1.2 * R * problem.src).colwise() + Eigen::Vector3d::Random();
+    problem.dst.col(N / 2) += Eigen::Vector3d(2, 1, -1); // one outlier
+    problems.push_back(problem);
+  }
+
+  // Each thread solves every other problem with its own context, twice
+  std::vector<teaser::RegistrationSolution> solutions(problems.size());
+  std::vector<std::vector<int>> inliers(problems.size());
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 2; ++t) {
+    threads.emplace_back([&, t]() {
+      teaser::RegistrationContext context;
+      for (int repeat = 0; repeat < 2; ++repeat) {
+        for (size_t i = t; i < problems.size(); i += 2) {
+          solutions[i] = solver.solve(problems[i].src, problems[i].dst, &context);
+          inliers[i] = context.getTranslationInliers();
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (size_t i = 0; i < problems.size(); ++i) {
+    teaser::RobustRegistrationSolver single_solver(params);
+    auto solution = single_solver.solve(problems[i].src, problems[i].dst);
+    EXPECT_TRUE(solutions[i].valid);
+    EXPECT_EQ(solutions[i].rotation, solution.rotation);
+    EXPECT_EQ(solutions[i].translation, solution.translation);
+    EXPECT_EQ(inliers[i], single_solver.getTranslationInliers());
+    EXPECT_EQ(inliers[i].size(), static_cast<size_t>(problems[i].src.cols() - 1));
+  }
+}
+
+TEST(RegistrationTest, NoiseBoundSweep) {
+  const int N = 60;
+  Eigen::Matrix3d R =
+      Eigen::AngleAxisd(1.1, Eigen::Vector3d(-1, 2, 1).normalized()).toRotationMatrix();
+  Eigen::Vector3d t(0.5, 0.2, -0.3);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src = Eigen::Matrix<double, 3, N>::Random();
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst = (R * src).colwise() + t;
+  dst += 0.002 * Eigen::Matrix<double, 3, N>::Random();
+  for (int i = 0; i < N; i += 6) {
+    dst.col(i) += Eigen::Vector3d::Random(); // outliers
+  }
+  const std::vector<double> noise_bounds{0.01, 0.003, 0.005, 0.05};
+
+  for (const bool estimate_scaling : {false, true}) {
+    teaser::RobustRegistrationSolver::Params params;
+    params.cbar2 = 1;
+    params.estimate_scaling = estimate_scaling;
+    params.rotation_max_iterations = 100;
+    params.rotation_gnc_factor = 1.4;
+    params.rotation_cost_threshold = 1e-12;
+    teaser::RobustRegistrationSolver solver(params);
+    auto hypotheses = solver.solveNoiseBoundSweep(src, dst, noise_bounds);
+    ASSERT_EQ(hypotheses.size(), noise_bounds.size());
+    EXPECT_EQ(solver.getStats().num_tims, N * (N - 1) / 2);
+
+    for (size_t b = 0; b < noise_bounds.size(); ++b) {
+      // Same as solving at this noise bound on its own
+      params.noise_bound = noise_bounds[b];
+      teaser::RobustRegistrationSolver single_solver(params);
+      auto solution = single_solver.solve(src, dst);
+      EXPECT_EQ(hypotheses[b].solution.valid, solution.valid);
+      EXPECT_EQ(hypotheses[b].clique.size(), single_solver.getInlierMaxClique().size());
+      if (solution.valid) {
+        EXPECT_NEAR(hypotheses[b].solution.scale, solution.scale, 1e-12);
+        EXPECT_LE((hypotheses[b].solution.rotation - solution.rotation).norm(), 1e-9);
+        EXPECT_LE((hypotheses[b].solution.translation - solution.translation).norm(), 1e-9);
+      }
+    }
+
+    // Nested inlier graphs: clique sizes do not decrease with the noise bound
+    EXPECT_LE(hypotheses[1].clique.size(), hypotheses[2].clique.size());
+    EXPECT_LE(hypotheses[2].clique.size(), hypotheses[0].clique.size());
+    EXPECT_TRUE(hypotheses[0].solution.valid);
+    EXPECT_EQ(hypotheses[0].translation_inliers.size(), N - N / 6);
+    EXPECT_LE(teaser::test::getAngularError(R, hypotheses[0].solution.rotation), 0.01);
+  }
+}
+
+TEST(RegistrationTest, NoiseBoundSweepScaleWithoutInlierSelection) {
+  const int N = 30;
+  const double scale = 1.7;
+  Eigen::Matrix3d R =
+      Eigen::AngleAxisd(0.6, Eigen::Vector3d(1, 0, 2).normalized()).toRotationMatrix();
+  Eigen::Vector3d t(-0.4, 0.1, 0.8);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src = Eigen::Matrix<double, 3, N>::Random();
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst = (scale * R * src).colwise() + t;
+  const std::vector<double> noise_bounds{0.05, 0.01};
+
+  teaser::RobustRegistrationSolver::Params params;
+  params.cbar2 = 1;
+  params.estimate_scaling = true;
+  params.inlier_selection_mode = teaser::RobustRegistrationSolver::INLIER_SELECTION_MODE::NONE;
+  params.rotation_max_iterations = 100;
+  params.rotation_gnc_factor = 1.4;
+  params.rotation_cost_threshold = 1e-12;
+  teaser::RobustRegistrationSolver solver(params);
+  auto hypotheses = solver.solveNoiseBoundSweep(src, dst, noise_bounds);
+  ASSERT_EQ(hypotheses.size(), noise_bounds.size());
+
+  for (size_t b = 0; b < noise_bounds.size(); ++b) {
+    // The scale is estimated as by solve(), even though all measurements are kept
+    params.noise_bound = noise_bounds[b];
+    teaser::RobustRegistrationSolver single_solver(params);
+    auto solution = single_solver.solve(src, dst);
+    ASSERT_TRUE(solution.valid);
+    EXPECT_TRUE(hypotheses[b].solution.valid);
+    EXPECT_EQ(hypotheses[b].clique.size(), static_cast<size_t>(N));
+    EXPECT_NEAR(hypotheses[b].solution.scale, scale, 1e-6);
+    EXPECT_NEAR(hypotheses[b].solution.scale, solution.scale, 1e-12);
+    EXPECT_LE((hypotheses[b].solution.rotation - solution.rotation).norm(), 1e-9);
+    EXPECT_LE((hypotheses[b].solution.translation - solution.translation).norm(), 1e-9);
+    EXPECT_TRUE(hypotheses[b].solution.rotation.isApprox(R, 1e-6));
+    EXPECT_TRUE(hypotheses[b].solution.translation.isApprox(t, 1e-6));
+  }
+}
+
+TEST(RegistrationTest, PreparedSource) {
+  const int N = 40;
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src = Eigen::Matrix<double, 3, N>::Random();
+  auto source = teaser::RobustRegistrationSolver::prepareSource(src);
+  ASSERT_EQ(source.tim_norms.cols(), N * (N - 1) / 2);
+  Eigen::Matrix<int, 2, Eigen::Dynamic> map;
+  auto src_tims = teaser::RobustRegistrationSolver().computeTIMs(src, &map);
+  EXPECT_TRUE(source.tim_norms.isApprox(src_tims.colwise().norm(), 1e-12));
+
+  for (const bool estimate_scaling : {false, true}) {
+    teaser::RobustRegistrationSolver::Params params;
+    params.noise_bound = 0.01;
+    params.cbar2 = 1;
+    params.estimate_scaling = estimate_scaling;
+    params.rotation_max_iterations = 100;
+    params.rotation_gnc_factor = 1.4;
+    params.rotation_cost_threshold = 1e-12;
+    teaser::RobustRegistrationSolver solver(params);
+
+    // The source stays fixed while the target changes every frame
+    for (int frame = 0; frame < 3; ++frame) {
+      Eigen::Matrix3d R =
+          Eigen::AngleAxisd(0.5 * frame + 0.2, Eigen::Vector3d(1, 0, 1).normalized())
+              .toRotationMatrix();
+      const double scale = estimate_scaling ? 1.5 : 1;
+      Eigen::Matrix<double, 3, Eigen::Dynamic> dst =
+          (scale * R * src).colwise() + Eigen::Vector3d(0.1 * frame, 0.2, -0.1);
+      dst.col(frame) += Eigen::Vector3d(1, -1, 2); // outliers
+      dst.col(N - 1 - frame) += Eigen::Vector3d(-2, 0, 1);
+
+      auto solution = solver.solve(source, dst);
+      auto inliers = solver.getTranslationInliers();
+      teaser::RobustRegistrationSolver reference_solver(params);
+      auto expected = reference_solver.solve(src, dst);
+      EXPECT_TRUE(solution.valid);
+      EXPECT_NEAR(solution.scale, expected.scale, 1e-9);
+      EXPECT_LE((solution.rotation - expected.rotation).norm(), 1e-9);
+      EXPECT_LE((solution.translation - expected.translation).norm(), 1e-9);
+      EXPECT_EQ(inliers, reference_solver.getTranslationInliers());
+      EXPECT_EQ(inliers.size(), N - 2);
+    }
+  }
+}
+
+TEST(RegistrationTest, SubsampledScaleEstimation) {
+  const int N = 150;
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src = Eigen::Matrix<double, 3, N>::Random();
+  Eigen::Matrix3d R =
+      Eigen::AngleAxisd(0.8, Eigen::Vector3d(0, 1, 1).normalized()).toRotationMatrix();
+  Eigen::Vector3d t(0.2, -0.4, 0.1);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst = (2.5 * R * src).colwise() + t;
+  for (int i = 0; i < N; i += 10) {
+    dst.col(i) += Eigen::Vector3d(1, -2, 1.5); // outliers
+  }
+
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.01;
+  params.cbar2 = 1;
+  params.estimate_scaling = true;
+  params.rotation_max_iterations = 100;
+  params.rotation_gnc_factor = 1.4;
+  params.rotation_cost_threshold = 1e-12;
+  params.scale_estimation_sample_size = 3000;
+  teaser::RobustRegistrationSolver solver(params);
+  auto solution = solver.solve(src, dst);
+  ASSERT_TRUE(solution.valid);
+  EXPECT_NEAR(solution.scale, 2.5, 1e-4);
+  EXPECT_TRUE(solution.rotation.isApprox(R, 1e-6));
+  EXPECT_TRUE(solution.translation.isApprox(t, 1e-3));
+  EXPECT_EQ(solver.getTranslationInliers().size(), N - N / 10);
+
+  auto stats = solver.getStats();
+  EXPECT_EQ(stats.num_tims, N * (N - 1) / 2);
+  EXPECT_EQ(stats.scale_sample_size, 3000);
+  EXPECT_GE(stats.scale_standard_error, 0);
+  EXPECT_NEAR(stats.scale_sample_inlier_ratio, stats.scale_inlier_ratio, 0.05);
+}
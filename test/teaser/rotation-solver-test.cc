@@ -249,3 +249,98 @@ TEST(RotationSolverTest, GNCTLS) {
     EXPECT_TRUE(teaser::test::getAngularError(expected_R, result) < ALLOWED_ROTATION_ERROR);
   }
 }
+
+TEST(RotationSolverTest, GravityAlignedYaw) {
+  double ALLOWED_ROTATION_ERROR = 1e-5;
+  std::uniform_real_distribution<double> unif(0, 2 * M_PI);
+  std::default_random_engine re;
+  // Problem 1: Rotation around z with z as gravity, no outliers
+  {
+    Eigen::Matrix<double, 3, Eigen::Dynamic> src_points(3, 10);
+    for (size_t i = 0; i < src_points.cols(); ++i) {
+      src_points.col(i) = Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, 1);
+    }
+    double theta = unif(re);
+    Eigen::Matrix3d ref_R = Eigen::AngleAxisd(theta, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+    Eigen::Matrix<double, 3, Eigen::Dynamic> dst_points = ref_R * src_points;
+
+    teaser::GravityAlignedYawRotationSolver::Params params{100, 1e-12, 1.4, 1e-3};
+    teaser::GravityAlignedYawRotationSolver yaw_solver(params, Eigen::Vector3d::UnitZ());
+
+    Eigen::Matrix3d R;
+    Eigen::Matrix<bool, 1, Eigen::Dynamic> inliers(1, src_points.cols());
+    yaw_solver.solveForRotation(src_points, dst_points, &R, &inliers);
+    EXPECT_TRUE(teaser::test::getAngularError(ref_R, R) < ALLOWED_ROTATION_ERROR);
+    EXPECT_EQ(inliers.count(), src_points.cols());
+  }
+  // Problem 2: Tilted gravity direction with outliers
+  {
+    Eigen::Matrix<double, 3, Eigen::Dynamic> src_points(3, 100);
+    for (size_t i = 0; i < src_points.cols(); ++i) {
+      src_points.col(i) = Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, 1);
+    }
+    Eigen::Vector3d gravity(0.1, -0.2, 1);
+    double theta = unif(re);
+    Eigen::Matrix3d ref_R = Eigen::AngleAxisd(theta, gravity.normalized()).toRotationMatrix();
+    Eigen::Matrix<double, 3, Eigen::Dynamic> dst_points = ref_R * src_points;
+
+    // Corrupt 60% of the measurements
+    size_t num_outliers = 60;
+    for (size_t i = 0; i < num_outliers; ++i) {
+      dst_points.col(i) = Eigen::Matrix<double, 3, Eigen::Dynamic>::Random(3, 1);
+    }
+
+    teaser::GravityAlignedYawRotationSolver::Params params{100, 1e-12, 1.4, 1e-3};
+    teaser::GravityAlignedYawRotationSolver yaw_solver(params, gravity);
+
+    Eigen::Matrix3d R;
+    Eigen::Matrix<bool, 1, Eigen::Dynamic> inliers(1, src_points.cols());
+    yaw_solver.solveForRotation(src_points, dst_points, &R, &inliers);
+    std::cout << "Expected R: " << std::endl;
+    std::cout << ref_R << std::endl;
+    std::cout << "R: " << std::endl;
+    std::cout << R << std::endl;
+    EXPECT_TRUE(teaser::test::getAngularError(ref_R, R) < ALLOWED_ROTATION_ERROR);
+    for (size_t i = num_outliers; i < src_points.cols(); ++i) {
+      EXPECT_TRUE(inliers(i));
+    }
+  }
+}
+
+TEST(RotationSolverTest, GNCTLSStableInliersTermination) {
+  double ALLOWED_ROTATION_ERROR = 1e-5;
+  // Seeded, so that the iteration counts don't depend on the order of the tests
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> uniform(-1, 1);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src_points(3, 50);
+  for (int i = 0; i < src_points.cols(); ++i) {
+    src_points.col(i) << uniform(rng), uniform(rng), uniform(rng);
+  }
+  Eigen::Matrix3d ref_R =
+      Eigen::AngleAxisd(1.1, Eigen::Vector3d(1, -2, 0.5).normalized()).toRotationMatrix();
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst_points = ref_R * src_points;
+  for (size_t i = 0; i < 10; ++i) {
+    dst_points.col(i) << uniform(rng), uniform(rng), uniform(rng);
+  }
+
+  teaser::GNCTLSRotationSolver::Params params{100, 1e-12, 1.4, 1e-3};
+  teaser::GNCTLSRotationSolver baseline_solver(params);
+  Eigen::Matrix3d baseline_R;
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> baseline_inliers(1, src_points.cols());
+  baseline_solver.solveForRotation(src_points, dst_points, &baseline_R, &baseline_inliers);
+
+  params.stop_on_stable_inliers = true;
+  teaser::GNCTLSRotationSolver early_solver(params);
+  Eigen::Matrix3d early_R;
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> early_inliers(1, src_points.cols());
+  early_solver.solveForRotation(src_points, dst_points, &early_R, &early_inliers);
+
+  std::cout << "Iterations without / with early termination: "
+            << baseline_solver.getIterationsAtTermination() << " / "
+            << early_solver.getIterationsAtTermination() << std::endl;
+  EXPECT_LT(early_solver.getIterationsAtTermination(),
+            baseline_solver.getIterationsAtTermination());
+  EXPECT_TRUE(teaser::test::getAngularError(ref_R, baseline_R) < ALLOWED_ROTATION_ERROR);
+  EXPECT_TRUE(teaser::test::getAngularError(ref_R, early_R) < ALLOWED_ROTATION_ERROR);
+  EXPECT_EQ(early_inliers, baseline_inliers);
+}
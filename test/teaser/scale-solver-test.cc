@@ -16,6 +16,7 @@
 
 #include <Eigen/Eigenvalues>
 
+#include "teaser/kernels.h"
 #include "teaser/registration.h"
 #include "teaser/macros.h"
 #include "test_utils.h"
@@ -128,3 +129,96 @@ TEST(ScaleSolverTest, FixedScale) {
     }
   }
 }
+
+TEST(ScaleSolverTest, FusedInliersKernel) {
+  // TIMs of random lengths, about half of them inliers. 1000 is not a multiple of the 64 bits of
+  // a mask word, nor of the SIMD widths.
+  const double noise_bound = 0.05;
+  const double beta = 2 * noise_bound;
+  const int N = 1000;
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> uniform(-1, 1);
+  Eigen::Matrix<double, 4, Eigen::Dynamic> src(4, N);
+  Eigen::Matrix<double, 4, Eigen::Dynamic> dst(4, N);
+  for (int i = 0; i < N; ++i) {
+    src.col(i) << uniform(rng), uniform(rng), uniform(rng), 0;
+    dst.col(i).head<3>() = src.col(i).head<3>() * (1 + 0.2 * uniform(rng));
+  }
+
+  // Reference: the ratio tests
+  std::vector<bool> expected(N);
+  for (int i = 0; i < N; ++i) {
+    double v1_dist = src.col(i).head<3>().norm();
+    double v2_dist = dst.col(i).head<3>().norm();
+    expected[i] = std::abs(v2_dist / v1_dist - 1) <= beta / v1_dist &&
+                  std::abs(v1_dist / v2_dist - 1) <= beta / v2_dist;
+  }
+
+  // Contiguous TIMs
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src_tims = src.topRows<3>();
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst_tims = dst.topRows<3>();
+  teaser::ScaleInliersSelector selector(noise_bound, 1);
+  double scale = 0;
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> inliers;
+  selector.solveForScale(src_tims, dst_tims, &scale, &inliers);
+  EXPECT_EQ(scale, 1);
+  ASSERT_EQ(inliers.cols(), N);
+  std::vector<uint64_t> mask;
+  selector.selectInliers(src_tims, dst_tims, &mask);
+  ASSERT_EQ(mask.size(), teaser::kernels::numMaskWords(N));
+  for (int i = 0; i < N; ++i) {
+    EXPECT_EQ(inliers(i), expected[i]) << "TIM " << i;
+    EXPECT_EQ((mask[i / 64] >> (i % 64)) & 1, expected[i]) << "TIM " << i;
+  }
+
+  // Strided TIMs
+  std::vector<uint64_t> strided_mask(teaser::kernels::numMaskWords(N));
+  teaser::kernels::scaleInliersMask(src.data(), dst.data(), 4, N, beta, strided_mask.data());
+  EXPECT_EQ(strided_mask, mask);
+}
+
+TEST(ScaleSolverTest, SubsampledUnknownScale) {
+  // 20000 TIMs of scale 1.7, 30% of them outliers. A full TLS estimate on that many would take
+  // minutes.
+  const double noise_bound = 0.01;
+  const double expected_scale = 1.7;
+  const int N = 20000;
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> uniform(-1, 1);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src(3, N);
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst(3, N);
+  std::vector<bool> is_outlier(N);
+  for (int i = 0; i < N; ++i) {
+    src.col(i) << uniform(rng), uniform(rng), uniform(rng);
+    dst.col(i) = expected_scale * src.col(i) + 0.5 * noise_bound * Eigen::Vector3d::Random();
+    is_outlier[i] = i % 10 < 3;
+    if (is_outlier[i]) {
+      dst.col(i) *= 2 + uniform(rng);
+    }
+  }
+
+  teaser::TLSScaleSolver solver(noise_bound, 1, 2000);
+  double scale = 0;
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> inliers(1, N);
+  solver.solveForScale(src, dst, &scale, &inliers);
+
+  auto stats = solver.getSampleStats();
+  EXPECT_EQ(stats.sample_size, 2000);
+  EXPECT_GT(stats.standard_error, 0);
+  EXPECT_LT(stats.standard_error, 1e-3);
+  EXPECT_NEAR(scale, expected_scale, 5 * stats.standard_error + 1e-4);
+  EXPECT_NEAR(stats.sample_inlier_ratio, 0.7, 0.05);
+  EXPECT_NEAR(stats.inlier_ratio, 0.7, 0.02);
+  ASSERT_EQ(inliers.cols(), N);
+  int num_misclassified = 0;
+  for (int i = 0; i < N; ++i) {
+    num_misclassified += inliers(i) == is_outlier[i];
+  }
+  EXPECT_LT(num_misclassified, N / 100);
+
+  // Problems with fewer TIMs than the sample size use all of them
+  teaser::TLSScaleSolver small_solver(noise_bound, 1, 2 * N);
+  inliers.resize(1, 100);
+  small_solver.solveForScaleView(src.leftCols(100), dst.leftCols(100), &scale, &inliers);
+  EXPECT_EQ(small_solver.getSampleStats().sample_size, 0);
+}
@@ -11,7 +11,7 @@
 #include <iostream>
 #include <iomanip>
 #include <fstream>
-#include <chrono>
+#include <random>
 
 #include <Eigen/Eigenvalues>
 
@@ -152,3 +152,33 @@ TEST(TLSTest, TLSEstimateTiled) {
     }
   }
 }
+
+TEST(TLSTest, TLSEstimateCancellation) {
+  const int N = 5000;
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  Eigen::RowVectorXd measurements(N);
+  Eigen::RowVectorXd ranges(N);
+  for (int i = 0; i < N; ++i) {
+    measurements(i) = i % 4 ? 2 + 0.01 * uniform(rng) : 10 * uniform(rng);
+    ranges(i) = 0.05;
+  }
+
+  teaser::ScalarTLSEstimator tls;
+  double reference;
+  tls.estimate(measurements, ranges, &reference, nullptr);
+
+  // A live token doesn't change the estimate
+  teaser::CancellationToken token;
+  double estimate;
+  tls.estimate(measurements, ranges, &estimate, nullptr, &token);
+  EXPECT_EQ(estimate, reference);
+
+  // An expired token skips the whole sweep over the interval centers, so the fallback estimate of 0
+  // is returned, with the inliers of that estimate
+  token.setTimeout(0);
+  Eigen::Matrix<bool, 1, Eigen::Dynamic> inliers(1, N);
+  tls.estimate(measurements, ranges, &estimate, &inliers, &token);
+  EXPECT_EQ(estimate, 0);
+  EXPECT_EQ(inliers, (measurements.array().abs() <= ranges.array()).matrix());
+}
@@ -0,0 +1,61 @@
+/**
+ * Copyright 2020, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Jingnan Shi, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ */
+
+#include "gtest/gtest.h"
+
+#include <regex>
+#include <sstream>
+#include <string>
+
+#include <Eigen/Core>
+
+#include "teaser/registration.h"
+#include "teaser/trace.h"
+
+TEST(TraceTest, SolveEvents) {
+  Eigen::Matrix<double, 3, Eigen::Dynamic> src = Eigen::Matrix<double, 3, 20>::Random();
+  Eigen::Matrix<double, 3, Eigen::Dynamic> dst = 2 * src;
+  dst.colwise() += Eigen::Vector3d(0.1, 0.2, 0.3);
+
+  teaser::RobustRegistrationSolver::Params params;
+  params.noise_bound = 0.01;
+  params.estimate_scaling = true;
+  teaser::RobustRegistrationSolver solver(params);
+
+  teaser::trace::clearTrace();
+  solver.solve(src, dst);
+
+  std::stringstream ss;
+  teaser::trace::writeChromeTrace(ss);
+  const std::string trace = ss.str();
+  EXPECT_NE(trace.find("\"traceEvents\":["), std::string::npos);
+#ifdef TEASER_ENABLE_TRACING
+  EXPECT_NE(trace.find("\"name\":\"RobustRegistrationSolver::solve\",\"ph\":\"X\""),
+            std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"MaxCliqueSolver::findMaxClique\""), std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"GNC-TLS iteration\""), std::string::npos);
+
+  // Times are written in fixed notation, in microseconds with nanosecond resolution
+  const std::regex time_field("\"(ts|dur)\":([^,}]*)");
+  const std::regex fixed_time("[0-9]+\\.[0-9]{3}");
+  size_t num_times = 0;
+  for (std::sregex_iterator it(trace.begin(), trace.end(), time_field), end; it != end; ++it) {
+    EXPECT_TRUE(std::regex_match((*it)[2].str(), fixed_time)) << (*it)[0].str();
+    ++num_times;
+  }
+  EXPECT_GT(num_times, 0);
+
+  // Cleared events are not written again
+  teaser::trace::clearTrace();
+  ss.str("");
+  teaser::trace::writeChromeTrace(ss);
+  EXPECT_EQ(ss.str().find("\"ph\":\"X\""), std::string::npos);
+#else
+  EXPECT_EQ(trace.find("\"ph\":\"X\""), std::string::npos);
+#endif
+}
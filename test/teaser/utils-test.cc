@@ -128,4 +128,13 @@ TEST(UtilsTest, CalculatePointClusterDiameter) {
     float d = teaser::utils::calculateDiameter<float, 3>(test_mat);
     EXPECT_NEAR(d, 5.1962, 0.0001);
   }
+  {
+    // Deduced template arguments, and a view of some of the columns
+    Eigen::Matrix<double, 3, Eigen::Dynamic> test_mat(3, 5);
+    test_mat << 1, 2, 3, 4, 100,
+                1, 2, 3, 4, 100,
+                1, 2, 3, 4, 100;
+    EXPECT_NEAR(teaser::utils::calculateDiameter(test_mat), 270.19993, 0.0001);
+    EXPECT_NEAR(teaser::utils::calculateDiameter(test_mat.leftCols(4)), 5.1962, 0.0001);
+  }
 }
\ No newline at end of file